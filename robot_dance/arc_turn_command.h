@@ -0,0 +1,192 @@
+#ifndef arc_turn_command_h_
+#define arc_turn_command_h_
+
+#include "boe_bot_command_base.h"
+#include "line_controller.h"
+
+/**
+ * Command driving the robot through a corner without the stop. The robot follows the line to the next
+ * cross like a move, on its cross line it pivots about the inner wheel with the outer one at the full speed.
+ * The sensor row leads the wheel axle about as much as the axle is from the cross then, so that the pivot
+ * brings the axle onto the new line a few centimeters past the cross. The command finishes as soon as the middle
+ * sensor finds the new line after the minimum sweep time of the calibration, and the following move starts
+ * in the motion. The inner wheel backs up by default, as the lagging wheels carry the axle on past the cross line.
+ */
+class arc_turn_command : public boe_bot_command_base {
+
+    /**
+     * Phases of the arc.
+     */
+    enum arc_phase : uint8_t {
+        APPROACHING,
+        SWEEPING
+    };
+
+    /**
+     * Defines direction of the turn on the corner.
+     */
+    bool left;
+
+    /**
+     * Current phase.
+     */
+    arc_phase phase;
+
+    /**
+     * Time of the start of the current phase in ms.
+     */
+    time_type phase_started;
+
+    /**
+     * Defines if the middle sensor left the original line during the sweep.
+     */
+    bool line_left;
+
+    /**
+     * Steering controller following the line to the corner.
+     */
+    line_controller controller;
+
+    /**
+     * Switches to the given phase.
+     *
+     * @param next Next phase.
+     */
+    void enter(arc_phase next) {
+        phase = next;
+        phase_started = millis();
+    }
+
+    /**
+     * Follows the line at the cruise speed, by the PID controller or by the decision table.
+     */
+    void follow_line();
+
+    /**
+     * Pivots on the inner wheel.
+     */
+    void sweep();
+
+    /**
+     * Finishes on the corner in the new direction, the robot goes on.
+     */
+    void arrive();
+
+public:
+
+    /**
+     * Creates an idle arc command.
+     */
+    arc_turn_command() : boe_bot_command_base(nullptr, location()), left(false), phase(APPROACHING),
+                         phase_started(0), line_left(false) {};
+
+    /**
+     * Alternative 'constructor' to avoid dynamic allocation.
+     *
+     * @param left_p Direction of the turn on the corner.
+     * @param robot_p Robot to be commanded.
+     * @param final_location_p Location after the turn, on the corner in the new direction.
+     */
+    void set(bool left_p, boe_bot *robot_p, const location &final_location_p);
+
+    /**
+     * Continue to do this command.
+     */
+    virtual void update() override;
+
+    virtual char *get_name() override;
+
+};
+
+
+
+//class arc_turn_command
+
+void arc_turn_command::set(bool left_p, boe_bot *robot_p, const location &final_location_p) {
+    init(robot_p, final_location_p);
+    left = left_p;
+    phase = APPROACHING;
+    phase_started = 0;
+    line_left = false;
+    controller.reset();
+}
+
+inline void arc_turn_command::follow_line() {
+    const uint8_t pattern = robot->get_sensors().get_pattern();
+    if (robot->get_calibration().has_flag(CALIBRATION_PID_STEERING)) {
+        const line_controller_gains &gains = robot->get_calibration().get_gains();
+        const int16_t correction = controller.update(pattern, millis(), gains);
+        robot->steer(robot->get_cruise_speed(), correction / (double) LINE_CORRECTION_MAX);
+    } else {
+        /* The middle sensor sets the half speed first, the smoothing of the table primitive restarts from it */
+        if ((pattern & PATTERN_MIDDLE) != 0) {
+            robot->half_forward();
+        }
+        robot->apply(lookup_primitive(GO_STRAIGHT_TABLE, pattern));
+    }
+}
+
+inline void arc_turn_command::sweep() {
+    const double inner = robot->get_calibration().get_tuning().arc_inner_speed / 1000.0;
+    robot->steer((FULL + inner) / 2, left ? (inner - FULL) / 2 : (FULL - inner) / 2);
+}
+
+inline void arc_turn_command::arrive() {
+    robot->led_off();
+    finish();
+}
+
+void arc_turn_command::update() {
+    /* The arc is finished, the next command takes over the moving robot */
+    if (is_done()) {
+        return;
+    }
+
+    count_update();
+
+    /* First call to this function */
+    if (state == command_state::PREPARED) {
+        start(COMMAND_ARC);
+        enter(APPROACHING);
+        robot->clear_last_move_encounters();
+    }
+
+    robot->check_for_path_encounters();
+
+    const motion_tuning &tuning = robot->get_calibration().get_tuning();
+    const time_type elapsed = millis() - phase_started;
+    switch (phase) {
+        case APPROACHING:
+            /* As a move, the cross left behind must not be taken for the corner */
+            if (elapsed > tuning.move_min_time &&
+                (robot->get_sensors().first_left() || robot->get_sensors().first_right())) {
+                robot->led_on();
+                enter(SWEEPING);
+                sweep();
+            } else {
+                follow_line();
+            }
+            break;
+        case SWEEPING:
+            /* The middle sensor may cross the lines of the corner, the new line is found only late enough */
+            if (!robot->get_sensors().middle()) {
+                line_left = true;
+                sweep();
+            } else if (line_left && elapsed >= tuning.arc_sweep_time) {
+                arrive();
+            } else {
+                sweep();
+            }
+            break;
+    }
+}
+
+inline char *arc_turn_command::get_name() {
+    if (left) {
+        return (char *) "arc command [left]";
+    } else {
+        return (char *) "arc command [right]";
+    }
+}
+
+#endif
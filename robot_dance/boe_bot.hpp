@@ -2,12 +2,20 @@
 #ifndef boe_bot_h_
 #define boe_bot_h_
 
-#include <Arduino.h>
+#include "hal.hpp"
 
 #include "sensors.hpp"
 #include "wheel_control.hpp"
 #include "planning.h"
 #include "push_button.hpp"
+#include "calibration.hpp"
+#include "loop_scheduler.h"
+#include "trace_recorder.hpp"
+#include "command_statistics.hpp"
+#include "telemetry.hpp"
+#include "tempo_report.hpp"
+#include "catch_up.hpp"
+#include "tile_odometry.hpp"
 
 #define BAUD_SPEED  (115200)
 #define FULL        (1.0)
@@ -30,6 +38,14 @@ class boe_bot {
     wheel_control wheels;
     sensors ir_sensors;
     push_button button;
+    calibration calib;
+    loop_scheduler scheduler;
+    trace_recorder trace;
+    command_statistics command_stats;
+    telemetry telemetry_stream;
+    tempo_report tempo;
+    catch_up_policy catch_up;
+    tile_odometry odometry;
 
     bool last_move_encountered_left = true;
     bool last_move_encountered_right = true;
@@ -41,6 +57,9 @@ class boe_bot {
 
     unsigned long num_calls;
 
+    double steering_left = STOP;
+    double steering_right = STOP;
+
 public:
 
     /**
@@ -117,6 +136,105 @@ public:
     }
 
 
+    /**
+     * Gets robot specific constants.
+     *
+     * @return The robot specific constants.
+     */
+    calibration &get_calibration() {
+        return calib;
+    }
+
+    /**
+     * Applies the switches of the current calibration to the hardware.
+     */
+    void apply_calibration() {
+        ir_sensors.set_edge_capture(calib.has_flag(CALIBRATION_EDGE_CAPTURE));
+        scheduler.set_period(calib.get_loop_period());
+        trace.set_enabled(calib.has_flag(CALIBRATION_TRACE));
+        wheels.set_smoothing(calib.get_tuning().smoothing_steps, calib.get_tuning().smoothing_jump / 1000.0);
+    }
+
+    /**
+     * Gets the scheduler pacing the control loop.
+     *
+     * @return The scheduler pacing the control loop.
+     */
+    loop_scheduler &get_scheduler() {
+        return scheduler;
+    }
+
+    /**
+     * Gets the recorder of the sensor patterns and primitives.
+     *
+     * @return The recorder of the sensor patterns and primitives.
+     */
+    trace_recorder &get_trace() {
+        return trace;
+    }
+
+    /**
+     * Gets the timing statistics of the finished commands.
+     *
+     * @return The timing statistics of the finished commands.
+     */
+    command_statistics &get_command_statistics() {
+        return command_stats;
+    }
+
+    /**
+     * Gets the binary telemetry of the dance.
+     *
+     * @return The binary telemetry of the dance.
+     */
+    telemetry &get_telemetry() {
+        return telemetry_stream;
+    }
+
+    /**
+     * Gets the arrivals at the waypoints of the last show.
+     *
+     * @return The arrivals at the waypoints of the last show.
+     */
+    tempo_report &get_tempo() {
+        return tempo;
+    }
+
+    /**
+     * Gets the policy re-synchronizing the robot with the dance.
+     *
+     * @return The policy re-synchronizing the robot with the dance.
+     */
+    catch_up_policy &get_catch_up() {
+        return catch_up;
+    }
+
+    /**
+     * Gets the dead reckoning of the moves.
+     *
+     * @return The learned times of the moves.
+     */
+    tile_odometry &get_odometry() {
+        return odometry;
+    }
+
+    /**
+     * Gets the speed of the line following between the crosses.
+     *
+     * @return The speed from interval [0; 1].
+     */
+    double get_cruise_speed() const {
+        return calib.get_cruise_speed();
+    }
+
+    /**
+     * Reads the sensors and records the pattern to the trace.
+     */
+    void read_sensors() {
+        ir_sensors.read_sensors();
+        trace.record_pattern(ir_sensors.get_pattern());
+    }
+
     /**
      * Gets sensors states containing last measurements.
      *
@@ -260,6 +378,7 @@ public:
      * of wrong wheels calibration.
      */
     void stop() {
+        trace.record_primitive(MP_STOP);
         wheels.left_speed(STOP);
         wheels.right_speed(STOP);
         wheels.store_current_to_previous();
@@ -271,6 +390,7 @@ public:
      * NOTE: Must be called multiple times!
      */
     void stop_smoothly() {
+        trace.record_primitive(MP_STOP_SMOOTHLY);
         if (smooth_drive) {
             if (last_wheel_control == &boe_bot::stop_smoothly || last_wheel_control == &boe_bot::stop) {
                 ++num_calls;
@@ -318,8 +438,9 @@ public:
      */
     void in_place_left() {
         common_smoothing_procedure(&boe_bot::in_place_left);
-        wheels.left_speed(-FULL, num_calls);
-        wheels.right_speed(FULL, num_calls);
+        const double speed = calib.get_tuning().turn_speed / 1000.0;
+        wheels.left_speed(-speed, num_calls);
+        wheels.right_speed(speed, num_calls);
     }
 
     /**
@@ -354,8 +475,9 @@ public:
      */
     void in_place_right() {
         common_smoothing_procedure(&boe_bot::in_place_right);
-        wheels.left_speed(FULL, num_calls);
-        wheels.right_speed(-FULL, num_calls);
+        const double speed = calib.get_tuning().turn_speed / 1000.0;
+        wheels.left_speed(speed, num_calls);
+        wheels.right_speed(-speed, num_calls);
     }
 
     /**
@@ -385,14 +507,139 @@ public:
         wheels.right_speed(STOP, num_calls);
     }
 
+    /**
+     * Very slow turn-left movement for small corrections.
+     */
+    void in_place_left_slow() {
+        common_smoothing_procedure(&boe_bot::in_place_left_slow);
+        wheels.left_speed(-VERY_SLOW, num_calls);
+        wheels.right_speed(VERY_SLOW, num_calls);
+    }
+
+    /**
+     * Very slow turn-right movement for small corrections.
+     */
+    void in_place_right_slow() {
+        common_smoothing_procedure(&boe_bot::in_place_right_slow);
+        wheels.left_speed(VERY_SLOW, num_calls);
+        wheels.right_speed(-VERY_SLOW, num_calls);
+    }
+
+    /**
+     * Moves forward with the speed difference of the wheels given by the steering correction.
+     *
+     * @param speed Base speed of both wheels from interval [-1; 1].
+     * @param correction Speed difference from interval [-1; 1], positive value turns right.
+     */
+    void steer(double speed, double correction) {
+        steering_left = speed + correction;
+        steering_right = speed - correction;
+
+        /* Keep the difference if one of the wheels would be too fast */
+        double excess = max(steering_left, steering_right) - FULL;
+        if (excess > 0) {
+            steering_left -= excess;
+            steering_right -= excess;
+        }
+        steering_left = constrain(steering_left, -FULL, FULL);
+        steering_right = constrain(steering_right, -FULL, FULL);
+
+        trace.record_primitive(TRACE_STEERING);
+        follow_steering();
+    }
+
+    /**
+     * Moves with the wheel speeds computed by the last steering.
+     */
+    void follow_steering() {
+        common_smoothing_procedure(&boe_bot::follow_steering);
+        wheels.left_speed(steering_left, num_calls);
+        wheels.right_speed(steering_right, num_calls);
+    }
+
+    /**
+     * Keeps the previous wheel control unchanged.
+     */
+    void keep_moving() {}
+
+    /**
+     * Performs the wheel control primitive given by its identifier,
+     * typically looked up in a decision table.
+     *
+     * @param primitive Identifier of the primitive to perform.
+     */
+    void apply(motion_primitive primitive) {
+        if (primitive != MP_NONE) {
+            trace.record_primitive(primitive);
+        }
+        /* A switch keeps the dispatch in the flash, a table of member pointers would take RAM */
+        switch (primitive) {
+            case MP_STOP:
+                stop();
+                break;
+            case MP_STOP_SMOOTHLY:
+                stop_smoothly();
+                break;
+            case MP_FULL_FORWARD:
+                full_forward();
+                break;
+            case MP_HALF_FORWARD:
+                half_forward();
+                break;
+            case MP_QUARTER_FORWARD:
+                quarter_forward();
+                break;
+            case MP_IN_PLACE_LEFT:
+                in_place_left();
+                break;
+            case MP_IN_PLACE_LEFT_HALF:
+                in_place_left_half();
+                break;
+            case MP_SLIGHTLY_LEFT:
+                slightly_left();
+                break;
+            case MP_SHARPLY_LEFT:
+                sharply_left();
+                break;
+            case MP_IN_PLACE_RIGHT:
+                in_place_right();
+                break;
+            case MP_IN_PLACE_RIGHT_HALF:
+                in_place_right_half();
+                break;
+            case MP_SLIGHTLY_RIGHT:
+                slightly_right();
+                break;
+            case MP_SHARPLY_RIGHT:
+                sharply_right();
+                break;
+            case MP_IN_PLACE_LEFT_SLOW:
+                in_place_left_slow();
+                break;
+            case MP_IN_PLACE_RIGHT_SLOW:
+                in_place_right_slow();
+                break;
+            default:
+                keep_moving();
+                break;
+        }
+    }
+
     void setup() {
         /* Serial line speed initialization */
         Serial.begin(BAUD_SPEED);
         Serial.println(F("\n\nSerial prepared"));
 
+        /* Robot specific constants */
+        if (!calib.load()) {
+            Serial.println(F("Calibration not found, using defaults"));
+        }
+        tempo.load();
+
         /* Input button & sensors initialization */
         button.init_button();
         ir_sensors.init_sensors();
+        apply_calibration();
 
         /* Output LED and wheel servos initialization */
         pinMode(led, OUTPUT);
@@ -419,7 +666,7 @@ public:
         Serial.println(F("Waiting for data..."));
         do {
             if (Serial.available() > 0) {
-                const char value = (const char) Serial.read();
+                const char value = (char) Serial.read();
                 if (!cmd_parser.store_character(value)) {
                     Serial.println(F("Incorrect input!"));
                     cmd_parser.reset_commands();
@@ -16,6 +16,31 @@ private:
      */
     location final_location;
 
+    /**
+     * Kind of the command in the statistics, see COMMAND_* kinds.
+     */
+    uint8_t kind = COMMAND_MOVE;
+
+    /**
+     * Time of the first update in ms.
+     */
+    time_type started_time = 0;
+
+    /**
+     * Time of the finish in ms.
+     */
+    time_type finished_time = 0;
+
+    /**
+     * Number of the update calls since the start.
+     */
+    uint16_t update_count = 0;
+
+    /**
+     * Longest time of the command in ms, given by the statistics at the start.
+     */
+    time_type budget = COMMAND_DEFAULT_BUDGET;
+
 protected:
 
     /**
@@ -44,8 +69,25 @@ protected:
      */
     void init(boe_bot *robot_p, location final_location_p);
 
+    /**
+     * Marks this command as being executed, called by its first update.
+     *
+     * @param kind_p Kind of the command in the statistics, see COMMAND_* kinds.
+     */
+    void start(uint8_t kind_p);
+
+    /**
+     * Counts an update call of the unfinished command.
+     */
+    void count_update() {
+        if (update_count < UINT16_MAX) {
+            update_count++;
+        }
+    }
+
     /**
      * Mark this command as completed, robot's position is moved to desired location.
+     * The duration of the command is recorded to the statistics and to the telemetry of the robot.
      */
     void finish();
 
@@ -55,6 +97,42 @@ public:
 
     virtual bool is_done() override;
 
+    virtual bool is_over_budget(time_type now) override {
+        return state == IN_PROCESS && now - started_time > budget;
+    }
+
+    /**
+     * Stops the robot and records the timeout to the statistics and to the telemetry of the robot.
+     */
+    virtual void abandon() override;
+
+    /**
+     * Gets time of the first update.
+     *
+     * @return The time in ms.
+     */
+    time_type get_started_time() const {
+        return started_time;
+    }
+
+    /**
+     * Gets time of the finish.
+     *
+     * @return The time in ms, 0 if the command did not finish.
+     */
+    time_type get_finished_time() const {
+        return finished_time;
+    }
+
+    /**
+     * Gets number of the update calls since the start.
+     *
+     * @return The number of the update calls.
+     */
+    uint16_t get_update_count() const {
+        return update_count;
+    }
+
     /**
      * Gets human-readable string representation of this command.
      *
@@ -70,22 +148,46 @@ public:
 
 //class boe_bot_command_base
 
-inline boe_bot_command_base::boe_bot_command_base(boe_bot *robot_p, location final_location_p) : state(PREPARED),
-                                                                                                 final_location(
+inline boe_bot_command_base::boe_bot_command_base(boe_bot *robot_p, location final_location_p) : final_location(
                                                                                                          final_location_p),
-                                                                                                 robot(robot_p) {}
+                                                                                                 robot(robot_p),
+                                                                                                 state(PREPARED) {}
 
 void boe_bot_command_base::init(boe_bot *robot_p, location final_location_p) {
     state = PREPARED;
     final_location = final_location_p;
     robot = robot_p;
+    started_time = 0;
+    finished_time = 0;
+    update_count = 0;
+}
+
+inline void boe_bot_command_base::start(uint8_t kind_p) {
+    kind = kind_p;
+    started_time = millis();
+    budget = robot->get_command_statistics().get_budget(kind);
+    state = IN_PROCESS;
+    robot->get_telemetry().command_start(started_time, kind, final_location);
 }
 
 inline void boe_bot_command_base::finish() {
     robot->set_location(final_location);
     state = FINISHED;
+    finished_time = millis();
+    robot->get_command_statistics().record(kind, finished_time - started_time, update_count);
+    robot->get_telemetry().command_end(finished_time, kind, finished_time - started_time, update_count);
+    robot->get_telemetry().sensors(finished_time, robot->get_sensors().get_pattern(), final_location);
 };
 
+inline void boe_bot_command_base::abandon() {
+    robot->stop();
+    robot->led_off();
+    state = FINISHED;
+    robot->get_command_statistics().record_timeout(kind);
+    robot->get_telemetry().anomaly(millis(), ANOMALY_TIMEOUT, robot->get_location());
+    robot->get_sensors().get_history().request_dump();
+}
+
 inline bool boe_bot_command_base::is_done() {
     return state == FINISHED;
 }
@@ -5,6 +5,8 @@
 #include "square_grid_planner.h"
 #include "move_command.h"
 #include "turn_command.h"
+#include "recovery_command.h"
+#include "arc_turn_command.h"
 
 
 /**
@@ -24,6 +26,16 @@ private:
      */
     turn_command _turn_command;
 
+    /**
+     * Stores one recovery command locally to avoid dynamic allocation.
+     */
+    recovery_command _recovery_command;
+
+    /**
+     * Stores one arc command locally to avoid dynamic allocation.
+     */
+    arc_turn_command _arc_command;
+
 protected:
 
     /**
@@ -48,8 +60,28 @@ protected:
      */
     virtual command *get_turn_cmd(bool left, const location &final_location) override;
 
+    /**
+     * Creates a new command to drive to the next cross and turn on it without the stop,
+     * if CALIBRATION_ARC_CORNERS is set.
+     *
+     * @param left Direction of the turn on the corner.
+     * @param final_location Location after the turn, on the corner in the new direction.
+     * @return Command able to perform the arc or nullptr if the corners are not driven on arcs.
+     */
+    virtual command *get_arc_turn_cmd(bool left, const location &final_location) override;
+
 public:
 
+    /**
+     * Creates a command bringing the robot back to the last known cross, a lost move backs up to it
+     * and a lost turn searches for a line around it.
+     *
+     * @param failed The abandoned command.
+     * @param last_known Location the robot reached last.
+     * @return Command able to perform the recovery.
+     */
+    virtual command *get_recovery_cmd(const command *failed, const location &last_known) override;
+
     /**
      * Create a new planner capable to make plans for given grid size.
      *
@@ -64,13 +96,15 @@ public:
 
 //class boe_bot_planner
 
-inline boe_bot_planner::boe_bot_planner(boe_bot *robot_p) : _move_command(robot_p, location()),
+inline boe_bot_planner::boe_bot_planner(boe_bot *robot_p) : square_grid_planner(),
+                                                            _move_command(robot_p, location()),
                                                             _turn_command(false, robot_p, location()),
-                                                            square_grid_planner(), robot(robot_p) {}
+                                                            robot(robot_p) {}
 
-inline boe_bot_planner::boe_bot_planner() : _move_command(nullptr, location()),
+inline boe_bot_planner::boe_bot_planner() : square_grid_planner(),
+_move_command(nullptr, location()),
 _turn_command(false, nullptr, location()),
-square_grid_planner(), robot(nullptr) {};
+robot(nullptr) {};
 
 inline command *boe_bot_planner::get_move_forward_cmd(const location &final_location) {
     _move_command.set(robot, final_location);
@@ -82,4 +116,24 @@ inline command *boe_bot_planner::get_turn_cmd(bool left, const location &final_l
     return &_turn_command;
 };
 
+inline command *boe_bot_planner::get_arc_turn_cmd(bool left, const location &final_location) {
+    if (!robot->get_calibration().has_flag(CALIBRATION_ARC_CORNERS)) {
+        return nullptr;
+    }
+    _arc_command.set(left, robot, final_location);
+    return &_arc_command;
+};
+
+inline command *boe_bot_planner::get_recovery_cmd(const command *failed, const location &last_known) {
+    /* A lost arc is backed up like a move, it drives from the last cross too */
+    time_type reverse_time = 0;
+    if (failed == &_move_command) {
+        reverse_time = millis() - _move_command.get_started_time();
+    } else if (failed == &_arc_command) {
+        reverse_time = millis() - _arc_command.get_started_time();
+    }
+    _recovery_command.set(robot, last_known, reverse_time);
+    return &_recovery_command;
+};
+
 #endif
\ No newline at end of file
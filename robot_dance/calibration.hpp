@@ -0,0 +1,419 @@
+
+#ifndef CALIBRATION_HPP
+#define CALIBRATION_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+#include "line_controller.h"
+#include "loop_scheduler.h"
+#include "wheel_control.hpp"
+
+/**
+ * Identifies valid calibration in the EEPROM, must be changed with the layout of 'calibration_data'.
+ */
+#define CALIBRATION_MAGIC           (0xCA05)
+
+/**
+ * Flag enabling the PID line following instead of the decision table.
+ */
+#define CALIBRATION_PID_STEERING    (1 << 0)
+
+/**
+ * Flag enabling the capture of the sensor edges by the pin change interrupt.
+ */
+#define CALIBRATION_EDGE_CAPTURE    (1 << 1)
+
+/**
+ * Flag enabling the trace of the sensor patterns and primitives on the Serial line during the dance.
+ */
+#define CALIBRATION_TRACE           (1 << 2)
+
+/**
+ * Flag enabling the catch-up of the robot, which fell behind the time line of the dance, see catch_up_policy.
+ */
+#define CALIBRATION_CATCH_UP        (1 << 3)
+
+/**
+ * Flag allowing the catch-up to skip the overdue waypoints, it has no effect without CALIBRATION_CATCH_UP.
+ */
+#define CALIBRATION_SKIP_LATE       (1 << 4)
+
+/**
+ * Flag enabling the in-place heading correction on the crosses by the entry skew of the outer sensors, see move_command.
+ */
+#define CALIBRATION_SKEW_CORRECTION (1 << 5)
+
+/**
+ * Flag enabling the stop on the cross predicted by the tile odometry, the moves do not slow down for the centering.
+ */
+#define CALIBRATION_PREDICTIVE_STOP (1 << 6)
+
+/**
+ * Flag enabling the stop of the turns predicted by their angular velocity, see turn_command.
+ */
+#define CALIBRATION_TURN_PREDICTION (1 << 7)
+
+/**
+ * Flag enabling the corners of the routes driven on an arc without the stop, see arc_turn_command.
+ */
+#define CALIBRATION_ARC_CORNERS     (1 << 8)
+
+#define DEFAULT_CALIBRATION_FLAGS   (0)
+
+#define DEFAULT_MOVE_MIN_TIME       (300)
+#define DEFAULT_CROSS_CENTER_TIME   (375)
+#define DEFAULT_TURN_MISS_TIME      (300)
+#define DEFAULT_TURN_LEAVE_TIME     (400)
+#define DEFAULT_CENTER_SPEED        (250)
+#define DEFAULT_TURN_SPEED          (1000)
+#define DEFAULT_ARC_SWEEP_TIME      (300)
+#define DEFAULT_ARC_INNER_SPEED     (-190)
+
+
+/**
+ * Timing and speeds of the motion commands, tuned for the particular robot.
+ */
+struct motion_tuning {
+
+    /**
+     * Time in ms after the start of a move, before which no cross is recognized.
+     */
+    uint16_t move_min_time;
+
+    /**
+     * Time in ms of driving from the cross detection to the centering of the wheels on the cross.
+     */
+    uint16_t cross_center_time;
+
+    /**
+     * Time in ms, within which a turn must find the middle sensor missed at its start.
+     */
+    uint16_t turn_miss_time;
+
+    /**
+     * Time in ms after the start of a turn, before which the original line is not considered left.
+     */
+    uint16_t turn_leave_time;
+
+    /**
+     * Number of the smoothing steps of a wheel speed change.
+     */
+    uint16_t smoothing_steps;
+
+    /**
+     * Immediate part of a wheel speed change in permille.
+     */
+    int16_t smoothing_jump;
+
+    /**
+     * Speed of the centering on the cross in permille of the full speed.
+     */
+    int16_t center_speed;
+
+    /**
+     * Wheel speed of the in-place turns in permille of the full speed.
+     */
+    int16_t turn_speed;
+
+    /**
+     * Minimum time in ms of the sweep of an arc through the corner, before which the new line is not considered found.
+     */
+    uint16_t arc_sweep_time;
+
+    /**
+     * Speed of the inner wheel during the sweep of an arc in permille of the full speed.
+     */
+    int16_t arc_inner_speed;
+
+};
+
+
+/**
+ * Calibration values as stored in the EEPROM.
+ */
+struct calibration_data {
+
+    uint16_t magic;
+
+    /**
+     * Combination of CALIBRATION_* flags.
+     */
+    uint16_t flags;
+
+    /**
+     * Gains of the line following controller.
+     */
+    line_controller_gains gains;
+
+    /**
+     * Speed of the line following between the crosses in permille of the full speed.
+     */
+    int16_t cruise_speed;
+
+    /**
+     * Period of the control loop in us, 0 means free-running.
+     */
+    uint16_t loop_period;
+
+    /**
+     * Timing and speeds of the motion commands.
+     */
+    motion_tuning tuning;
+
+};
+
+static_assert(sizeof(calibration_data) == 34, "calibration_data must not contain any padding");
+
+
+/**
+ * Robot specific constants loaded from the end of the EEPROM.
+ */
+class calibration {
+
+    calibration_data data;
+
+    /**
+     * Offset of the next byte to be stored, size of the data when nothing is pending.
+     */
+    uint8_t pending_offset = sizeof(calibration_data);
+
+public:
+
+    /**
+     * Creates the default calibration.
+     */
+    calibration();
+
+    /**
+     * Sets all values to their defaults.
+     */
+    void set_defaults();
+
+    /**
+     * Loads the calibration from the EEPROM, uses defaults if the EEPROM does not contain any.
+     *
+     * @return If the calibration was found in the EEPROM.
+     */
+    bool load();
+
+    /**
+     * Schedules storing of the calibration to the EEPROM, the bytes are written by 'store_step'.
+     */
+    void store() {
+        pending_offset = 0;
+    }
+
+    /**
+     * Writes at most one changed byte of the scheduled calibration without waiting for the EEPROM.
+     *
+     * @return If some bytes are still pending.
+     */
+    bool store_step();
+
+    /**
+     * Checks if the given CALIBRATION_* flag is set.
+     *
+     * @param flag The flag to check.
+     * @return If the flag is set.
+     */
+    bool has_flag(uint16_t flag) const {
+        return (data.flags & flag) != 0;
+    }
+
+    /**
+     * Gets all flags.
+     *
+     * @return Combination of CALIBRATION_* flags.
+     */
+    uint16_t get_flags() const {
+        return data.flags;
+    }
+
+    /**
+     * Sets all flags.
+     *
+     * @param flags Combination of CALIBRATION_* flags.
+     */
+    void set_flags(uint16_t flags) {
+        data.flags = flags;
+    }
+
+    /**
+     * Gets gains of the line following controller.
+     *
+     * @return The gains of the line following controller.
+     */
+    const line_controller_gains &get_gains() const {
+        return data.gains;
+    }
+
+    /**
+     * Sets gains of the line following controller.
+     *
+     * @param gains The gains of the line following controller.
+     */
+    void set_gains(const line_controller_gains &gains) {
+        data.gains = gains;
+    }
+
+    /**
+     * Gets speed of the line following between the crosses.
+     *
+     * @return The speed from interval [0; 1].
+     */
+    double get_cruise_speed() const {
+        return data.cruise_speed / 1000.0;
+    }
+
+    /**
+     * Sets speed of the line following between the crosses.
+     *
+     * @param cruise_speed The speed in permille of the full speed.
+     */
+    void set_cruise_speed(int16_t cruise_speed) {
+        data.cruise_speed = cruise_speed;
+    }
+
+    /**
+     * Gets period of the control loop.
+     *
+     * @return The period in us, 0 means free-running.
+     */
+    uint16_t get_loop_period() const {
+        return data.loop_period;
+    }
+
+    /**
+     * Sets period of the control loop.
+     *
+     * @param loop_period The period in us, 0 means free-running.
+     */
+    void set_loop_period(uint16_t loop_period) {
+        data.loop_period = loop_period;
+    }
+
+    /**
+     * Gets timing and speeds of the motion commands.
+     *
+     * @return The timing and speeds of the motion commands.
+     */
+    const motion_tuning &get_tuning() const {
+        return data.tuning;
+    }
+
+    /**
+     * Sets timing and speeds of the motion commands.
+     *
+     * @param tuning The timing and speeds of the motion commands.
+     */
+    void set_tuning(const motion_tuning &tuning) {
+        data.tuning = tuning;
+    }
+
+    /**
+     * Gets the whole calibration as stored in the EEPROM.
+     *
+     * @return The calibration data.
+     */
+    const calibration_data &get_data() const {
+        return data;
+    }
+
+    /**
+     * Prints all values to the Serial line.
+     */
+    void print() const;
+
+};
+
+
+
+//class calibration
+
+inline calibration::calibration() {
+    set_defaults();
+}
+
+inline void calibration::set_defaults() {
+    data.magic = CALIBRATION_MAGIC;
+    data.flags = DEFAULT_CALIBRATION_FLAGS;
+    data.gains.kp = DEFAULT_KP;
+    data.gains.ki = DEFAULT_KI;
+    data.gains.kd = DEFAULT_KD;
+    data.cruise_speed = DEFAULT_CRUISE_SPEED;
+    data.loop_period = DEFAULT_LOOP_PERIOD;
+    data.tuning.move_min_time = DEFAULT_MOVE_MIN_TIME;
+    data.tuning.cross_center_time = DEFAULT_CROSS_CENTER_TIME;
+    data.tuning.turn_miss_time = DEFAULT_TURN_MISS_TIME;
+    data.tuning.turn_leave_time = DEFAULT_TURN_LEAVE_TIME;
+    data.tuning.smoothing_steps = SMOOTHING_STEPS;
+    data.tuning.smoothing_jump = (int16_t) (SMOOTHING_JUMP * 1000);
+    data.tuning.center_speed = DEFAULT_CENTER_SPEED;
+    data.tuning.turn_speed = DEFAULT_TURN_SPEED;
+    data.tuning.arc_sweep_time = DEFAULT_ARC_SWEEP_TIME;
+    data.tuning.arc_inner_speed = DEFAULT_ARC_INNER_SPEED;
+}
+
+bool calibration::load() {
+    EEPROM.get(EEPROM_CALIBRATION_ADDRESS, data);
+    if (data.magic != CALIBRATION_MAGIC) {
+        set_defaults();
+        return false;
+    }
+    return true;
+}
+
+bool calibration::store_step() {
+    /* Writing of one byte takes 3.3 ms, the previous one must be finished */
+    if (!hal_eeprom_ready()) {
+        return pending_offset < sizeof(data);
+    }
+    const uint8_t *bytes = (const uint8_t *) &data;
+    while (pending_offset < sizeof(data)) {
+        const int address = EEPROM_CALIBRATION_ADDRESS + pending_offset;
+        const uint8_t value = bytes[pending_offset++];
+        if (EEPROM.read(address) != value) {
+            EEPROM.write(address, value);
+            break;
+        }
+    }
+    return pending_offset < sizeof(data);
+}
+
+void calibration::print() const {
+    Serial.print(F("flags="));
+    Serial.print(data.flags);
+    Serial.print(F(" kp="));
+    Serial.print(data.gains.kp);
+    Serial.print(F(" ki="));
+    Serial.print(data.gains.ki);
+    Serial.print(F(" kd="));
+    Serial.print(data.gains.kd);
+    Serial.print(F(" cruise="));
+    Serial.print(data.cruise_speed);
+    Serial.print(F(" loop="));
+    Serial.print(data.loop_period);
+    Serial.print(F(" move="));
+    Serial.print(data.tuning.move_min_time);
+    Serial.print(F(" center="));
+    Serial.print(data.tuning.cross_center_time);
+    Serial.print(F(" miss="));
+    Serial.print(data.tuning.turn_miss_time);
+    Serial.print(F(" leave="));
+    Serial.print(data.tuning.turn_leave_time);
+    Serial.print(F(" steps="));
+    Serial.print(data.tuning.smoothing_steps);
+    Serial.print(F(" jump="));
+    Serial.print(data.tuning.smoothing_jump);
+    Serial.print(F(" cspeed="));
+    Serial.print(data.tuning.center_speed);
+    Serial.print(F(" tspeed="));
+    Serial.print(data.tuning.turn_speed);
+    Serial.print(F(" asweep="));
+    Serial.print(data.tuning.arc_sweep_time);
+    Serial.print(F(" ainner="));
+    Serial.println(data.tuning.arc_inner_speed);
+}
+
+#endif //CALIBRATION_HPP
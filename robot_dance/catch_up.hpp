@@ -0,0 +1,142 @@
+#ifndef CATCH_UP_HPP
+#define CATCH_UP_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+#include "location.h"
+
+/**
+ * Lateness in ms at the last waypoint, above which the robot catches up.
+ */
+#define CATCH_UP_THRESHOLD      (500)
+
+/**
+ * Lateness in ms of a waypoint when it is fetched, above which the waypoint is skipped.
+ */
+#define CATCH_UP_SKIP_THRESHOLD (3000)
+
+
+/**
+ * Policy re-synchronizing the robot with the time line of the dance, when it falls behind.
+ * The robot catches up when it arrived late by more than CATCH_UP_THRESHOLD, until it
+ * arrives on time again. Meanwhile it takes the axis order with fewer turns, regardless
+ * of the order given by the dance. If allowed, the waypoints which are already overdue
+ * by CATCH_UP_SKIP_THRESHOLD when they are fetched are skipped, except the last one.
+ */
+class catch_up_policy {
+
+    /**
+     * Defines if the robot is catching up.
+     */
+    bool active = false;
+
+    /**
+     * Counts the quarter turns from one direction to another.
+     *
+     * @param from Initial direction.
+     * @param to Desired direction, none means no turn.
+     * @return The number of the quarter turns.
+     */
+    static uint8_t count_turns(direction from, direction to) {
+        if (from == direction::NotSpecified || to == direction::NotSpecified) {
+            return 0;
+        }
+        const uint8_t difference = (uint8_t) ((to - from + 4) % 4);
+        return difference == 3 ? 1 : difference;
+    }
+
+    /**
+     * Counts the quarter turns of the route.
+     *
+     * @param source Initial location.
+     * @param target Target position.
+     * @param first_x Defines if the route goes along the X axis first.
+     * @return The number of the quarter turns.
+     */
+    static uint8_t count_route_turns(const location &source, const position &target, bool first_x);
+
+public:
+
+    /**
+     * Stops catching up, e.g. at the start of the dance.
+     */
+    void reset() {
+        active = false;
+    }
+
+    /**
+     * Updates the policy by the arrival at a waypoint with a time constraint.
+     *
+     * @param lateness Arrival time minus the time constraint in ms.
+     */
+    void update(int32_t lateness);
+
+    /**
+     * Defines if the robot is catching up.
+     *
+     * @return If the robot is catching up.
+     */
+    bool is_active() const {
+        return active;
+    }
+
+    /**
+     * Chooses the axis order of the route.
+     *
+     * @param source Initial location.
+     * @param target Target position.
+     * @param preferred Axis order given by the dance.
+     * @return If the route goes along the X axis first.
+     */
+    bool choose_first_x(const location &source, const position &target, bool preferred) const;
+
+    /**
+     * Decides if the fetched waypoint is skipped.
+     *
+     * @param deadline Time constraint of the waypoint in ms since the start of the dance, 0 if there is none.
+     * @param elapsed Current time in ms since the start of the dance.
+     * @return If the waypoint is overdue so much that it should be skipped.
+     */
+    bool should_skip(time_type deadline, time_type elapsed) const {
+        return active && deadline > 0 && elapsed > deadline + CATCH_UP_SKIP_THRESHOLD;
+    }
+
+};
+
+
+
+//class catch_up_policy
+
+uint8_t catch_up_policy::count_route_turns(const location &source, const position &target, bool first_x) {
+    const position move = target - source.get_position();
+    const direction first = first_x ? move.get_x_direction() : move.get_y_direction();
+    const direction second = first_x ? move.get_y_direction() : move.get_x_direction();
+
+    uint8_t turns = 0;
+    direction last = source.get_direction();
+    if (first != direction::NotSpecified) {
+        turns += count_turns(last, first);
+        last = first;
+    }
+    return turns + count_turns(last, second);
+}
+
+inline void catch_up_policy::update(int32_t lateness) {
+    if (lateness > CATCH_UP_THRESHOLD) {
+        active = true;
+    } else if (lateness <= 0) {
+        active = false;
+    }
+}
+
+bool catch_up_policy::choose_first_x(const location &source, const position &target, bool preferred) const {
+    if (!active) {
+        return preferred;
+    }
+    const uint8_t preferred_turns = count_route_turns(source, target, preferred);
+    const uint8_t other_turns = count_route_turns(source, target, !preferred);
+    return other_turns < preferred_turns ? !preferred : preferred;
+}
+
+#endif //CATCH_UP_HPP
@@ -2,8 +2,7 @@
 #ifndef COMMAND_PARSER_EEPROM_HPP
 #define COMMAND_PARSER_EEPROM_HPP
 
-#include <Arduino.h>
-#include <EEPROM.h>
+#include "hal.hpp"
 
 #include "planning.h"
 
@@ -77,6 +76,8 @@ public:
 
     virtual time_type get_finish_time_constrain() override;
 
+    virtual bool has_next() override;
+
     virtual bool store_character(const char &character) override;
 
     virtual void reset_commands() override;
@@ -205,6 +206,15 @@ time_type command_parser_eeprom::get_finish_time_constrain() {
     return parsed_time_constrain;
 }
 
+bool command_parser_eeprom::has_next() {
+    int address = current_address;
+    char next_character = (char) EEPROM.read(address);
+    while ((isblank(next_character) || next_character == '\n') && address + 1 < EEPROM_DANCE_END) {
+        next_character = (char) EEPROM.read(++address);
+    }
+    return isalnum(next_character);
+}
+
 bool command_parser_eeprom::store_character(const char &character) {
     /* Write magic for simple error detection */
     if (current_address == 0) {
@@ -212,8 +222,23 @@ bool command_parser_eeprom::store_character(const char &character) {
     }
 
     bool write_to_eeprom;
+    is_next_fetched = false;
     bool is_ok = parse_next_character(character, &write_to_eeprom);
 
+    /* Only the upload prints the waypoints, the fetch during the dance must not wait for the Serial line */
+    if (is_next_fetched) {
+        char buff[64];
+        sprintf(buff, "parsed pos=(%d,%d), time=%lu, x_preferred=%d", parsed_position.get_x(),
+                parsed_position.get_y(), parsed_time_constrain, is_x_preferred);
+        Serial.println(buff);
+    }
+
+    /* The end of the EEPROM is reserved for the calibration */
+    if (write_to_eeprom && current_address + 2 >= EEPROM_DANCE_END) {
+        Serial.println(F("Dance too long!"));
+        return false;
+    }
+
     if (write_to_eeprom) {
         EEPROM.write(current_address++, (byte) character);
         EEPROM.write(current_address + 0, ' ');
@@ -228,7 +253,7 @@ void command_parser_eeprom::reset_commands() {
     write_magic();
 
     /* Write default dance sequence */
-    for (int i = 0; i < sizeof(DEFAULT_DANCE) - 1; ++i) {
+    for (size_t i = 0; i < sizeof(DEFAULT_DANCE) - 1; ++i) {
         EEPROM.write(current_address++, (uint8_t) DEFAULT_DANCE[i]);
     }
     EEPROM.write(current_address + 0, ' ');
@@ -240,7 +265,7 @@ void command_parser_eeprom::reset_commands() {
 }
 
 bool command_parser_eeprom::check_magic() {
-    for (int i = 0; i < sizeof(MAGIC) - 1; ++i) {
+    for (size_t i = 0; i < sizeof(MAGIC) - 1; ++i) {
         if ((char) EEPROM.read(i) != MAGIC[i]) {
             return false;
         }
@@ -249,7 +274,7 @@ bool command_parser_eeprom::check_magic() {
 }
 
 void command_parser_eeprom::write_magic() {
-    for (; current_address < sizeof(MAGIC) - 1; ++current_address) {
+    for (; current_address < (int) sizeof(MAGIC) - 1; ++current_address) {
         EEPROM.write(current_address, (uint8_t) MAGIC[current_address]);
     }
     EEPROM.write(current_address++, ' ');
@@ -398,9 +423,6 @@ bool command_parser_eeprom::parse_next_character(const char &character, bool *wr
                 parsed_time_constrain *= 10;
                 parsed_time_constrain += character - '0';
             } else if (isblank(character) || character == '\n') {
-                sprintf(buff, "parsed pos=(%d,%d), time=%lu, x_preferred=%d", parsed_position.get_x(),
-                        parsed_position.get_y(), parsed_time_constrain, is_x_preferred);
-                Serial.println(buff);
                 is_next_fetched = true;
                 current_state = parser_state::NEXT;
             } else {
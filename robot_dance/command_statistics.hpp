@@ -0,0 +1,248 @@
+#ifndef COMMAND_STATISTICS_HPP
+#define COMMAND_STATISTICS_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+
+/**
+ * Kinds of the commands with separate statistics.
+ */
+#define COMMAND_MOVE            (0)
+#define COMMAND_TURN_LEFT       (1)
+#define COMMAND_TURN_RIGHT      (2)
+#define COMMAND_RECOVERY        (3)
+#define COMMAND_ARC             (4)
+#define COMMAND_KINDS           (5)
+
+/**
+ * Number of the duration buckets, the first one holds durations below 2^COMMAND_BUCKET_SHIFT ms,
+ * every next one twice as long durations and the last one all the longer ones.
+ */
+#define COMMAND_BUCKETS         (6)
+#define COMMAND_BUCKET_SHIFT    (7)
+
+/**
+ * Time budget of the commands in ms until enough of them were measured, then the budget is
+ * COMMAND_BUDGET_FACTOR times the upper bound of the longest bucket with a command.
+ */
+#define COMMAND_DEFAULT_BUDGET  (5000)
+#define COMMAND_BUDGET_SAMPLES  (4)
+#define COMMAND_BUDGET_FACTOR   (2)
+
+
+/**
+ * Durations and update calls of the finished commands of one kind.
+ */
+struct command_timing {
+    /**
+     * Number of the finished commands.
+     */
+    uint16_t count;
+
+    /**
+     * Shortest and longest duration in ms.
+     */
+    uint16_t min_duration;
+    uint16_t max_duration;
+
+    /**
+     * Sum of the durations in ms.
+     */
+    uint32_t total_duration;
+
+    /**
+     * Most update calls of one command, the calls of each command are in its telemetry event.
+     */
+    uint16_t max_updates;
+
+    /**
+     * Number of the commands abandoned after their time budget, saturated at 255.
+     */
+    uint8_t timeouts;
+
+    /**
+     * Numbers of the commands by the duration, saturated at 255.
+     */
+    uint8_t buckets[COMMAND_BUCKETS];
+};
+
+
+/**
+ * Always-on statistics of the command durations kept since the power-on, the data
+ * for the cost model of the planning. The commands report themselves when they finish.
+ */
+class command_statistics {
+
+    /**
+     * Statistics of every kind, see COMMAND_* kinds.
+     */
+    command_timing timings[COMMAND_KINDS];
+
+    /**
+     * Prints the statistics of one kind.
+     *
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     */
+    void print_timing(uint8_t kind) const;
+
+public:
+
+    /**
+     * Creates empty statistics.
+     */
+    command_statistics() {
+        clear();
+    }
+
+    /**
+     * Forgets all recorded commands.
+     */
+    void clear();
+
+    /**
+     * Records a finished command.
+     *
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     * @param duration Time from the first update to the finish in ms.
+     * @param updates Number of the update calls.
+     */
+    void record(uint8_t kind, time_type duration, uint16_t updates);
+
+    /**
+     * Records a command abandoned after its time budget, its duration is not recorded.
+     *
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     */
+    void record_timeout(uint8_t kind) {
+        if (timings[kind].timeouts < UINT8_MAX) {
+            ++timings[kind].timeouts;
+        }
+    }
+
+    /**
+     * Gets the time budget of a command derived from the durations of the finished ones.
+     *
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     * @return The longest time in ms the command may run.
+     */
+    time_type get_budget(uint8_t kind) const;
+
+    /**
+     * Gets the statistics of one kind.
+     *
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     * @return The statistics.
+     */
+    const command_timing &get_timing(uint8_t kind) const {
+        return timings[kind];
+    }
+
+    /**
+     * Prints the statistics of all kinds, one line per kind.
+     */
+    void print() const;
+
+};
+
+
+
+//class command_statistics
+
+inline void command_statistics::clear() {
+    memset(timings, 0, sizeof(timings));
+}
+
+inline void command_statistics::record(uint8_t kind, time_type duration, uint16_t updates) {
+    command_timing &timing = timings[kind];
+    const uint16_t clipped = (uint16_t) (duration < UINT16_MAX ? duration : UINT16_MAX);
+
+    if (timing.count < UINT16_MAX) {
+        ++timing.count;
+    }
+    if (timing.count == 1 || clipped < timing.min_duration) {
+        timing.min_duration = clipped;
+    }
+    if (clipped > timing.max_duration) {
+        timing.max_duration = clipped;
+    }
+    timing.total_duration += duration;
+    if (updates > timing.max_updates) {
+        timing.max_updates = updates;
+    }
+
+    uint8_t bucket = 0;
+    for (time_type rest = duration >> COMMAND_BUCKET_SHIFT; rest != 0 && bucket < COMMAND_BUCKETS - 1; rest >>= 1) {
+        ++bucket;
+    }
+    if (timing.buckets[bucket] < UINT8_MAX) {
+        ++timing.buckets[bucket];
+    }
+}
+
+inline time_type command_statistics::get_budget(uint8_t kind) const {
+    const command_timing &timing = timings[kind];
+    if (timing.count < COMMAND_BUDGET_SAMPLES) {
+        return COMMAND_DEFAULT_BUDGET;
+    }
+
+    /* Upper bound of the longest bucket, the last one has none but the longest duration */
+    uint8_t bucket = COMMAND_BUCKETS - 1;
+    while (bucket > 0 && timing.buckets[bucket] == 0) {
+        --bucket;
+    }
+    const time_type longest = bucket < COMMAND_BUCKETS - 1 ? (time_type) 1 << (COMMAND_BUCKET_SHIFT + bucket)
+                                                            : timing.max_duration;
+    return COMMAND_BUDGET_FACTOR * longest;
+}
+
+void command_statistics::print_timing(uint8_t kind) const {
+    const command_timing &timing = timings[kind];
+    switch (kind) {
+        case COMMAND_MOVE:
+            Serial.print(F("move: n="));
+            break;
+        case COMMAND_TURN_LEFT:
+            Serial.print(F("turn left: n="));
+            break;
+        case COMMAND_RECOVERY:
+            Serial.print(F("recovery: n="));
+            break;
+        case COMMAND_ARC:
+            Serial.print(F("arc: n="));
+            break;
+        case COMMAND_TURN_RIGHT:
+            Serial.print(F("turn right: n="));
+            break;
+        default:
+            Serial.print(F("unknown: n="));
+            break;
+    }
+    Serial.print(timing.count);
+    Serial.print(F(" mean="));
+    Serial.print(timing.count > 0 ? timing.total_duration / timing.count : 0);
+    Serial.print(F(" min="));
+    Serial.print(timing.min_duration);
+    Serial.print(F(" max="));
+    Serial.print(timing.max_duration);
+    Serial.print(F(" ms updates<="));
+    Serial.print(timing.max_updates);
+    Serial.print(F(" timeouts="));
+    Serial.print(timing.timeouts);
+    Serial.print(F(" buckets="));
+    for (uint8_t i = 0; i < COMMAND_BUCKETS; i++) {
+        if (i > 0) {
+            Serial.print(',');
+        }
+        Serial.print(timing.buckets[i]);
+    }
+    Serial.println();
+}
+
+void command_statistics::print() const {
+    for (uint8_t kind = 0; kind < COMMAND_KINDS; kind++) {
+        print_timing(kind);
+    }
+}
+
+#endif //COMMAND_STATISTICS_HPP
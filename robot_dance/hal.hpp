@@ -0,0 +1,78 @@
+
+#ifndef HAL_HPP
+#define HAL_HPP
+
+/*
+ * Hardware abstraction of the robot: clock, digital I/O, servos, EEPROM, Serial line
+ * and interrupts. The firmware uses the Arduino API, which is provided by the Arduino
+ * core on the AVR and by the virtual machine of 'hal_linux.hpp' on the PC.
+ * Only the pin change interrupt is not part of the Arduino API, it is wrapped here.
+ */
+
+#ifdef __AVR__
+
+#include <Arduino.h>
+#include <Servo.h>
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+
+/**
+ * Marks global firmware state, which must be separate for each simulated robot.
+ */
+#define HAL_THREAD_LOCAL
+
+/**
+ * Handler of the pin change interrupt of the digital pins 0-7.
+ */
+void (*volatile hal_pin_change_handler)(void) = nullptr;
+
+ISR(PCINT2_vect) {
+    hal_pin_change_handler();
+}
+
+/**
+ * Calls the handler on any change of the given digital pins 0-7.
+ *
+ * @param mask Bit mask of the pins.
+ * @param handler Interrupt service routine.
+ */
+inline void hal_attach_pin_change(uint8_t mask, void (*handler)(void)) {
+    hal_pin_change_handler = handler;
+    PCMSK2 = mask;
+    PCIFR |= bit(PCIF2);
+    PCICR |= bit(PCIE2);
+}
+
+/**
+ * Stops calling the pin change handler.
+ */
+inline void hal_detach_pin_change() {
+    PCICR &= (uint8_t) ~bit(PCIE2);
+    PCMSK2 = 0;
+}
+
+/**
+ * Reads the digital pins 0-7 at once.
+ *
+ * @return Bit mask of the pin values.
+ */
+inline uint8_t hal_read_pins() {
+    return PIND;
+}
+
+/**
+ * Checks if the EEPROM finished the previous write.
+ *
+ * @return If a byte can be written without waiting.
+ */
+inline bool hal_eeprom_ready() {
+    return eeprom_is_ready();
+}
+
+#else
+
+#include "hal_linux.hpp"
+
+#endif
+
+#endif //HAL_HPP
@@ -0,0 +1,605 @@
+
+#ifndef HAL_LINUX_HPP
+#define HAL_LINUX_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <type_traits>
+
+/*
+ * Linux backend of the hardware abstraction: a virtual machine implementing the used
+ * subset of the Arduino API. Time is virtual, it advances only by the modelled costs
+ * of the API calls and by delays, so the firmware runs as fast as the PC allows.
+ * The environment (simulator, test) observes the outputs and drives the inputs from
+ * the hook called whenever the time advances.
+ */
+
+#define HAL_THREAD_LOCAL    thread_local
+
+#define HAL_PINS            (20)
+#define HAL_EEPROM_SIZE     (1024)
+
+/**
+ * Size of the transmit buffer of the Serial line.
+ */
+#define HAL_SERIAL_BUFFER   (64)
+
+/**
+ * Virtual costs of the API calls in us, close to the ATmega328P at 16 MHz. A servo write includes
+ * the soft-float smoothing and the conversion of the speed to the pulse width before it.
+ */
+#define HAL_COST_CLOCK          (4)
+#define HAL_COST_DIGITAL_IO     (5)
+#define HAL_COST_SERVO          (150)
+#define HAL_COST_EEPROM_READ    (1)
+#define HAL_COST_SERIAL_BYTE    (2)
+
+/**
+ * Duration of the EEPROM byte write in us.
+ */
+#define HAL_EEPROM_WRITE_TIME   (3300)
+
+#define HIGH            (1)
+#define LOW             (0)
+#define INPUT           (0)
+#define OUTPUT          (1)
+#define INPUT_PULLUP    (2)
+#define CHANGE          (1)
+#define FALLING         (2)
+#define RISING          (3)
+#define NOT_AN_INTERRUPT    (-1)
+
+#define F(string_literal)   (string_literal)
+#define digitalPinToInterrupt(p)    ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+template<typename A, typename B>
+inline typename std::common_type<A, B>::type min(A a, B b) {
+    return a < b ? a : b;
+}
+
+template<typename A, typename B>
+inline typename std::common_type<A, B>::type max(A a, B b) {
+    return a > b ? a : b;
+}
+
+template<typename T, typename L, typename H>
+inline T constrain(T value, L low, H high) {
+    return value < low ? (T) low : (value > high ? (T) high : value);
+}
+
+
+/**
+ * State of one simulated microcontroller with its peripherals.
+ */
+struct hal_machine {
+
+    /**
+     * Virtual time in us.
+     */
+    uint64_t time = 0;
+
+    /**
+     * Called after every advance of the time, which reaches 'hook_time', not reentrant.
+     * The hook may move 'hook_time' to its next event to keep the busy waits fast.
+     */
+    void (*hook)(void *context) = nullptr;
+    void *hook_context = nullptr;
+    uint64_t hook_time = 0;
+    bool in_hook = false;
+
+    uint8_t pin_mode[HAL_PINS] = {};
+
+    /**
+     * Input values driven by the environment, output values written by the firmware.
+     */
+    uint8_t pin_value[HAL_PINS] = {};
+
+    /**
+     * Pulse width of the servo attached to each pin in us, 0 if no servo is attached.
+     */
+    uint16_t servo_pulse[HAL_PINS] = {};
+
+    uint8_t eeprom[HAL_EEPROM_SIZE];
+    uint64_t eeprom_ready_time = 0;
+    uint32_t eeprom_writes = 0;
+
+    void (*external_handler[2])(void) = {nullptr, nullptr};
+    int external_mode[2] = {LOW, LOW};
+    void (*pin_change_handler)(void) = nullptr;
+    uint8_t pin_change_mask = 0;
+
+    bool interrupts_enabled = true;
+    bool in_interrupt = false;
+
+    /**
+     * Interrupts raised while disabled: bits 0-1 external, bit 2 pin change.
+     */
+    uint8_t pending_interrupts = 0;
+
+    /**
+     * Bytes received by the Serial line and not read yet.
+     */
+    std::string serial_input;
+
+    /**
+     * All bytes sent by the Serial line, if 'serial_capture' is set.
+     */
+    std::string serial_output;
+    bool serial_capture = true;
+
+    /**
+     * Stream echoing the sent bytes, none if null.
+     */
+    FILE *serial_echo = nullptr;
+
+    /**
+     * Duration of one byte on the line in us, 0 if the line was not started.
+     */
+    uint32_t serial_byte_time = 0;
+
+    /**
+     * Time when the transmit buffer will be empty.
+     */
+    uint64_t serial_empty_time = 0;
+
+    /**
+     * Number of the writes which blocked on the full transmit buffer and their total wait in us.
+     */
+    uint32_t serial_stalls = 0;
+    uint64_t serial_stall_time = 0;
+
+    hal_machine() {
+        memset(eeprom, 0xFF, sizeof(eeprom));
+        /* Sensors read white and the button is released */
+        memset(pin_value, HIGH, sizeof(pin_value));
+    }
+
+};
+
+/**
+ * Machine of the current thread, the default one unless a simulator switches it.
+ */
+inline hal_machine *&hal_current() {
+    /* Constant initialized, the access needs no guard of the dynamic initialization */
+    static thread_local hal_machine *current = nullptr;
+    if (current == nullptr) {
+        static thread_local hal_machine default_machine;
+        current = &default_machine;
+    }
+    return current;
+}
+
+inline hal_machine &hal() {
+    return *hal_current();
+}
+
+inline void hal_service_interrupts();
+
+/**
+ * Advances the virtual time and lets the environment react.
+ *
+ * @param us Time in us.
+ */
+inline void hal_advance(uint64_t us) {
+    hal_machine &m = hal();
+    m.time += us;
+    if (m.hook != nullptr && m.time >= m.hook_time && !m.in_hook) {
+        m.in_hook = true;
+        m.hook(m.hook_context);
+        m.in_hook = false;
+    }
+}
+
+/**
+ * Runs the interrupt service routine or keeps it pending.
+ */
+inline void hal_raise_interrupt(uint8_t index) {
+    hal_machine &m = hal();
+    m.pending_interrupts |= (uint8_t) (1 << index);
+    hal_service_interrupts();
+}
+
+inline void hal_service_interrupts() {
+    hal_machine &m = hal();
+    while (m.pending_interrupts != 0 && m.interrupts_enabled && !m.in_interrupt) {
+        uint8_t index = 0;
+        while (!(m.pending_interrupts & (1 << index))) {
+            ++index;
+        }
+        m.pending_interrupts &= (uint8_t) ~(1 << index);
+
+        void (*handler)(void) = index < 2 ? m.external_handler[index] : m.pin_change_handler;
+        if (handler != nullptr) {
+            m.in_interrupt = true;
+            handler();
+            m.in_interrupt = false;
+        }
+    }
+}
+
+/**
+ * Sets the input value of the pin as the environment sees it, raises the interrupts.
+ *
+ * @param pin The digital pin.
+ * @param value HIGH or LOW.
+ */
+inline void hal_set_input(uint8_t pin, uint8_t value) {
+    hal_machine &m = hal();
+    if (m.pin_value[pin] == value) {
+        return;
+    }
+    m.pin_value[pin] = value;
+
+    if (pin < 8 && (m.pin_change_mask & (1 << pin)) && m.pin_change_handler != nullptr) {
+        hal_raise_interrupt(2);
+    }
+
+    const int interrupt = digitalPinToInterrupt(pin);
+    if (interrupt != NOT_AN_INTERRUPT && m.external_handler[interrupt] != nullptr) {
+        const int mode = m.external_mode[interrupt];
+        if (mode == CHANGE || ((mode == LOW || mode == FALLING) && value == LOW) || (mode == RISING && value == HIGH)) {
+            hal_raise_interrupt((uint8_t) interrupt);
+        }
+    }
+}
+
+/**
+ * Stores bytes to be received by the Serial line.
+ */
+inline void hal_serial_receive(const char *text) {
+    hal().serial_input += text;
+}
+
+
+/* Clock */
+
+inline unsigned long micros() {
+    hal_advance(HAL_COST_CLOCK);
+    return (unsigned long) (uint32_t) hal().time;
+}
+
+inline unsigned long millis() {
+    hal_advance(HAL_COST_CLOCK);
+    return (unsigned long) (uint32_t) (hal().time / 1000);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    hal_advance(us);
+}
+
+inline void delay(unsigned long ms) {
+    /* Small steps let the environment follow */
+    for (unsigned long i = 0; i < ms; ++i) {
+        hal_advance(1000);
+    }
+}
+
+
+/* Digital I/O */
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    hal().pin_mode[pin] = mode;
+}
+
+inline int digitalRead(uint8_t pin) {
+    hal_advance(HAL_COST_DIGITAL_IO);
+    return hal().pin_value[pin];
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    hal_advance(HAL_COST_DIGITAL_IO);
+    hal_machine &m = hal();
+    /* Writing to an input only switches its pull-up */
+    if (m.pin_mode[pin] == OUTPUT) {
+        m.pin_value[pin] = value;
+    }
+}
+
+inline uint8_t hal_read_pins() {
+    hal_advance(1);
+    uint8_t pins = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+        pins |= (uint8_t) ((hal().pin_value[i] & 1) << i);
+    }
+    return pins;
+}
+
+
+/* Interrupts */
+
+inline void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {
+    hal_machine &m = hal();
+    m.external_handler[interrupt] = handler;
+    m.external_mode[interrupt] = mode;
+}
+
+inline void detachInterrupt(uint8_t interrupt) {
+    hal().external_handler[interrupt] = nullptr;
+}
+
+inline void noInterrupts() {
+    hal().interrupts_enabled = false;
+}
+
+inline void interrupts() {
+    hal().interrupts_enabled = true;
+    hal_service_interrupts();
+}
+
+inline void hal_attach_pin_change(uint8_t mask, void (*handler)(void)) {
+    hal_machine &m = hal();
+    m.pin_change_mask = mask;
+    m.pin_change_handler = handler;
+}
+
+inline void hal_detach_pin_change() {
+    hal_machine &m = hal();
+    m.pin_change_mask = 0;
+    m.pin_change_handler = nullptr;
+}
+
+
+/* Servo */
+
+class Servo {
+
+    int8_t pin = -1;
+
+public:
+
+    uint8_t attach(int pin_p) {
+        pin = (int8_t) pin_p;
+        hal().servo_pulse[pin] = 1500;
+        return 0;
+    }
+
+    void detach() {
+        if (pin >= 0) {
+            hal().servo_pulse[pin] = 0;
+        }
+        pin = -1;
+    }
+
+    bool attached() const {
+        return pin >= 0;
+    }
+
+    void writeMicroseconds(int value) {
+        hal_advance(HAL_COST_SERVO);
+        if (pin >= 0) {
+            hal().servo_pulse[pin] = (uint16_t) constrain(value, 544, 2400);
+        }
+    }
+
+    int readMicroseconds() const {
+        return pin >= 0 ? hal().servo_pulse[pin] : 0;
+    }
+
+};
+
+
+/* EEPROM */
+
+class EEPROMClass {
+
+public:
+
+    uint8_t read(int address) {
+        hal_advance(HAL_COST_EEPROM_READ);
+        return hal().eeprom[address];
+    }
+
+    void write(int address, uint8_t value) {
+        hal_machine &m = hal();
+        /* The previous write must be finished */
+        if (m.time < m.eeprom_ready_time) {
+            hal_advance(m.eeprom_ready_time - m.time);
+        }
+        m.eeprom[address] = value;
+        m.eeprom_ready_time = m.time + HAL_EEPROM_WRITE_TIME;
+        ++m.eeprom_writes;
+    }
+
+    void update(int address, uint8_t value) {
+        if (read(address) != value) {
+            write(address, value);
+        }
+    }
+
+    uint16_t length() const {
+        return HAL_EEPROM_SIZE;
+    }
+
+    template<typename T>
+    T &get(int address, T &value) {
+        uint8_t *bytes = (uint8_t *) &value;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bytes[i] = read(address + (int) i);
+        }
+        return value;
+    }
+
+    template<typename T>
+    const T &put(int address, const T &value) {
+        const uint8_t *bytes = (const uint8_t *) &value;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            update(address + (int) i, bytes[i]);
+        }
+        return value;
+    }
+
+};
+
+static EEPROMClass EEPROM;
+
+inline bool hal_eeprom_ready() {
+    return hal().time >= hal().eeprom_ready_time;
+}
+
+
+/* Serial line */
+
+class HardwareSerial {
+
+    /**
+     * Number of bytes in the transmit buffer.
+     */
+    uint32_t pending() const {
+        const hal_machine &m = hal();
+        if (m.serial_byte_time == 0 || m.time >= m.serial_empty_time) {
+            return 0;
+        }
+        return (uint32_t) ((m.serial_empty_time - m.time + m.serial_byte_time - 1) / m.serial_byte_time);
+    }
+
+    size_t print_number(unsigned long value, int base, bool negative) {
+        char digits[8 * sizeof(long) + 2];
+        char *cursor = &digits[sizeof(digits) - 1];
+        *cursor = '\0';
+        if (base < 2) {
+            base = 10;
+        }
+        do {
+            const unsigned long digit = value % base;
+            *--cursor = (char) (digit < 10 ? '0' + digit : 'A' + digit - 10);
+            value /= base;
+        } while (value != 0);
+        if (negative) {
+            *--cursor = '-';
+        }
+        return print(cursor);
+    }
+
+public:
+
+    void begin(unsigned long baud) {
+        /* Start bit, 8 data bits and stop bit */
+        hal().serial_byte_time = (uint32_t) ((10 * 1000000ul + baud - 1) / baud);
+    }
+
+    int available() {
+        return (int) hal().serial_input.size();
+    }
+
+    int read() {
+        hal_machine &m = hal();
+        if (m.serial_input.empty()) {
+            return -1;
+        }
+        const int value = (uint8_t) m.serial_input[0];
+        m.serial_input.erase(0, 1);
+        return value;
+    }
+
+    int peek() {
+        return hal().serial_input.empty() ? -1 : (uint8_t) hal().serial_input[0];
+    }
+
+    int availableForWrite() {
+        return (int) (HAL_SERIAL_BUFFER - 1 - pending());
+    }
+
+    size_t write(uint8_t value) {
+        hal_machine &m = hal();
+        hal_advance(HAL_COST_SERIAL_BYTE);
+        if (m.serial_byte_time > 0) {
+            /* Blocks while the transmit buffer is full */
+            if (pending() >= HAL_SERIAL_BUFFER - 1) {
+                const uint64_t wait = m.serial_empty_time - (uint64_t) (HAL_SERIAL_BUFFER - 2) * m.serial_byte_time - m.time;
+                ++m.serial_stalls;
+                m.serial_stall_time += wait;
+                hal_advance(wait);
+            }
+            m.serial_empty_time = (m.serial_empty_time > m.time ? m.serial_empty_time : m.time) + m.serial_byte_time;
+        }
+        if (m.serial_capture) {
+            m.serial_output += (char) value;
+        }
+        if (m.serial_echo != nullptr) {
+            fputc(value, m.serial_echo);
+        }
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+    void flush() {
+        hal_machine &m = hal();
+        if (m.serial_byte_time > 0 && m.time < m.serial_empty_time) {
+            ++m.serial_stalls;
+            m.serial_stall_time += m.serial_empty_time - m.time;
+            hal_advance(m.serial_empty_time - m.time);
+        }
+    }
+
+    size_t print(const char *text) {
+        return write((const uint8_t *) text, strlen(text));
+    }
+
+    size_t print(char value) {
+        return write((uint8_t) value);
+    }
+
+    size_t print(unsigned char value, int base = 10) {
+        return print_number(value, base, false);
+    }
+
+    size_t print(int value, int base = 10) {
+        return print((long) value, base);
+    }
+
+    size_t print(unsigned int value, int base = 10) {
+        return print_number(value, base, false);
+    }
+
+    size_t print(long value, int base = 10) {
+        if (base == 10 && value < 0) {
+            return print_number(-(unsigned long) value, 10, true);
+        }
+        return print_number((unsigned long) value, base, false);
+    }
+
+    size_t print(unsigned long value, int base = 10) {
+        return print_number(value, base, false);
+    }
+
+    size_t print(double value, int digits = 2) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+        return print(buffer);
+    }
+
+    size_t println() {
+        return print("\r\n");
+    }
+
+    template<typename T>
+    size_t println(T value) {
+        const size_t n = print(value);
+        return n + println();
+    }
+
+    template<typename T>
+    size_t println(T value, int format) {
+        const size_t n = print(value, format);
+        return n + println();
+    }
+
+};
+
+static HardwareSerial Serial;
+
+#endif //HAL_LINUX_HPP
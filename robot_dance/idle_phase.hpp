@@ -0,0 +1,202 @@
+
+#ifndef IDLE_PHASE_HPP
+#define IDLE_PHASE_HPP
+
+#include "hal.hpp"
+
+#include "boe_bot.hpp"
+
+/**
+ * Remaining time in us, below which no background task is started.
+ */
+#define IDLE_TASK_GUARD     (2000)
+
+/**
+ * Maximal number of background tasks.
+ */
+#define IDLE_MAX_TASKS      (8)
+
+
+/**
+ * Background task run in the slack of the waiting, must return within a fraction of IDLE_TASK_GUARD.
+ *
+ * @return If the task has more work to do.
+ */
+typedef bool (*idle_task)();
+
+
+/**
+ * Cooperative waiting for the time constraint of the route. Holds the robot on the cross
+ * by small sensor-based corrections at the period of the loop scheduler, runs the background
+ * tasks round robin in the remaining time and leaves exactly at the deadline
+ * (or right away when the robot should go home). The hold steps are not recorded
+ * in the statistics of the loop scheduler, which measure the control of the commands.
+ */
+class idle_phase {
+
+    /**
+     * Robot to be held on the cross.
+     */
+    boe_bot *robot;
+
+    /**
+     * Registered background tasks.
+     */
+    idle_task tasks[IDLE_MAX_TASKS];
+
+    /**
+     * Number of registered background tasks.
+     */
+    uint8_t task_count = 0;
+
+    /**
+     * Length of the last waiting in us.
+     */
+    time_type last_slack = 0;
+
+    /**
+     * Time spent in the background tasks during the last waiting in us.
+     */
+    time_type last_work = 0;
+
+    /**
+     * Number of background task steps during the last waiting.
+     */
+    uint16_t last_steps = 0;
+
+    /**
+     * Time between the deadline and the end of the last waiting in us.
+     */
+    time_type last_exit_delay = 0;
+
+    /**
+     * Sum of all waitings since the reset in ms.
+     */
+    time_type total_slack = 0;
+
+    /**
+     * Sum of the time spent in the background tasks since the reset in us.
+     */
+    time_type total_work = 0;
+
+public:
+
+    /**
+     * Creates the idle phase for the given robot.
+     *
+     * @param robot_p Robot to be held on the cross.
+     */
+    explicit idle_phase(boe_bot *robot_p);
+
+    /**
+     * Registers a background task.
+     *
+     * @param task The task to be run in the slack.
+     * @return If the task could be registered.
+     */
+    bool add_task(idle_task task);
+
+    /**
+     * Clears the totals of the dance.
+     */
+    void reset_statistics();
+
+    /**
+     * Holds the robot and runs the background tasks until the deadline.
+     *
+     * @param deadline Time in ms (as returned by millis()) to leave at.
+     */
+    void wait_until(time_type deadline);
+
+    /**
+     * Sends the statistics of the last waiting to the telemetry.
+     */
+    void report_last() const;
+
+    /**
+     * Prints the totals of the dance.
+     */
+    void print_totals() const;
+
+};
+
+
+
+//class idle_phase
+
+inline idle_phase::idle_phase(boe_bot *robot_p) : robot(robot_p) {}
+
+inline bool idle_phase::add_task(idle_task task) {
+    if (task_count >= IDLE_MAX_TASKS) {
+        return false;
+    }
+    tasks[task_count++] = task;
+    return true;
+}
+
+inline void idle_phase::reset_statistics() {
+    total_slack = 0;
+    total_work = 0;
+}
+
+void idle_phase::wait_until(time_type deadline) {
+    const time_type started = micros();
+    const long remaining = (long) (deadline - millis());
+    const time_type end = started + (remaining > 0 ? (time_type) remaining * 1000 : 0);
+
+    /* Bit mask of the tasks which finished their work */
+    uint8_t finished = 0;
+    const uint8_t all_finished = (uint8_t) ((1 << task_count) - 1);
+    uint8_t next_task = 0;
+
+    last_work = 0;
+    last_steps = 0;
+
+    /* The hold steps are paced apart from the control of the commands */
+    loop_scheduler hold;
+    hold.set_period(robot->get_scheduler().get_period());
+    hold.start(started);
+
+    time_type now;
+    while ((long) (end - (now = micros())) > 0 && !robot->do_go_home()) {
+        if (hold.is_due(now)) {
+            robot->read_sensors();
+            robot->apply(lookup_primitive(HOLD_TABLE, robot->get_sensors().get_pattern()));
+            hold.end_step(micros());
+        } else if (finished != all_finished && (long) (end - now) > IDLE_TASK_GUARD) {
+            while (finished & (1 << next_task)) {
+                next_task = (uint8_t) ((next_task + 1) % task_count);
+            }
+            if (!tasks[next_task]()) {
+                finished |= 1 << next_task;
+            }
+            next_task = (uint8_t) ((next_task + 1) % task_count);
+            last_work += micros() - now;
+            ++last_steps;
+        }
+    }
+
+    robot->stop();
+
+    /* The waiting is no period of the control loop */
+    robot->get_scheduler().resume(micros());
+
+    last_exit_delay = (long) (now - end) > 0 ? now - end : 0;
+    last_slack = now - started;
+    total_slack += last_slack / 1000;
+    total_work += last_work;
+}
+
+void idle_phase::report_last() const {
+    robot->get_telemetry().idle(millis(), last_slack / 1000, last_work, last_steps, last_exit_delay);
+}
+
+void idle_phase::print_totals() const {
+    Serial.print(F("idle total: slack "));
+    Serial.print(total_slack);
+    Serial.print(F(" ms, background work "));
+    Serial.print(total_work);
+    Serial.println(F(" us"));
+}
+
+#endif //IDLE_PHASE_HPP
@@ -0,0 +1,313 @@
+#ifndef line_controller_h_
+#define line_controller_h_
+
+#include <stdint.h>
+
+#include "robot_dance.hpp"
+#include "sensor_patterns.h"
+
+/**
+ * Estimated line offset corresponding to the distance between two neighbouring sensors.
+ */
+#define LINE_OFFSET_PITCH       (64)
+
+/**
+ * Maximal absolute value of the output correction (full speed difference).
+ */
+#define LINE_CORRECTION_MAX     (1000)
+
+/**
+ * Limit of the integrated offset in offset units times milliseconds.
+ */
+#define LINE_INTEGRAL_MAX       ((int32_t) LINE_OFFSET_PITCH * 1000)
+
+/**
+ * Number of the control steps the steering trim is averaged over.
+ */
+#define LINE_TRIM_STEPS         (2048)
+
+/**
+ * Default gains and speed of the line following.
+ */
+#define DEFAULT_KP                  (1600)
+#define DEFAULT_KI                  (64)
+#define DEFAULT_KD                  (48)
+#define DEFAULT_CRUISE_SPEED        (600)
+
+
+/**
+ * Fixed-point gains of the line controller, 256 means 1.0.
+ */
+struct line_controller_gains {
+    /**
+     * Correction in permille per offset unit.
+     */
+    int16_t kp;
+
+    /**
+     * Correction in permille per offset unit held for one second.
+     */
+    int16_t ki;
+
+    /**
+     * Correction in permille per offset unit per second.
+     */
+    int16_t kd;
+};
+
+
+/**
+ * Fixed-point PID controller keeping the line under the middle sensor.
+ * The line offset is estimated from the weighted sensor pattern, positions between
+ * the digital sensors are interpolated from the times of the previous pattern changes.
+ * Positive offset means the line is on the right side of the robot.
+ */
+class line_controller {
+
+    /**
+     * Offset measured from the current sensor pattern.
+     */
+    int16_t measured;
+
+    /**
+     * Defines if any pattern was measured since the reset.
+     */
+    bool has_measurement;
+
+    /**
+     * Offset of the boundary crossed at the last change of the measured offset.
+     */
+    int16_t edge_offset;
+
+    /**
+     * Time of the last change of the measured offset.
+     */
+    time_type edge_time;
+
+    /**
+     * Estimated movement of the line in offset units per second.
+     */
+    int16_t rate;
+
+    /**
+     * Integrated offset in offset units times milliseconds.
+     */
+    int32_t integral;
+
+    /**
+     * Time of the last update.
+     */
+    time_type last_time;
+
+    /**
+     * Last estimated offset.
+     */
+    int16_t offset;
+
+    /**
+     * Running average of the corrections times LINE_TRIM_STEPS, the steering which keeps the robot straight.
+     */
+    int32_t trim_sum;
+
+    /**
+     * Computes the offset measured by the sensors, sensors without line
+     * continue in the direction the line was moving.
+     *
+     * @param pattern Current sensor pattern.
+     * @return The measured offset.
+     */
+    int16_t measure(uint8_t pattern) const;
+
+    /**
+     * Checks if the pattern shows a perpendicular line, which hides the followed one.
+     *
+     * @param pattern Current sensor pattern.
+     * @return If more than two sensors are black.
+     */
+    static bool is_cross(uint8_t pattern);
+
+    /**
+     * Limits the value to the given interval.
+     *
+     * @param value Value to be limited.
+     * @param low Lower bound of the interval.
+     * @param high Upper bound of the interval.
+     * @return The limited value.
+     */
+    static int32_t saturate(int32_t value, int32_t low, int32_t high) {
+        return value < low ? low : (value > high ? high : value);
+    }
+
+public:
+
+    /**
+     * Creates a controller without any history.
+     */
+    line_controller();
+
+    /**
+     * Forgets all history, must be called before following a new line segment.
+     */
+    void reset();
+
+    /**
+     * Processes a new sensor pattern and computes the steering correction.
+     *
+     * @param pattern Current sensor pattern.
+     * @param now Current time in ms.
+     * @param gains Gains of the controller.
+     * @return Correction in permille, positive value means turning right.
+     */
+    int16_t update(uint8_t pattern, time_type now, const line_controller_gains &gains);
+
+    /**
+     * Keeps the heading while nothing is known about the followed line, e.g. over a gap in it.
+     *
+     * @param now Current time in ms.
+     * @return Average correction of the recent control steps, it compensates the wheel asymmetry.
+     */
+    int16_t hold(time_type now);
+
+    /**
+     * Gets the last estimated offset of the line.
+     *
+     * @return The last estimated offset of the line.
+     */
+    int16_t get_offset() const {
+        return offset;
+    }
+
+    /**
+     * Gets the estimated movement of the line.
+     *
+     * @return The estimated movement of the line in offset units per second.
+     */
+    int16_t get_rate() const {
+        return rate;
+    }
+
+};
+
+
+
+//class line_controller
+
+inline line_controller::line_controller() {
+    reset();
+}
+
+inline void line_controller::reset() {
+    measured = 0;
+    has_measurement = false;
+    edge_offset = 0;
+    edge_time = 0;
+    rate = 0;
+    integral = 0;
+    last_time = 0;
+    offset = 0;
+    trim_sum = 0;
+}
+
+inline bool line_controller::is_cross(uint8_t pattern) {
+    uint8_t black = 0;
+    for (uint8_t bits = pattern; bits != 0; bits >>= 1) {
+        black += bits & 1;
+    }
+    return black > 2;
+}
+
+inline int16_t line_controller::measure(uint8_t pattern) const {
+    int16_t sum = 0;
+    int8_t count = 0;
+
+    if (pattern & PATTERN_SECOND_LEFT) {
+        sum -= LINE_OFFSET_PITCH;
+        ++count;
+    }
+    if (pattern & PATTERN_MIDDLE) {
+        ++count;
+    }
+    if (pattern & PATTERN_SECOND_RIGHT) {
+        sum += LINE_OFFSET_PITCH;
+        ++count;
+    }
+    if (count > 0) {
+        return sum / count;
+    }
+
+    /* Outer sensors are used only when none of the inner ones sees the line */
+    bool outer_left = (pattern & PATTERN_FIRST_LEFT) != 0;
+    bool outer_right = (pattern & PATTERN_FIRST_RIGHT) != 0;
+    if (outer_left != outer_right) {
+        return outer_left ? -2 * LINE_OFFSET_PITCH : 2 * LINE_OFFSET_PITCH;
+    }
+
+    /* The line is between the sensors (or lost), continue in its direction */
+    int16_t direction = rate != 0 ? rate : measured;
+    if (direction > 0 && measured < 2 * LINE_OFFSET_PITCH) {
+        return measured + LINE_OFFSET_PITCH / 2;
+    }
+    if (direction < 0 && measured > -2 * LINE_OFFSET_PITCH) {
+        return measured - LINE_OFFSET_PITCH / 2;
+    }
+    return measured;
+}
+
+inline int16_t line_controller::update(uint8_t pattern, time_type now, const line_controller_gains &gains) {
+    if (has_measurement && is_cross(pattern)) {
+        last_time = now;
+        return (int16_t) saturate((int32_t) gains.ki * (integral / 1000) / 256, -LINE_CORRECTION_MAX, LINE_CORRECTION_MAX);
+    }
+
+    int16_t new_measured = measure(pattern);
+
+    if (!has_measurement) {
+        has_measurement = true;
+        measured = new_measured;
+        edge_offset = new_measured;
+        edge_time = now;
+        last_time = now;
+    } else if (new_measured != measured) {
+        /* The line crossed the boundary between two readings */
+        int16_t new_edge = (int16_t) ((measured + new_measured) / 2);
+        time_type edge_duration = now - edge_time;
+
+        if (edge_duration > 0 && (int32_t) (new_edge - edge_offset) * (new_measured - measured) > 0) {
+            int32_t new_rate = (int32_t) (new_edge - edge_offset) * 1000 / (int32_t) edge_duration;
+            rate = (int16_t) saturate(new_rate, -INT16_MAX, INT16_MAX);
+        } else {
+            rate = 0;
+        }
+
+        measured = new_measured;
+        edge_offset = new_edge;
+        edge_time = now;
+    }
+
+    /* Interpolate between the edges, but stay within the current reading */
+    int32_t estimate = edge_offset + (int32_t) rate * (int32_t) (now - edge_time) / 1000;
+    offset = (int16_t) saturate(estimate, measured - LINE_OFFSET_PITCH / 4, measured + LINE_OFFSET_PITCH / 4);
+    if (offset != estimate) {
+        /* The line stays in the reading longer than its movement predicts, it does not move any more */
+        rate = 0;
+    }
+
+    time_type dt = now - last_time;
+    last_time = now;
+    integral = saturate(integral + (int32_t) offset * (int32_t) dt, -LINE_INTEGRAL_MAX, LINE_INTEGRAL_MAX);
+
+    int32_t correction = saturate(((int32_t) gains.kp * offset
+                                   + (int32_t) gains.ki * (integral / 1000)
+                                   + (int32_t) gains.kd * rate) / 256, -LINE_CORRECTION_MAX, LINE_CORRECTION_MAX);
+    trim_sum += correction - trim_sum / LINE_TRIM_STEPS;
+
+    return (int16_t) correction;
+}
+
+inline int16_t line_controller::hold(time_type now) {
+    /* Nothing is known about the followed line, the robot goes on as it went on average */
+    last_time = now;
+    return (int16_t) (trim_sum / LINE_TRIM_STEPS);
+}
+
+#endif
@@ -0,0 +1,281 @@
+#ifndef loop_scheduler_h_
+#define loop_scheduler_h_
+
+#include <stdint.h>
+
+#include "robot_dance.hpp"
+
+/**
+ * Default period of the control loop in us, 0 means free-running.
+ */
+#define DEFAULT_LOOP_PERIOD     (700)
+
+
+/**
+ * Paces the sensor-read/update step of the control loop by a micros() deadline
+ * and records the achieved periods. A tick which starts later than one whole
+ * period after its deadline is an overrun, the deadlines are then restarted
+ * from the current time instead of being caught up.
+ */
+class loop_scheduler {
+
+    /**
+     * Desired period in us.
+     */
+    time_type period = DEFAULT_LOOP_PERIOD;
+
+    /**
+     * Deadline of the next tick in us.
+     */
+    time_type next_deadline = 0;
+
+    /**
+     * Time of the last tick in us.
+     */
+    time_type last_tick = 0;
+
+    /**
+     * Defines if any tick happened since the start.
+     */
+    bool ticked = false;
+
+    /**
+     * Number of measured periods.
+     */
+    uint32_t count = 0;
+
+    /**
+     * Sum of the measured periods in us.
+     */
+    uint32_t period_sum = 0;
+
+    /**
+     * Shortest measured period in us.
+     */
+    time_type min_period = 0;
+
+    /**
+     * Longest measured period in us.
+     */
+    time_type max_period = 0;
+
+    /**
+     * Number of ticks started after the following deadline had passed.
+     */
+    uint16_t overruns = 0;
+
+    /**
+     * Number of control steps which reported their end.
+     */
+    uint32_t steps = 0;
+
+    /**
+     * Sum of the durations of the control steps in us, the CPU time of the control.
+     */
+    uint32_t busy_sum = 0;
+
+    /**
+     * Longest control step in us.
+     */
+    time_type max_busy = 0;
+
+public:
+
+    /**
+     * Sets the desired period.
+     *
+     * @param period_p Period in us, 0 means free-running.
+     */
+    void set_period(time_type period_p) {
+        period = period_p;
+    }
+
+    /**
+     * Gets the desired period.
+     *
+     * @return The period in us.
+     */
+    time_type get_period() const {
+        return period;
+    }
+
+    /**
+     * Clears the statistics and schedules the first tick immediately.
+     *
+     * @param now Current time in us.
+     */
+    void start(time_type now);
+
+    /**
+     * Schedules the next tick immediately, keeps the statistics.
+     * The pause since the last tick is not measured.
+     *
+     * @param now Current time in us.
+     */
+    void resume(time_type now);
+
+    /**
+     * Checks if the next tick is due, records its period if so.
+     *
+     * @param now Current time in us.
+     * @return If the control step should be run now.
+     */
+    bool is_due(time_type now);
+
+    /**
+     * Records the end of the control step started by the last due tick.
+     *
+     * @param now Current time in us.
+     */
+    void end_step(time_type now);
+
+    /**
+     * Gets number of measured periods.
+     *
+     * @return Number of measured periods.
+     */
+    uint32_t get_count() const {
+        return count;
+    }
+
+    /**
+     * Gets shortest measured period.
+     *
+     * @return The period in us.
+     */
+    time_type get_min_period() const {
+        return min_period;
+    }
+
+    /**
+     * Gets longest measured period.
+     *
+     * @return The period in us.
+     */
+    time_type get_max_period() const {
+        return max_period;
+    }
+
+    /**
+     * Gets mean measured period.
+     *
+     * @return The period in us, 0 if nothing was measured.
+     */
+    time_type get_mean_period() const {
+        return count > 0 ? period_sum / count : 0;
+    }
+
+    /**
+     * Gets number of overruns.
+     *
+     * @return Number of ticks started after the following deadline had passed.
+     */
+    uint16_t get_overruns() const {
+        return overruns;
+    }
+
+    /**
+     * Gets number of the control steps which reported their end.
+     *
+     * @return Number of steps.
+     */
+    uint32_t get_steps() const {
+        return steps;
+    }
+
+    /**
+     * Gets time spent in the control steps.
+     *
+     * @return The time in us.
+     */
+    uint32_t get_busy_time() const {
+        return busy_sum;
+    }
+
+    /**
+     * Gets mean duration of the control step.
+     *
+     * @return The duration in us, 0 if nothing was measured.
+     */
+    time_type get_mean_busy() const {
+        return steps > 0 ? busy_sum / steps : 0;
+    }
+
+    /**
+     * Gets longest control step.
+     *
+     * @return The duration in us.
+     */
+    time_type get_max_busy() const {
+        return max_busy;
+    }
+
+};
+
+
+
+//class loop_scheduler
+
+inline void loop_scheduler::start(time_type now) {
+    resume(now);
+    count = 0;
+    period_sum = 0;
+    min_period = 0;
+    max_period = 0;
+    overruns = 0;
+    steps = 0;
+    busy_sum = 0;
+    max_busy = 0;
+}
+
+inline void loop_scheduler::resume(time_type now) {
+    next_deadline = now;
+    ticked = false;
+}
+
+inline bool loop_scheduler::is_due(time_type now) {
+    /* Signed difference survives the overflow of micros() */
+    const int32_t lateness = (int32_t) (uint32_t) (now - next_deadline);
+    if (lateness < 0) {
+        return false;
+    }
+
+    if (ticked) {
+        const time_type measured = now - last_tick;
+        if (count == 0 || measured < min_period) {
+            min_period = measured;
+        }
+        if (measured > max_period) {
+            max_period = measured;
+        }
+        if (period_sum <= UINT32_MAX - measured) {
+            period_sum += measured;
+            ++count;
+        }
+    }
+    ticked = true;
+    last_tick = now;
+
+    if (period > 0 && (time_type) lateness >= period) {
+        if (overruns < UINT16_MAX) {
+            ++overruns;
+        }
+        next_deadline = now + period;
+    } else {
+        next_deadline += period;
+    }
+    return true;
+}
+
+inline void loop_scheduler::end_step(time_type now) {
+    const time_type busy = now - last_tick;
+    if (busy > max_busy) {
+        max_busy = busy;
+    }
+    if (busy_sum <= UINT32_MAX - busy) {
+        busy_sum += busy;
+        ++steps;
+    }
+}
+
+#endif
@@ -2,6 +2,40 @@
 #define move_command_h_
 
 #include "boe_bot_command_base.h"
+#include "line_controller.h"
+
+/**
+ * Time in ms the move goes on after all sensors lost the line, it holds the heading if the line
+ * disappeared under the middle sensor (a gap), otherwise it steers after the line.
+ */
+#define MOVE_LOST_COAST_TIME    (600)
+
+/**
+ * Time in ms of the first swing of the line search, every next swing reaches half of it farther to the other side.
+ */
+#define MOVE_SWEEP_TIME         (150)
+
+/**
+ * Longest turn in ms of the line search to either side of the heading, the perpendicular lines are left aside.
+ */
+#define MOVE_SWEEP_MAX          (450)
+
+/**
+ * Time in ms of the line search, then the robot turns back to its heading and stands until the watchdog abandons the move.
+ */
+#define MOVE_SEARCH_TIME        (2500)
+
+/**
+ * Longest time in ms between the outer sensors entering the cross line, the heading is not corrected
+ * if only one of them finds it, e.g. on a corner.
+ */
+#define CROSS_SKEW_WAIT         (80)
+
+/**
+ * In-place turn time per entry skew of the outer sensors in permille, when the move and the turn go at
+ * the same wheel speed. It is half of the wheel base over the distance of the outer sensors.
+ */
+#define CROSS_SKEW_GAIN         (820)
 
 
 /**
@@ -24,15 +58,116 @@ class move_command : public boe_bot_command_base {
      */
     time_type cross_encountered_time;
 
+    /**
+     * End of the in-place heading correction on the cross in us, 0 until the entry skew is measured.
+     */
+    time_type correction_end = 0;
+
+    /**
+     * Defines if the heading correction turns left.
+     */
+    bool correction_left = false;
+
+    /**
+     * Time in ms of driving on at the cruise speed from the cross line to the stop predicted
+     * by the tile odometry, 0 for the centering at the center speed.
+     */
+    time_type center_time = 0;
+
     /**
      * Time of start of this command.
      */
     time_type move_started = 0;
 
     /**
-     * Move the robot so that it follows the line.
+     * Steering controller following the line.
+     */
+    line_controller controller;
+
+    /**
+     * Time when all sensors lost the line in ms, 0 while the line is seen.
+     */
+    time_type line_lost_time = 0;
+
+    /**
+     * Time of the loss of the line in ms, 0 since the middle sensor found it again.
+     */
+    time_type recovery_started = 0;
+
+    /**
+     * Defines if the robot had to search for the line since the loss.
+     */
+    bool searched = false;
+
+    /**
+     * Last sensor pattern with the line, it tells where the line was lost.
+     */
+    uint8_t last_line_pattern = PATTERN_MIDDLE;
+
+    /**
+     * Defines the side of the current swing of the line search.
+     */
+    bool sweep_left = true;
+
+    /**
+     * Time of the start of the current swing in ms.
+     */
+    time_type sweep_started = 0;
+
+    /**
+     * Length of the current swing in ms, 0 until the line search starts.
+     */
+    time_type sweep_time = 0;
+
+    /**
+     * Turn of the current swing beyond the heading before the search in ms, 0 for the swing back to the heading.
+     */
+    time_type sweep_reach = 0;
+
+    /**
+     * Move the robot so that it follows the line, or searches for it when it was lost.
+     *
+     * @param speed Desired speed of the line following, used only by the PID steering.
+     */
+    void go_straight(double speed);
+
+    /**
+     * Steers the robot along the line by the current sensor pattern.
+     *
+     * @param speed Desired speed of the line following, used only by the PID steering.
+     * @param pattern Current sensor pattern.
+     * @param hold Defines if the heading is held instead, nothing being known about the line.
+     */
+    void follow_line(double speed, uint8_t pattern, bool hold);
+
+    /**
+     * Continues without the line: goes on for a while, then swings in place with growing but bounded
+     * swings starting on the side where the line is estimated, until an inner sensor finds the line.
+     * The move keeps its destination, the cross is not looked for during the search.
+     *
+     * @param speed Desired speed of the line following, used only by the PID steering.
+     * @param pattern Current sensor pattern.
      */
-    void go_straight();
+    void search_line(double speed, uint8_t pattern);
+
+    /**
+     * Defines if the robot swings in place searching for the line.
+     *
+     * @return If the line search is in progress.
+     */
+    bool is_searching() const {
+        return sweep_time > 0;
+    }
+
+    /**
+     * Defines if the line was lost and the middle sensor did not find it yet. The outer sensors
+     * finding the line at an angle must not be taken for a cross meanwhile.
+     *
+     * @return If the robot is getting back to the lost line.
+     */
+    bool is_recovering() const {
+        return recovery_started != 0;
+    }
 
     /**
      * Moves straight until it finds a cross (or partial cross = corner).
@@ -40,11 +175,25 @@ class move_command : public boe_bot_command_base {
     void encounter_cross();
 
     /**
-     * Corrects the robot based on sensor encounter sequence immediately
-     * after cross encounter.
+     * Corrects the robot based on sensor encounter sequence immediately after cross encounter.
+     * With CALIBRATION_SKEW_CORRECTION the skew of the times the outer sensors entered the cross
+     * line, together with the speed, gives the heading error and the robot turns in place
+     * in proportion to it.
      */
     void do_sensors_correction_on_cross();
 
+    /**
+     * Computes the heading correction from the entry skew of the outer sensors.
+     */
+    void measure_skew();
+
+    /**
+     * Learns the approach to the cross line and predicts the stop on the cross from it.
+     *
+     * @param approach Time from the start of the move to the cross line in ms.
+     */
+    void predict_stop(time_type approach);
+
     /**
      * Move the robot forwards until the sensors are out of the cross.
      * Makes the robot centered on the cross.
@@ -93,53 +242,188 @@ void move_command::set(boe_bot *robot_p, const location &final_location_p) {
     cross_encountered = false;
     cross_corrected = false;
     cross_encountered_time = 0;
+    correction_end = 0;
+    center_time = 0;
+    controller.reset();
+    line_lost_time = 0;
+    recovery_started = 0;
+    searched = false;
+    last_line_pattern = PATTERN_MIDDLE;
+    sweep_time = 0;
 }
 
-inline void move_command::go_straight() {
-    if (robot->get_sensors().middle()) {
-        robot->half_forward();
-    }
-    if (robot->get_sensors().second_right()) {
-        robot->slightly_right();
+inline void move_command::go_straight(double speed) {
+    const uint8_t pattern = robot->get_sensors().get_pattern();
+
+    /* The search ends when an inner sensor finds the line, the outer ones may see a crossing line */
+    if (pattern == 0 || (is_searching() && (pattern & PATTERN_INNER) == 0)) {
+        search_line(speed, pattern);
         return;
     }
-    if (robot->get_sensors().second_left()) {
-        robot->slightly_left();
-        return;
+
+    if (is_searching()) {
+        /* The history of the controller does not apply to the found line */
+        controller.reset();
+        sweep_time = 0;
+        searched = true;
     }
-    /* If the sensors are located so that the line is between them */
-    this->robot->quarter_forward();
+    line_lost_time = 0;
+    if (is_recovering() && (pattern & PATTERN_MIDDLE) != 0) {
+        const time_type now = millis();
+        robot->get_telemetry().line_found(now, now - recovery_started, searched);
+        recovery_started = 0;
+        searched = false;
+    }
+    last_line_pattern = pattern;
+    follow_line(speed, pattern, false);
 };
 
+inline void move_command::follow_line(double speed, uint8_t pattern, bool hold) {
+    if (robot->get_calibration().has_flag(CALIBRATION_PID_STEERING)) {
+        const line_controller_gains &gains = robot->get_calibration().get_gains();
+        int16_t correction = hold ? controller.hold(millis()) : controller.update(pattern, millis(), gains);
+        robot->steer(speed, correction / (double) LINE_CORRECTION_MAX);
+    } else {
+        /* The middle sensor sets the half speed first, the smoothing of the table primitive restarts from it */
+        if ((pattern & PATTERN_MIDDLE) != 0) {
+            robot->half_forward();
+        }
+        robot->apply(lookup_primitive(GO_STRAIGHT_TABLE, pattern));
+    }
+}
+
+void move_command::search_line(double speed, uint8_t pattern) {
+    const time_type now = millis();
+    if (line_lost_time == 0) {
+        line_lost_time = now;
+    }
+    if (recovery_started == 0) {
+        recovery_started = now;
+    }
+    const time_type lost = now - line_lost_time;
+
+    if (lost < MOVE_LOST_COAST_TIME) {
+        /* Over a gap the line is taken as still under the middle sensor and the heading is held, a line escaping
+         * aside is followed by its estimated offset, past the cross line the line may end on the border */
+        const bool gap = (last_line_pattern & PATTERN_MIDDLE) != 0;
+        follow_line(speed, gap ? PATTERN_MIDDLE : pattern, gap || cross_encountered);
+        return;
+    }
+
+    if (!is_searching()) {
+        /* The first swing goes to the side where the controller estimates the line */
+        sweep_left = controller.get_offset() <= 0;
+        sweep_time = MOVE_SWEEP_TIME;
+        sweep_reach = MOVE_SWEEP_TIME;
+        sweep_started = now;
+    } else if (now - sweep_started > sweep_time) {
+        if (sweep_reach == 0) {
+            /* Back on the heading after the search, the robot waits near the lost line for the watchdog */
+            robot->stop();
+            return;
+        }
+        sweep_left = !sweep_left;
+        if (lost > MOVE_LOST_COAST_TIME + MOVE_SEARCH_TIME) {
+            /* The last swing ends on the heading, the recovery expects it */
+            sweep_time = sweep_reach;
+            sweep_reach = 0;
+        } else {
+            /* Back over the heading and a bit farther to the other side */
+            const time_type reach = sweep_reach + MOVE_SWEEP_TIME / 2;
+            sweep_time = sweep_reach + (reach < MOVE_SWEEP_MAX ? reach : MOVE_SWEEP_MAX);
+            sweep_reach = sweep_time - sweep_reach;
+        }
+        sweep_started = now;
+    }
+    if (sweep_left) {
+        robot->in_place_left();
+    } else {
+        robot->in_place_right();
+    }
+}
+
 inline void move_command::encounter_cross() {
-    /* Move must be at least a little bit long */
-    if (millis() - move_started < 300) {
-        go_straight();
-    } else if ((robot->get_sensors().first_left() || robot->get_sensors().first_right())) {
+    /* Move must be at least a little bit long, the line search may cross any line */
+    if (millis() - move_started < robot->get_calibration().get_tuning().move_min_time || is_recovering()) {
+        go_straight(robot->get_cruise_speed());
+    } else if (robot->get_sensors().middle() &&
+               (robot->get_sensors().first_left() || robot->get_sensors().first_right())) {
+        /* The cross line is under the middle sensor too, an outer sensor alone may see a line aside after a
+         * recovery */
         robot->led_on();
         cross_encountered = true;
         cross_encountered_time = millis();
+        predict_stop(cross_encountered_time - move_started);
     } else {
-        go_straight();
+        go_straight(robot->get_cruise_speed());
     }
 };
 
 void move_command::do_sensors_correction_on_cross() {
-    if (robot->get_sensors().first_left() && !robot->get_sensors().second_left()) {
-        robot->in_place_left();
-    } else if (robot->get_sensors().first_right() && !robot->get_sensors().second_right()) {
-        robot->in_place_right();
-    } else if (robot->get_sensors().left_part() || robot->get_sensors().right_part()) {
-        robot->half_forward();
+    if (!robot->get_calibration().has_flag(CALIBRATION_SKEW_CORRECTION)) {
+        robot->apply(lookup_primitive(CROSS_CORRECTION_TABLE, robot->get_sensors().get_pattern()));
+        cross_corrected = true;
+        return;
+    }
+
+    if (correction_end == 0) {
+        if (robot->get_sensors().first_left() && robot->get_sensors().first_right()) {
+            measure_skew();
+        } else if (millis() - cross_encountered_time < CROSS_SKEW_WAIT) {
+            /* Waiting for the other outer sensor in the speed of the move, the skew is measured in it */
+            go_straight(robot->get_cruise_speed());
+            return;
+        } else {
+            /* Only one side of the cross, the heading is not known */
+            cross_corrected = true;
+            return;
+        }
+    }
+
+    const time_type now = micros();
+    if ((int32_t) (correction_end - now) > 0) {
+        const double speed = robot->get_calibration().get_tuning().turn_speed / 1000.0;
+        robot->steer(0, correction_left ? -speed : speed);
+    } else {
+        cross_corrected = true;
     }
-    cross_corrected = true;
 };
 
+inline void move_command::measure_skew() {
+    /* The side entering first is ahead, the robot turns towards it */
+    const int32_t skew = (int32_t) (robot->get_sensors().get_entry_time(SENSOR_EDGE_SENSORS - 1) -
+                                    robot->get_sensors().get_entry_time(0));
+    const time_type magnitude = (time_type) (skew < 0 ? -skew : skew);
+    correction_left = skew > 0;
+
+    /* The turn goes at the turn speed, the skew was measured at the cruise speed, no correction without the turn */
+    const int16_t turn_speed = robot->get_calibration().get_tuning().turn_speed;
+    const time_type turn_time = magnitude > CROSS_SKEW_WAIT * 1000UL || turn_speed <= 0 ? 0 : (time_type) (
+            magnitude * robot->get_cruise_speed() * CROSS_SKEW_GAIN / turn_speed);
+    correction_end = micros() + turn_time;
+
+    /* The wheels do not go forward meanwhile, the centering on the cross is delayed */
+    cross_encountered_time += turn_time / 1000;
+}
+
+inline void move_command::predict_stop(time_type approach) {
+    tile_odometry &odometry = robot->get_odometry();
+    const int16_t cruise_speed = (int16_t) (robot->get_cruise_speed() * 1000 + 0.5);
+
+    if (robot->get_calibration().has_flag(CALIBRATION_PREDICTIVE_STOP) &&
+        odometry.is_calibrated(cruise_speed) && odometry.is_expected(approach)) {
+        center_time = odometry.get_center_time();
+    }
+    odometry.record(approach, cruise_speed);
+}
+
 inline void move_command::do_wheels_corrections_on_cross() {
-    //NOTE: constant time in ms, which seems to be appropriate
-    if (millis() - cross_encountered_time < 375 ||
+    const motion_tuning &tuning = robot->get_calibration().get_tuning();
+    const bool predicted = center_time > 0;
+    if (millis() - cross_encountered_time < (predicted ? center_time : tuning.cross_center_time) ||
         robot->get_sensors().left_part() || robot->get_sensors().right_part()) {
-        go_straight();
+        /* The predicted stop is approached at the cruise speed, the coasting brings the wheels on the cross */
+        go_straight(predicted ? robot->get_cruise_speed() : tuning.center_speed / 1000.0);
     } else {
         robot->led_off();
         robot->stop_smoothly();
@@ -155,15 +439,19 @@ inline void move_command::update() {
         return;
     }
 
+    count_update();
+
     /* First call to this function */
     if (state == command_state::PREPARED) {
-        move_started = millis();
-        state = command_state::IN_PROCESS;
+        start(COMMAND_MOVE);
+        move_started = get_started_time();
         robot->clear_last_move_encounters();
     }
 
     /* During the move, check if left and right path exists */
-    robot->check_for_path_encounters();
+    if (!is_recovering()) {
+        robot->check_for_path_encounters();
+    }
     if (cross_encountered && cross_corrected) {
         do_wheels_corrections_on_cross();
     } else if (cross_encountered && !cross_corrected) {
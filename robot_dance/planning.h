@@ -35,6 +35,22 @@ public:
 
     virtual bool is_done() = 0;
 
+    /**
+     * Decides if the command runs longer than it may, the watchdog abandons such a command.
+     * Commands without any budget never exceed it.
+     *
+     * @param now Current time in ms.
+     * @return If the time budget of the command is exceeded.
+     */
+    virtual bool is_over_budget(time_type) {
+        return false;
+    }
+
+    /**
+     * Gives up the unfinished command, the robot stays at its last known location.
+     */
+    virtual void abandon() {}
+
     /**
      * Gets printable name of the command.
      *
@@ -57,6 +73,18 @@ public:
 
     virtual command *get_next_command() = 0;
 
+    /**
+     * Creates a command bringing the lost robot back to the last known location after the watchdog
+     * abandoned a command of the route.
+     *
+     * @param failed The abandoned command.
+     * @param last_known Location the robot reached last.
+     * @return The recovery command, nullptr if the planner has none.
+     */
+    virtual command *get_recovery_cmd(const command *, const location &) {
+        return nullptr;
+    }
+
 };
 
 /**
@@ -108,6 +136,16 @@ public:
      */
     virtual time_type get_finish_time_constrain() = 0;
 
+    /**
+     * Decides if another waypoint follows the current one, without fetching it.
+     * Parsers which cannot look ahead report none.
+     *
+     * @return If another waypoint follows the current one.
+     */
+    virtual bool has_next() {
+        return false;
+    }
+
     /**
      * Tries to add and parse one new character from dance sequence.
      * Should return false if the sequence is incorrect.
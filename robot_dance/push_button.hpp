@@ -2,7 +2,7 @@
 #ifndef BUTTON_HPP
 #define BUTTON_HPP
 
-#include <Arduino.h>
+#include "hal.hpp"
 
 #define DEBOUNCE_TIME   (50)
 #define LONG_PRESS_TIME (500)
@@ -0,0 +1,198 @@
+#ifndef recovery_command_h_
+#define recovery_command_h_
+
+#include "boe_bot_command_base.h"
+
+/**
+ * Time in ms the recovery may take beyond backing up, the line is searched in place meanwhile.
+ */
+#define RECOVERY_SEARCH_TIME    (4000)
+
+/**
+ * Time in ms of the first swing of the line search, every next swing to the other side is twice as long.
+ */
+#define RECOVERY_SWEEP_TIME     (250)
+
+/**
+ * Number of the attempts to drive the route again from the last known cross after a recovery.
+ */
+#define RECOVERY_MAX_RETRIES    (1)
+
+
+/**
+ * Command bringing the robot back to its last known cross after the watchdog abandoned a command.
+ * After a lost move the robot backs up at the cruise speed for at most as long as the move went,
+ * until its outer sensors find the cross it left, and centers on it. After a lost turn, or if no
+ * cross is found in time, it swings in place with growing swings until the middle sensor finds
+ * a line. The heading is assumed to be the one before the lost command.
+ */
+class recovery_command : public boe_bot_command_base {
+
+    /**
+     * Phases of the recovery.
+     */
+    enum recovery_phase : uint8_t {
+        REVERSING,
+        CENTERING,
+        SWEEPING
+    };
+
+    /**
+     * Current phase.
+     */
+    recovery_phase phase;
+
+    /**
+     * Longest time of backing up to the last cross in ms, 0 if the robot does not back up.
+     */
+    time_type reverse_time;
+
+    /**
+     * Defines the side of the current swing of the line search.
+     */
+    bool sweep_left;
+
+    /**
+     * Time of the start of the current phase or swing in ms.
+     */
+    time_type phase_started;
+
+    /**
+     * Length of the current swing in ms.
+     */
+    time_type sweep_time;
+
+    /**
+     * Switches to the given phase.
+     *
+     * @param next Next phase.
+     */
+    void enter(recovery_phase next) {
+        phase = next;
+        phase_started = millis();
+    }
+
+    /**
+     * Stops the robot on the last known location, the paths aside are not known there.
+     */
+    void arrive();
+
+public:
+
+    /**
+     * Creates an idle recovery command.
+     */
+    recovery_command() : boe_bot_command_base(nullptr, location()), phase(SWEEPING), reverse_time(0),
+                         sweep_left(true), phase_started(0), sweep_time(RECOVERY_SWEEP_TIME) {};
+
+    /**
+     * Alternative 'constructor' to avoid dynamic allocation.
+     *
+     * @param robot_p Robot to be commanded.
+     * @param last_known_p Location the robot reached last, it is the final location of the recovery.
+     * @param reverse_time_p Longest time of backing up in ms, the time of the lost move, 0 after a lost turn.
+     */
+    void set(boe_bot *robot_p, const location &last_known_p, time_type reverse_time_p);
+
+    /**
+     * The budget of the recovery is given by the lost command, not by the statistics.
+     */
+    virtual bool is_over_budget(time_type now) override {
+        return state == IN_PROCESS && now - get_started_time() > reverse_time + RECOVERY_SEARCH_TIME;
+    }
+
+    /**
+     * Continue to do this command.
+     */
+    virtual void update() override;
+
+    virtual char *get_name() override;
+
+};
+
+
+
+//class recovery_command
+
+void recovery_command::set(boe_bot *robot_p, const location &last_known_p, time_type reverse_time_p) {
+    init(robot_p, last_known_p);
+    phase = reverse_time_p > 0 ? REVERSING : SWEEPING;
+    reverse_time = reverse_time_p;
+    sweep_left = true;
+    phase_started = 0;
+    sweep_time = RECOVERY_SWEEP_TIME;
+}
+
+inline void recovery_command::arrive() {
+    robot->led_off();
+    robot->stop();
+    robot->set_last_move_encountered_left(true);
+    robot->set_last_move_encountered_right(true);
+    finish();
+    robot->derive_encounters(robot->get_location());
+}
+
+void recovery_command::update() {
+    /* The recovery is finished */
+    if (is_done()) {
+        robot->stop();
+        return;
+    }
+
+    count_update();
+
+    /* First call to this function */
+    if (state == command_state::PREPARED) {
+        start(COMMAND_RECOVERY);
+        enter(reverse_time > 0 ? REVERSING : SWEEPING);
+    }
+
+    const motion_tuning &tuning = robot->get_calibration().get_tuning();
+    const time_type elapsed = millis() - phase_started;
+    switch (phase) {
+        case REVERSING:
+            /* Back up at least as long as a move goes before it looks for a cross, an outer sensor alone may see
+             * the line the robot backs along aside, the cross line is under the middle sensor too */
+            if (elapsed > tuning.move_min_time && robot->get_sensors().middle() &&
+                (robot->get_sensors().first_left() || robot->get_sensors().first_right())) {
+                robot->led_on();
+                enter(CENTERING);
+            } else if (elapsed > reverse_time) {
+                enter(SWEEPING);
+            } else {
+                robot->steer(-robot->get_cruise_speed(), 0);
+            }
+            break;
+        case CENTERING:
+            /* Forwards until the sensors leave the cross, as at the end of a move */
+            if (elapsed < tuning.cross_center_time ||
+                robot->get_sensors().left_part() || robot->get_sensors().right_part()) {
+                robot->steer(tuning.center_speed / 1000.0, 0);
+            } else {
+                arrive();
+            }
+            break;
+        case SWEEPING:
+            if (robot->get_sensors().middle()) {
+                arrive();
+                break;
+            }
+            if (elapsed > sweep_time) {
+                sweep_left = !sweep_left;
+                sweep_time *= 2;
+                phase_started = millis();
+            }
+            if (sweep_left) {
+                robot->in_place_left();
+            } else {
+                robot->in_place_right();
+            }
+            break;
+    }
+}
+
+inline char *recovery_command::get_name() {
+    return (char *) "recovery command";
+}
+
+#endif
@@ -4,4 +4,26 @@
 
 typedef unsigned long time_type;
 
+/*
+ * EEPROM layout: magic and dance sequence from the beginning,
+ * calibration of the robot and the tempo of the last show at the end.
+ */
+#define EEPROM_DANCE_END            (896)
+#define EEPROM_CALIBRATION_ADDRESS  (896)
+#define EEPROM_TEMPO_ADDRESS        (960)
+
+/*
+ * Diagnostic buffers, which share the 2 kB of RAM of the UNO with the dance. A buffer left out
+ * of the build ignores its calibration flag, the history stays empty:
+ *   ENABLE_EDGE_CAPTURE    ring of the sensor edges of the pin change interrupt, 83 B
+ *   ENABLE_TRACE           ring of the control loop events streamed out during the dance, 175 B
+ *   ENABLE_SENSOR_HISTORY  run-length history of the sensor patterns dumped after an anomaly, 265 B
+ * The robot keeps only the history by default, the tests on the PC use all of them.
+ */
+#ifndef __AVR__
+#define ENABLE_EDGE_CAPTURE
+#define ENABLE_TRACE
+#endif
+#define ENABLE_SENSOR_HISTORY
+
 #endif //ROBOT_DANCE_HPP
@@ -3,21 +3,112 @@
 //Enables Serial error messages in other classes (for test purposes macro is not defined)
 #define ARUINO
 
-#include <Arduino.h>
+#include "hal.hpp"
 
 #include "robot_dance.hpp"
 #include "location.h"
 #include "boe_bot.hpp"
 #include "boe_bot_planner.h"
 #include "command_parser_eeprom.hpp"
+#include "serial_console.hpp"
+#include "idle_phase.hpp"
 
 
-boe_bot robot;
-command_parser *cmd_parser = nullptr;
-planner *pl = nullptr;
+HAL_THREAD_LOCAL boe_bot robot;
+HAL_THREAD_LOCAL command_parser *cmd_parser = nullptr;
+HAL_THREAD_LOCAL planner *pl = nullptr;
 
-command_parser_eeprom cmep;
-boe_bot_planner bbp;
+HAL_THREAD_LOCAL command_parser_eeprom cmep;
+HAL_THREAD_LOCAL boe_bot_planner bbp;
+
+HAL_THREAD_LOCAL serial_console console(&robot);
+HAL_THREAD_LOCAL idle_phase idle(&robot);
+
+/**
+ * Defines if the next waypoint was already fetched in the idle phase.
+ */
+HAL_THREAD_LOCAL bool next_fetched = false;
+
+/**
+ * Result of the fetch done in the idle phase.
+ */
+HAL_THREAD_LOCAL bool next_exists = false;
+
+/**
+ * Defines if the route to the next waypoint was already prepared in the idle phase.
+ */
+HAL_THREAD_LOCAL bool next_planned = false;
+
+
+/**
+ * Fetches the next waypoint unless it was fetched in the idle phase.
+ *
+ * @return If the next waypoint exists.
+ */
+bool fetch_waypoint() {
+    if (!next_fetched) {
+        next_exists = cmd_parser->fetch_next();
+    }
+    next_fetched = false;
+    return next_exists;
+}
+
+/**
+ * Decides the axis order of the route to the current waypoint, the robot catching up may change the order of the dance.
+ *
+ * @return If the route goes along the X axis first.
+ */
+bool route_first_x() {
+    return robot.get_catch_up().choose_first_x(robot.get_location(), cmd_parser->get_current_target(),
+                                               cmd_parser->is_first_directionX());
+}
+
+/**
+ * Prepares the route from the current location to the current waypoint.
+ *
+ * @return If the route could be prepared.
+ */
+bool plan_route() {
+    return pl->prepare_route(robot.get_location(),
+                             location(cmd_parser->get_current_target(), direction::NotSpecified),
+                             route_first_x());
+}
+
+/**
+ * Idle task fetching the next waypoint and preparing its route.
+ */
+bool prefetch_waypoint() {
+    if (!next_fetched) {
+        next_exists = cmd_parser->fetch_next();
+        next_fetched = true;
+        return next_exists;
+    }
+    if (next_exists && !next_planned) {
+        next_planned = plan_route();
+    }
+    return false;
+}
+
+/**
+ * Idle task sending the recorded trace.
+ */
+bool send_trace() {
+    return robot.get_trace().drain();
+}
+
+/**
+ * Idle task sending the queued telemetry.
+ */
+bool send_telemetry() {
+    return robot.get_telemetry().drain();
+}
+
+/**
+ * Idle task writing the pending calibration to the EEPROM.
+ */
+bool store_calibration() {
+    return robot.get_calibration().store_step();
+}
 
 
 void setup() {
@@ -27,6 +118,51 @@ void setup() {
     //cmd_parser = new command_parser_mocap();
     cmep.init();
     cmd_parser = &cmep;
+
+    idle.add_task(&prefetch_waypoint);
+    idle.add_task(&store_calibration);
+    idle.add_task(&send_trace);
+    idle.add_task(&send_telemetry);
+}
+
+/**
+ * Stops the robot and prints the sensor history if an anomaly asked for it.
+ *
+ * @param force Prints the history even without a request.
+ */
+void dump_sensor_history(bool force) {
+    if (force || robot.get_sensors().get_history().is_dump_pending()) {
+        robot.stop();
+        robot.get_sensors().print_history();
+    }
+}
+
+/**
+ * Runs the control step of the command at the rate of the loop scheduler until the command is done.
+ * The watchdog abandons the command when it runs longer than its time budget.
+ *
+ * @return If the command finished, false if it was abandoned.
+ */
+bool execute_command(command *cmd) {
+    bool drained = false;
+    while (!cmd->is_done()) {
+        if (cmd->is_over_budget(millis())) {
+            cmd->abandon();
+            return false;
+        }
+        if (robot.get_scheduler().is_due(micros())) {
+            robot.read_sensors();
+            cmd->update();
+            robot.get_scheduler().end_step(micros());
+            drained = false;
+        } else if (!drained) {
+            /* Slack of the loop scheduler, the Serial line is written only if it has room */
+            robot.get_telemetry().drain();
+            robot.get_trace().drain();
+            drained = true;
+        }
+    }
+    return true;
 }
 
 void go_home_ISR() {
@@ -37,6 +173,15 @@ void go_home_ISR() {
 
 
 void loop() {
+    /* Serve Serial queries until the button is pushed */
+    while (!robot.get_button().is_pushed()) {
+        console.poll();
+        robot.get_calibration().store_step();
+        robot.get_tempo().store_step();
+        robot.get_telemetry().drain();
+        robot.get_trace().drain();
+    }
+
     robot.start(*cmd_parser);
 
     location init_location = cmd_parser->get_initial_location();
@@ -54,76 +199,112 @@ void loop() {
     /* Interrupt routine for making the robot go home */
     robot.clear_go_home();
     robot.get_button().attach_ISR_on_push(&go_home_ISR);
+    robot.get_scheduler().start(micros());
+    robot.get_trace().start(micros());
+    robot.get_sensors().get_history().clear(robot.get_sensors().get_pattern(), micros());
+    robot.get_tempo().clear();
+    robot.get_catch_up().reset();
+    idle.reset_statistics();
+    next_fetched = false;
+    next_planned = false;
 
     /* Execute dance */
-    while (cmd_parser->fetch_next() && !robot.do_go_home()) {
-        Serial.print(F("\n-> Creating route to { "));
-        Serial.print(cmd_parser->get_current_target().get_x());
-        Serial.print(F(", "));
-        Serial.print(cmd_parser->get_current_target().get_y());
-        Serial.print(F(" } firstX="));
-        Serial.print(cmd_parser->is_first_directionX() ? F("true") : F("false"));
-        Serial.print(F(", time constraint="));
-        Serial.println(cmd_parser->get_finish_time_constrain());
-        Serial.flush();
-
-        if (!pl->prepare_route(robot.get_location(),
-                               location(cmd_parser->get_current_target(), direction::NotSpecified),
-                               cmd_parser->is_first_directionX())) {
-            Serial.println(F("Error invalid arguments in prepare route -> Ignoring...."));
+    while (fetch_waypoint() && !robot.do_go_home()) {
+        /* The robot far behind the time line skips the overdue waypoints, but never the last one */
+        if (robot.get_calibration().has_flag(CALIBRATION_SKIP_LATE) && cmd_parser->has_next() &&
+            robot.get_catch_up().should_skip(cmd_parser->get_finish_time_constrain() * 100, millis() - start_time)) {
+            robot.get_tempo().skip();
+            robot.get_telemetry().skipped(millis(), cmd_parser->get_current_target(),
+                                          cmd_parser->get_finish_time_constrain());
+            /* The robot stands meanwhile, the skips come in bursts, which the ring would drop */
+            while (robot.get_telemetry().drain()) {
+                delay(1);
+            }
+            next_planned = false;
             continue;
         }
 
+        robot.get_telemetry().route_start(millis(), cmd_parser->get_current_target(),
+                                          route_first_x(), cmd_parser->get_finish_time_constrain());
+
+        const bool planned = next_planned;
+        next_planned = false;
+        if (!planned && !plan_route()) {
+            robot.get_telemetry().route_error(millis(), cmd_parser->get_current_target());
+            robot.get_sensors().get_history().request_dump();
+            dump_sensor_history(false);
+            continue;
+        }
+
+        uint8_t retries = 0;
+        bool given_up = false;
         command *cur_cmd = nullptr;
         while ((cur_cmd = pl->get_next_command()) != nullptr) {
             /* End this loop if push_button was pressed */
             if (robot.do_go_home()) {
-                Serial.println(F("button interrupted the execution"));
-                Serial.flush();
+                robot.get_telemetry().interrupted(millis());
                 break;
             }
 
-            Serial.print(F("processing: "));
-            Serial.println(cur_cmd->get_name());
-
-            while (!cur_cmd->is_done()) {
-                robot.get_sensors().read_sensors();
-                cur_cmd->update();
+            /* The commands report in bursts at their ends and at the start of the route, they are sent in between */
+            robot.get_telemetry().drain();
+            if (!execute_command(cur_cmd)) {
+                /* Back to the last known cross and the route once more from there, then the waypoint is given up */
+                command *recovery = pl->get_recovery_cmd(cur_cmd, robot.get_location());
+                if (recovery != nullptr) {
+                    execute_command(recovery);
+                }
+                if (++retries > RECOVERY_MAX_RETRIES || !plan_route()) {
+                    given_up = true;
+                    break;
+                }
             }
         }
+        robot.get_telemetry().drain();
+
+        /* The history of an anomaly is printed at the end of its route */
+        dump_sensor_history(false);
 
         /* Waiting / time synchronization for the route - only when not going home */
         if (!robot.do_go_home()) {
-            if (cmd_parser->get_finish_time_constrain() * 100 > millis() - start_time) {
+            const time_type deadline = cmd_parser->get_finish_time_constrain() * 100;
+            const time_type now = millis();
+            if (given_up) {
+                /* The robot waits on the last known cross instead */
+                robot.get_tempo().skip();
+            } else {
+                robot.get_tempo().record(deadline, now - start_time);
+                if (robot.get_calibration().has_flag(CALIBRATION_CATCH_UP) && deadline > 0) {
+                    robot.get_catch_up().update((int32_t) (now - start_time - deadline));
+                }
+                robot.get_telemetry().arrival(now, deadline, now - start_time);
+            }
+
+            if (deadline > now - start_time) {
                 /* Stop before waiting for the next route */
                 robot.stop();
 
-                char buff[64];
-                sprintf(buff, "waiting until %lu beginning from %lu", cmd_parser->get_finish_time_constrain() * 100,
-                        millis() - start_time);
-                Serial.println(buff);
-
-                delay(cmd_parser->get_finish_time_constrain() * 100 - millis() + start_time);
+                /* Hold the position and work in the slack, the next waypoint may be fetched meanwhile */
+                idle.wait_until(start_time + deadline);
+                idle.report_last();
             }
-            Serial.println(F("route done, fetching next command..."));
+            robot.get_telemetry().route_done(millis(), robot.get_location());
         }
     }
 
     Serial.println(F("Escaped the main execution loop"));
+    idle.print_totals();
+    /* The report of the show is written to the EEPROM while the robot waits for the button */
+    robot.get_tempo().store();
     robot.stop();
+    dump_sensor_history(robot.do_go_home());
 
     if (robot.do_go_home()) {
         /* Return to the starting position */
         pl->prepare_route(robot.get_location(), init_location, false);
         command *cur_cmd = nullptr;
         while ((cur_cmd = pl->get_next_command()) != nullptr) {
-            Serial.print(F("processing: "));
-            Serial.println(cur_cmd->get_name());
-
-            while (!cur_cmd->is_done()) {
-                robot.get_sensors().read_sensors();
-                cur_cmd->update();
-            }
+            execute_command(cur_cmd);
         }
 
         /* Arrived home */
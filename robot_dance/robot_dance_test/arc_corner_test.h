@@ -0,0 +1,62 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include <cmath>
+
+/**
+ * Simulates the dance without and with the corners of the routes driven on arcs. Each arc must replace
+ * one turn, finish the dance with the robot on the waypoints and shorten the routes, which turn on a corner.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_arc_corners(const std::string& dance_path)
+{
+	test_checks checks("Arc corners on " + dance_path);
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	unsigned stopped_turns = 0;
+	unsigned long stopped_route = 0;
+	for (int arcs = 0; arcs < 2; ++arcs)
+	{
+		const char* variant = arcs ? "arc corners" : "stopped corners";
+		const dance_simulator_config config = calibrated_config(arcs ? CALIBRATION_ARC_CORNERS : 0);
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run(dance);
+
+		/* All commands drive the routes, the waypoints are the same in both runs */
+		const command_statistics& statistics = robot.get_command_statistics();
+		unsigned long total = 0;
+		for (uint8_t kind = 0; kind < COMMAND_KINDS; ++kind)
+			total += statistics.get_timing(kind).total_duration;
+		const unsigned long mean_route = result.waypoints.empty() ? 0 : total / result.waypoints.size();
+		const unsigned arc_count = statistics.get_timing(COMMAND_ARC).count;
+		const unsigned turns = statistics.get_timing(COMMAND_TURN_LEFT).count + statistics.get_timing(COMMAND_TURN_RIGHT).count;
+
+		/* An arc reports its corner with the robot past it already, the waypoints are reached by the moves */
+		double waypoint_error = 0;
+		for (const cross_error& cross : result.crosses)
+			for (const waypoint_arrival& waypoint : result.waypoints)
+				if (waypoint.arrival == cross.time && waypoint.target == cross.reported.get_position())
+					waypoint_error = std::fmax(waypoint_error, cross.position_error);
+
+		checks.expect_on_course(result, config, variant);
+		checks.expect(waypoint_error < config.map.tile / 4, "%s left the robot %.1f mm off a waypoint", variant,
+			waypoint_error);
+		if (!arcs)
+		{
+			stopped_turns = turns;
+			stopped_route = mean_route;
+			checks.expect(arc_count == 0, "%s drove %u arcs", variant, arc_count);
+			continue;
+		}
+		checks.expect(arc_count > 0 && arc_count + turns == stopped_turns, "%u arcs and %u turns replace %u turns",
+			arc_count, turns, stopped_turns);
+		checks.expect(mean_route < stopped_route, "%s take %lu ms per route, the stopped ones %lu ms", variant,
+			mean_route, stopped_route);
+	}
+
+	return checks.finish();
+}
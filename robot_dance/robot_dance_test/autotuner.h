@@ -0,0 +1,268 @@
+#pragma once
+
+#include "monte_carlo.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Search space and effort of the autotuner.
+ */
+struct autotuner_config
+{
+	/* Robots and arena, the candidates are evaluated on the same sampled robots */
+	monte_carlo_config robots;
+	int robots_per_candidate = 4;
+
+	int generations = 8;
+	int population = 16;
+	uint32_t seed = 1;
+
+	/* Cost of one mm of the mean cross alignment error in s per tile */
+	double alignment_weight = 0.02;
+	/* Cost of a lost robot in s per tile */
+	double lost_penalty = 100;
+
+	/* Lowest and highest values of the motion_tuning fields, in the order of the struct.
+	 * The course is driven without the arcs, their sweep and inner speed stay at the defaults */
+	motion_tuning low = {100, 150, 100, 200, 0, 0, 100, 300, DEFAULT_ARC_SWEEP_TIME, DEFAULT_ARC_INNER_SPEED};
+	motion_tuning high = {600, 600, 600, 800, 200, 1000, 600, 1000, DEFAULT_ARC_SWEEP_TIME, DEFAULT_ARC_INNER_SPEED};
+};
+
+/**
+ * Evaluated parameter set.
+ */
+struct tuning_candidate
+{
+	motion_tuning tuning;
+	/* Mean time of one tile of the course in s, turns included */
+	double tile_time = 0;
+	/* Mean position error at the crosses in mm */
+	double alignment = 0;
+	int lost = 0;
+	double cost = 0;
+};
+
+/**
+ * Searches the motion timing, smoothing and speeds for the shortest tile time
+ * with a good cross alignment. The first generation is the firmware defaults and
+ * uniformly random candidates, every next generation perturbs the best candidate
+ * found so far with a shrinking spread. All simulations of a generation run
+ * on a work-stealing pool.
+ */
+class motion_autotuner
+{
+	autotuner_config config;
+	std::mt19937 random;
+	std::vector<tuning_candidate> history;
+
+	static const int FIELDS = sizeof(motion_tuning) / sizeof(uint16_t);
+
+	/* motion_tuning consists of 16-bit fields only, they are searched as one vector */
+	static int get_field(const motion_tuning& tuning, int index)
+	{
+		const uint16_t* fields = (const uint16_t*) &tuning;
+		return fields[index];
+	}
+
+	static void set_field(motion_tuning& tuning, int index, int value)
+	{
+		uint16_t* fields = (uint16_t*) &tuning;
+		fields[index] = (uint16_t) value;
+	}
+
+	motion_tuning uniform()
+	{
+		motion_tuning tuning = config.low;
+		for (int i = 0; i < FIELDS; ++i)
+		{
+			std::uniform_int_distribution<int> value(get_field(config.low, i), get_field(config.high, i));
+			set_field(tuning, i, value(random));
+		}
+		return tuning;
+	}
+
+	motion_tuning perturb(const motion_tuning& base, double spread)
+	{
+		motion_tuning tuning = base;
+		for (int i = 0; i < FIELDS; ++i)
+		{
+			const int low = get_field(config.low, i);
+			const int high = get_field(config.high, i);
+			std::normal_distribution<double> step(0, spread * (high - low));
+			const int value = (int) std::lround(get_field(base, i) + step(random));
+			set_field(tuning, i, std::max(low, std::min(high, value)));
+		}
+		return tuning;
+	}
+
+	/**
+	 * Sum of the Manhattan distances between the waypoints of the course, the firmware moves only along the lines.
+	 */
+	static int count_tiles(const dance_result& result)
+	{
+		int tiles = 0;
+		/* The course starts at A1 */
+		position last(0, 0);
+		for (const waypoint_arrival& waypoint : result.waypoints)
+		{
+			tiles += std::abs(waypoint.target.get_x() - last.get_x()) + std::abs(waypoint.target.get_y() - last.get_y());
+			last = waypoint.target;
+		}
+		return tiles;
+	}
+
+	void evaluate(std::vector<tuning_candidate>& candidates)
+	{
+		const int robots = config.robots_per_candidate;
+		std::vector<dance_result> results(candidates.size() * robots);
+		monte_carlo_runner sampler(config.robots);
+		work_stealing_pool pool(config.robots.threads);
+
+		for (size_t c = 0; c < candidates.size(); ++c)
+		{
+			for (int r = 0; r < robots; ++r)
+			{
+				pool.submit([this, c, r, robots, &candidates, &results, &sampler]()
+				{
+					dance_simulator_config robot = sampler.sample(r);
+					robot.preload_calibration = true;
+					robot.calibration = make_calibration(candidates[c].tuning);
+					dance_simulator simulator(robot);
+					results[c * robots + r] = simulator.run(get_course());
+				});
+			}
+		}
+		pool.run();
+
+		for (size_t c = 0; c < candidates.size(); ++c)
+		{
+			tuning_candidate& candidate = candidates[c];
+			candidate.tile_time = 0;
+			candidate.alignment = 0;
+			candidate.lost = 0;
+			for (int r = 0; r < robots; ++r)
+			{
+				const dance_result& result = results[c * robots + r];
+				const int tiles = std::max(1, count_tiles(result));
+				candidate.tile_time += result.dance_time / tiles / robots;
+				candidate.alignment += result.mean_position_error / robots;
+				candidate.lost += result.finished ? 0 : 1;
+			}
+			candidate.cost = candidate.tile_time + config.alignment_weight * candidate.alignment
+				+ config.lost_penalty * candidate.lost / robots;
+		}
+	}
+
+public:
+	explicit motion_autotuner(const autotuner_config& config)
+		: config(config), random(config.seed)
+	{
+	}
+
+	/**
+	 * Course of the tuning: long and short moves, both turn directions and a U-turn, no waiting.
+	 */
+	static const std::string& get_course()
+	{
+		static const std::string course = "A1N A4 T0 D4 T0 D1 T0 B1 T0 B3 T0 C3 T0 C2 T0 A2 T0 A1 T0";
+		return course;
+	}
+
+	/**
+	 * Builds the firmware calibration with the default values and the given motion tuning.
+	 */
+	static calibration_data make_calibration(const motion_tuning& tuning)
+	{
+		calibration defaults;
+		calibration_data data = defaults.get_data();
+		data.tuning = tuning;
+		return data;
+	}
+
+	/**
+	 * Evaluates the firmware defaults only.
+	 */
+	tuning_candidate evaluate_defaults()
+	{
+		std::vector<tuning_candidate> candidates(1);
+		candidates[0].tuning = calibration().get_tuning();
+		evaluate(candidates);
+		return candidates[0];
+	}
+
+	/**
+	 * Runs the whole search.
+	 *
+	 * @param progress Called with the generation number and the best candidate after every generation.
+	 * @return The best candidate.
+	 */
+	template <typename Progress>
+	tuning_candidate run(Progress progress)
+	{
+		tuning_candidate best;
+		best.cost = std::numeric_limits<double>::infinity();
+		double spread = 0.15;
+		for (int generation = 0; generation < config.generations; ++generation)
+		{
+			std::vector<tuning_candidate> candidates(config.population);
+			for (int i = 0; i < config.population; ++i)
+			{
+				if (generation == 0)
+					candidates[i].tuning = i == 0 ? calibration().get_tuning() : uniform();
+				else
+					candidates[i].tuning = i == 0 ? best.tuning : perturb(best.tuning, spread);
+			}
+			evaluate(candidates);
+			history.insert(history.end(), candidates.begin(), candidates.end());
+
+			for (const tuning_candidate& candidate : candidates)
+			{
+				if (candidate.cost < best.cost)
+					best = candidate;
+			}
+			if (generation > 0)
+				spread *= 0.7;
+			progress(generation, best);
+		}
+		return best;
+	}
+
+	const std::vector<tuning_candidate>& get_history() const
+	{
+		return history;
+	}
+};
+
+/**
+ * Writes the calibration as Intel HEX at its EEPROM address, e.g. for "avrdude -U eeprom:w:calibration.eep:i".
+ *
+ * @return If the file could be written.
+ */
+inline bool write_calibration_hex(const char* path, const calibration_data& data)
+{
+	FILE* file = std::fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	const uint8_t* bytes = (const uint8_t*) &data;
+	for (size_t offset = 0; offset < sizeof(data); offset += 16)
+	{
+		const size_t length = std::min(sizeof(data) - offset, (size_t) 16);
+		const unsigned address = (unsigned) (EEPROM_CALIBRATION_ADDRESS + offset);
+		unsigned checksum = (unsigned) length + (address >> 8) + (address & 0xFF);
+		std::fprintf(file, ":%02X%04X00", (unsigned) length, address);
+		for (size_t i = 0; i < length; ++i)
+		{
+			std::fprintf(file, "%02X", bytes[offset + i]);
+			checksum += bytes[offset + i];
+		}
+		std::fprintf(file, "%02X\n", (unsigned) (-checksum & 0xFF));
+	}
+	std::fprintf(file, ":00000001FF\n");
+	return std::fclose(file) == 0;
+}
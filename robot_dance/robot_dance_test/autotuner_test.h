@@ -0,0 +1,55 @@
+#pragma once
+
+#include "autotuner.h"
+#include <chrono>
+#include <cstdio>
+
+inline void print_candidate(const char* label, const tuning_candidate& candidate)
+{
+	const motion_tuning& t = candidate.tuning;
+	std::printf("%s: tile %.3f s, alignment %.1f mm, lost %d, cost %.3f | T %u %u %u %u | S %u %d %d %d\n", label,
+		candidate.tile_time, candidate.alignment, candidate.lost, candidate.cost,
+		t.move_min_time, t.cross_center_time, t.turn_miss_time, t.turn_leave_time,
+		t.smoothing_steps, t.smoothing_jump, t.center_speed, t.turn_speed);
+}
+
+/**
+ * Searches the motion constants through the simulator and writes the best calibration as Intel HEX.
+ *
+ * @return 0 if the best candidate does not lose any robot.
+ */
+inline int test_autotuner(const char* output, int generations, unsigned threads)
+{
+	autotuner_config config;
+	config.robots.base.time_limit = 120;
+	config.robots.threads = threads;
+	config.generations = generations;
+	motion_autotuner tuner(config);
+
+	const auto started = std::chrono::steady_clock::now();
+	const tuning_candidate defaults = tuner.evaluate_defaults();
+	print_candidate("defaults", defaults);
+
+	const tuning_candidate best = tuner.run([](int generation, const tuning_candidate& candidate)
+	{
+		char label[32];
+		std::snprintf(label, sizeof(label), "generation %d", generation);
+		print_candidate(label, candidate);
+	});
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	std::printf("%zu candidates in %.1f s of wall time\n", tuner.get_history().size(), wall);
+	print_candidate("best", best);
+	std::printf("console: T %u %u %u %u\n", best.tuning.move_min_time, best.tuning.cross_center_time,
+		best.tuning.turn_miss_time, best.tuning.turn_leave_time);
+	std::printf("console: S %u %d %d %d\n", best.tuning.smoothing_steps, best.tuning.smoothing_jump,
+		best.tuning.center_speed, best.tuning.turn_speed);
+
+	if (!write_calibration_hex(output, motion_autotuner::make_calibration(best.tuning)))
+	{
+		std::printf("cannot write %s\n", output);
+		return 1;
+	}
+	std::printf("calibration written to %s (avrdude -U eeprom:w:%s:i)\n", output, output);
+	return best.lost == 0 ? 0 : 1;
+}
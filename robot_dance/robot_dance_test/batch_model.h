@@ -0,0 +1,217 @@
+#pragma once
+
+#include "sim_model.h"
+#include <cmath>
+#include <vector>
+
+/**
+ * Many differential drive robots of the same build in structure-of-arrays layout.
+ * The kernels run over all robots in plain loops without branches or calls
+ * except std::exp, so that the compiler vectorizes them (-O3, plus -ffast-math
+ * for the vector exp of libmvec; the render of the patterns needs AVX2).
+ * GCC does not prove the restrict of local pointers, ivdep tells it instead. The heading is kept also as its cosine and sine,
+ * which are rotated by polynomials of the small heading change instead of calling
+ * the trigonometric functions; the result matches diff_drive_model within rounding.
+ */
+class diff_drive_batch
+{
+	robot_geometry geometry;
+	size_t count;
+
+	/* Poses */
+	std::vector<double> x, y, heading, cos_heading, sin_heading;
+
+	/* Wheel states */
+	std::vector<double> left_target, right_target, left_speed, right_speed, left_gain, right_gain;
+
+	/* Sensor outputs */
+	std::vector<uint8_t> patterns;
+
+	/* Scratch of the wheel velocities in mm/s and of the sensor positions, sensor-major */
+	std::vector<double> left_velocity, right_velocity, sensor_x, sensor_y;
+
+	/**
+	 * Converts the wheel speed from interval [-1; 1] to mm/s like diff_drive_model::servo_speed.
+	 */
+	static double servo_speed(double speed, double max_speed, double knee)
+	{
+		const double pulse = speed * 200;
+		return std::copysign(max_speed * (1 - std::exp(-std::fabs(pulse) / knee)), pulse);
+	}
+
+	/**
+	 * Checks the point against the lines of the map like grid_map::is_black, without branches.
+	 */
+	static bool is_black(const grid_map& map, double px, double py)
+	{
+		const double half = map.line_width / 2;
+		const double max_x = (map.columns - 1) * map.tile;
+		const double max_y = (map.rows - 1) * map.tile;
+		/* Shifted truncation rounds also the negative coordinates around the map */
+		const double shift = 64;
+		const double nearest_x = ((double) (int) (px / map.tile + 0.5 + shift) - shift) * map.tile;
+		const double nearest_y = ((double) (int) (py / map.tile + 0.5 + shift) - shift) * map.tile;
+
+		const bool on_vertical = (std::fabs(px - nearest_x) <= half) & (nearest_x >= 0) & (nearest_x <= max_x)
+			& (py >= -half - map.overhang) & (py <= max_y + half + map.overhang);
+		const bool on_horizontal = (std::fabs(py - nearest_y) <= half) & (nearest_y >= 0) & (nearest_y <= max_y)
+			& (px >= -half - map.overhang) & (px <= max_x + half + map.overhang);
+		return on_vertical | on_horizontal;
+	}
+
+public:
+	diff_drive_batch(const robot_geometry& geometry, size_t count)
+		: geometry(geometry), count(count),
+		x(count), y(count), heading(count), cos_heading(count, 1), sin_heading(count),
+		left_target(count), right_target(count), left_speed(count), right_speed(count),
+		left_gain(count, geometry.left_gain), right_gain(count, geometry.right_gain),
+		patterns(count), left_velocity(count), right_velocity(count), sensor_x(5 * count), sensor_y(5 * count)
+	{
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	void set_pose(size_t i, double x_p, double y_p, double heading_p)
+	{
+		x[i] = x_p;
+		y[i] = y_p;
+		heading[i] = heading_p;
+		cos_heading[i] = std::cos(heading_p);
+		sin_heading[i] = std::sin(heading_p);
+	}
+
+	void set_gains(size_t i, double left, double right)
+	{
+		left_gain[i] = left;
+		right_gain[i] = right;
+	}
+
+	/**
+	 * Sets commanded wheel speeds from interval [-1; 1].
+	 */
+	void set_wheel_speeds(size_t i, double left, double right)
+	{
+		left_target[i] = left;
+		right_target[i] = right;
+	}
+
+	/**
+	 * Integrates the motion of all robots for the given time step in seconds.
+	 */
+	void step(double dt)
+	{
+		const double lag = geometry.servo_lag > 0 ? std::fmin(1.0, dt / geometry.servo_lag) : 1.0;
+		const double max_speed = geometry.max_speed;
+		const double knee = geometry.servo_knee;
+		const double base = geometry.wheel_base;
+
+		double* __restrict px = x.data();
+		double* __restrict py = y.data();
+		double* __restrict ph = heading.data();
+		double* __restrict pc = cos_heading.data();
+		double* __restrict ps = sin_heading.data();
+		double* __restrict pl = left_speed.data();
+		double* __restrict pr = right_speed.data();
+		const double* __restrict tl = left_target.data();
+		const double* __restrict tr = right_target.data();
+		const double* __restrict gl = left_gain.data();
+		const double* __restrict gr = right_gain.data();
+		double* __restrict wl = left_velocity.data();
+		double* __restrict wr = right_velocity.data();
+		/* Local copy, the stores through the pointers could alias the member otherwise */
+		const size_t n = count;
+
+		/* The servo curve has its own loop, the vector exp would not fit the registers with the rest */
+		#pragma GCC ivdep
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double l = pl[i] + (tl[i] - pl[i]) * lag;
+			const double r = pr[i] + (tr[i] - pr[i]) * lag;
+			pl[i] = l;
+			pr[i] = r;
+			wl[i] = servo_speed(l, max_speed, knee) * gl[i];
+			wr[i] = servo_speed(r, max_speed, knee) * gr[i];
+		}
+
+		#pragma GCC ivdep
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double vl = wl[i];
+			const double vr = wr[i];
+			const double v = (vl + vr) / 2;
+			const double turn = (vr - vl) / base * dt;
+
+			/* Rotations by turn/2 and turn, the turn of one step is far below 0.1 rad */
+			const double h = turn / 2;
+			const double h2 = h * h;
+			const double cos_half = 1 - h2 / 2 + h2 * h2 / 24;
+			const double sin_half = h * (1 - h2 / 6 + h2 * h2 / 120);
+			const double c = pc[i];
+			const double s = ps[i];
+			const double mid_cos = c * cos_half - s * sin_half;
+			const double mid_sin = s * cos_half + c * sin_half;
+
+			px[i] += v * mid_cos * dt;
+			py[i] += v * mid_sin * dt;
+			ph[i] += turn;
+
+			const double cos_turn = cos_half * cos_half - sin_half * sin_half;
+			const double sin_turn = 2 * sin_half * cos_half;
+			const double nc = c * cos_turn - s * sin_turn;
+			const double ns = s * cos_turn + c * sin_turn;
+			/* One Newton step keeps the vector normalized */
+			const double norm = (3 - (nc * nc + ns * ns)) / 2;
+			pc[i] = nc * norm;
+			ps[i] = ns * norm;
+		}
+	}
+
+	/**
+	 * Renders the sensor patterns of all robots over the map, see PATTERN_* bits.
+	 */
+	void render(const grid_map& map)
+	{
+		const double* __restrict px = x.data();
+		const double* __restrict py = y.data();
+		const double* __restrict pc = cos_heading.data();
+		const double* __restrict ps = sin_heading.data();
+		double* __restrict sx = sensor_x.data();
+		double* __restrict sy = sensor_y.data();
+		uint8_t* __restrict out = patterns.data();
+		const size_t n = count;
+
+		for (int sensor = 0; sensor < 5; ++sensor)
+		{
+			const double lateral = (sensor - 2) * geometry.sensor_pitch;
+			const double lead = geometry.sensor_lead;
+			double* __restrict row_x = sx + sensor * n;
+			double* __restrict row_y = sy + sensor * n;
+			#pragma GCC ivdep
+			for (size_t i = 0; i < n; ++i)
+			{
+				row_x[i] = px[i] + lead * pc[i] + lateral * ps[i];
+				row_y[i] = py[i] + lead * ps[i] - lateral * pc[i];
+			}
+		}
+
+		#pragma GCC ivdep
+		for (size_t i = 0; i < n; ++i)
+			out[i] = 0;
+		for (int sensor = 0; sensor < 5; ++sensor)
+		{
+			const double* __restrict row_x = sx + sensor * n;
+			const double* __restrict row_y = sy + sensor * n;
+			#pragma GCC ivdep
+			for (size_t i = 0; i < n; ++i)
+				out[i] |= (uint8_t) (is_black(map, row_x[i], row_y[i]) << sensor);
+		}
+	}
+
+	uint8_t get_pattern(size_t i) const { return patterns[i]; }
+	double get_x(size_t i) const { return x[i]; }
+	double get_y(size_t i) const { return y[i]; }
+	double get_heading(size_t i) const { return heading[i]; }
+};
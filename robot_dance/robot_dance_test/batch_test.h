@@ -0,0 +1,250 @@
+#pragma once
+
+#include "../calibration.hpp"
+#include "batch_model.h"
+#include "line_follow_test.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/**
+ * Control state of one robot driving the middle line tile after tile, with the phases
+ * of move_command and the PID of line_controller. It only sees the sensor pattern
+ * and the time and produces the wheel speeds, so that the same state machine
+ * drives a diff_drive_model as well as one robot of a diff_drive_batch.
+ */
+class straight_run
+{
+	line_controller controller;
+	line_controller_gains gains;
+	wheel_smoothing wheels;
+	double cruise_speed;
+
+	time_type move_started = 0;
+	time_type cross_encountered_time = 0;
+	bool cross_encountered = false;
+	bool cross_corrected = false;
+	int tiles = 0;
+
+	wheel_command steer(uint8_t pattern, time_type now, double speed)
+	{
+		const double correction = controller.update(pattern, now, gains) / (double) LINE_CORRECTION_MAX;
+		wheel_command command;
+		command.primitive = STEERING_PRIMITIVE;
+		command.left = speed + correction;
+		command.right = speed - correction;
+		const double excess = std::fmax(command.left, command.right) - 1.0;
+		if (excess > 0)
+		{
+			command.left -= excess;
+			command.right -= excess;
+		}
+		command.left = std::fmax(-1.0, command.left);
+		command.right = std::fmax(-1.0, command.right);
+		return command;
+	}
+
+public:
+	straight_run(const line_controller_gains& gains, double cruise_speed)
+		: gains(gains), cruise_speed(cruise_speed)
+	{
+	}
+
+	/**
+	 * Runs the firmware calls of one millisecond.
+	 */
+	void update(uint8_t pattern, time_type now)
+	{
+		pattern_sensors sensors(pattern);
+		wheel_command command;
+		int calls = FIRMWARE_CALLS_PER_MS;
+
+		if (!cross_encountered)
+		{
+			if (now - move_started >= DEFAULT_MOVE_MIN_TIME && (sensors.first_left() || sensors.first_right()))
+			{
+				cross_encountered = true;
+				cross_encountered_time = now;
+				calls = 0;
+			}
+			else
+			{
+				command = steer(pattern, now, cruise_speed);
+			}
+		}
+		else if (!cross_corrected)
+		{
+			command = primitive_command(lookup_primitive(CROSS_CORRECTION_TABLE, pattern));
+			cross_corrected = true;
+			calls = 1;
+		}
+		else if (now - cross_encountered_time < DEFAULT_CROSS_CENTER_TIME || sensors.left_part() || sensors.right_part())
+		{
+			command = steer(pattern, now, DEFAULT_CENTER_SPEED / 1000.0);
+		}
+		else
+		{
+			/* The next move starts right after the stop */
+			command = primitive_command(MP_STOP_SMOOTHLY);
+			calls = 1;
+			++tiles;
+			controller.reset();
+			move_started = now;
+			cross_encountered = false;
+			cross_corrected = false;
+		}
+
+		if (calls > 0 && command.primitive != MP_NONE)
+			wheels.command(command.primitive, command.left, command.right, calls);
+	}
+
+	double get_left() const { return wheels.get_left(); }
+	double get_right() const { return wheels.get_right(); }
+	int get_tiles() const { return tiles; }
+};
+
+/**
+ * Initial state of one benchmarked robot.
+ */
+struct batch_robot
+{
+	double left_gain = 1;
+	double right_gain = 1;
+	double offset = 0;
+	double heading = 0;
+};
+
+/**
+ * Final state of one benchmarked robot.
+ */
+struct batch_outcome
+{
+	double x = 0;
+	double y = 0;
+	int tiles = 0;
+};
+
+/**
+ * Simulates the robots one after another, each by its own diff_drive_model.
+ */
+inline std::vector<batch_outcome> run_scalar(const std::vector<batch_robot>& robots, const grid_map& map,
+                                             const line_controller_gains& gains, double duration)
+{
+	std::vector<batch_outcome> outcomes(robots.size());
+	const double dt = 0.001;
+	const long steps = (long) (duration / dt);
+	for (size_t i = 0; i < robots.size(); ++i)
+	{
+		robot_geometry geometry;
+		geometry.left_gain = robots[i].left_gain;
+		geometry.right_gain = robots[i].right_gain;
+		diff_drive_model model(geometry);
+		model.set_pose(map.tile + robots[i].offset, map.tile, M_PI / 2 + robots[i].heading);
+		straight_run run(gains, DEFAULT_CRUISE_SPEED / 1000.0);
+
+		for (long step = 0; step < steps; ++step)
+		{
+			run.update(model.read_pattern(map), (time_type) step);
+			model.set_wheel_speeds(run.get_left(), run.get_right());
+			model.step(dt);
+		}
+		outcomes[i].x = model.get_x();
+		outcomes[i].y = model.get_y();
+		outcomes[i].tiles = run.get_tiles();
+	}
+	return outcomes;
+}
+
+/**
+ * Simulates all robots in lock-step by one diff_drive_batch, each with its own state machine.
+ */
+inline std::vector<batch_outcome> run_batch(const std::vector<batch_robot>& robots, const grid_map& map,
+                                            const line_controller_gains& gains, double duration)
+{
+	const double dt = 0.001;
+	const long steps = (long) (duration / dt);
+	diff_drive_batch batch(robot_geometry(), robots.size());
+	std::vector<straight_run> runs(robots.size(), straight_run(gains, DEFAULT_CRUISE_SPEED / 1000.0));
+	for (size_t i = 0; i < robots.size(); ++i)
+	{
+		batch.set_gains(i, robots[i].left_gain, robots[i].right_gain);
+		batch.set_pose(i, map.tile + robots[i].offset, map.tile, M_PI / 2 + robots[i].heading);
+	}
+
+	for (long step = 0; step < steps; ++step)
+	{
+		batch.render(map);
+		for (size_t i = 0; i < robots.size(); ++i)
+		{
+			runs[i].update(batch.get_pattern(i), (time_type) step);
+			batch.set_wheel_speeds(i, runs[i].get_left(), runs[i].get_right());
+		}
+		batch.step(dt);
+	}
+
+	std::vector<batch_outcome> outcomes(robots.size());
+	for (size_t i = 0; i < robots.size(); ++i)
+	{
+		outcomes[i].x = batch.get_x(i);
+		outcomes[i].y = batch.get_y(i);
+		outcomes[i].tiles = runs[i].get_tiles();
+	}
+	return outcomes;
+}
+
+/**
+ * Compares the scalar and the batch simulation of the same robots in simulated robot-seconds per wall-second.
+ *
+ * @return 0 if both simulations drove the same tiles to the same places.
+ */
+inline int test_batch(int robot_count = 256, double duration = 20)
+{
+	line_controller_gains gains;
+	gains.kp = DEFAULT_KP;
+	gains.ki = DEFAULT_KI;
+	gains.kd = DEFAULT_KD;
+
+	std::mt19937 generator(2017);
+	std::uniform_real_distribution<double> offset(-8, 8);
+	std::uniform_real_distribution<double> heading(-0.1, 0.1);
+	std::uniform_real_distribution<double> asymmetry(0.95, 1.05);
+	std::vector<batch_robot> robots(robot_count);
+	for (batch_robot& robot : robots)
+	{
+		robot.left_gain = asymmetry(generator);
+		robot.right_gain = asymmetry(generator);
+		robot.offset = offset(generator);
+		robot.heading = heading(generator);
+	}
+
+	/* Long enough for the fastest robot */
+	grid_map map(3, (int) (duration * robot_geometry().max_speed / 200) + 4);
+
+	auto started = std::chrono::steady_clock::now();
+	const std::vector<batch_outcome> scalar = run_scalar(robots, map, gains, duration);
+	const double scalar_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	started = std::chrono::steady_clock::now();
+	const std::vector<batch_outcome> batch = run_batch(robots, map, gains, duration);
+	const double batch_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	int different = 0;
+	int tiles = 0;
+	double max_difference = 0;
+	for (int i = 0; i < robot_count; ++i)
+	{
+		const double difference = std::hypot(scalar[i].x - batch[i].x, scalar[i].y - batch[i].y);
+		max_difference = std::fmax(max_difference, difference);
+		tiles += scalar[i].tiles;
+		if (scalar[i].tiles != batch[i].tiles || difference > 1)
+			++different;
+	}
+
+	const double robot_seconds = robot_count * duration;
+	std::printf("->=>-> Batch simulation %d robots x %.0f s, %d tiles\n", robot_count, duration, tiles);
+	std::printf("scalar: %.0f robot-s/s\n", robot_seconds / scalar_wall);
+	std::printf("batch:  %.0f robot-s/s (%.2fx)\n", robot_seconds / batch_wall, scalar_wall / batch_wall);
+	std::printf("max pose difference %.6f mm, %d robots differ\n", max_difference, different);
+	return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include "telemetry_decoder.h"
+#include "tempo_report_test.h"
+#include <cstdio>
+
+/**
+ * Checks the switching of the policy and its choices of the axis order and the skips.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_catch_up_policy()
+{
+	int failures = 0;
+	catch_up_policy policy;
+
+	/* Facing North at { 0, 0 }, the target { 2, 2 } needs one turn with Y first and two with X first */
+	const location source(0, 0, North);
+	if (policy.is_active() || !policy.choose_first_x(source, position(2, 2), true))
+		++failures;
+	if (policy.should_skip(1000, 10000))
+		++failures;
+
+	policy.update(CATCH_UP_THRESHOLD);
+	if (policy.is_active())
+		++failures;
+	policy.update(CATCH_UP_THRESHOLD + 1);
+	if (!policy.is_active() || policy.choose_first_x(source, position(2, 2), true))
+		++failures;
+	/* A tie keeps the order of the dance */
+	if (!policy.choose_first_x(location(0, 0, East), position(2, 0), true))
+		++failures;
+	if (!policy.should_skip(1000, 1001 + CATCH_UP_SKIP_THRESHOLD) || policy.should_skip(1000, 1000 + CATCH_UP_SKIP_THRESHOLD)
+		|| policy.should_skip(0, 10000))
+		++failures;
+
+	/* Still late, then on time again */
+	policy.update(1);
+	if (!policy.is_active())
+		++failures;
+	policy.update(0);
+	if (policy.is_active())
+		++failures;
+
+	std::printf("catch up policy: %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+/**
+ * Simulates the dance in a tempo the robot cannot keep, without and with
+ * the catch up mode and with the skips of the overdue waypoints. The catch up must recover
+ * the synchronization with the time line at the end of the dance.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_catch_up(const std::string& dance_path)
+{
+	test_checks checks("Catch up on " + dance_path + " slowed");
+	checks.add(test_catch_up_policy());
+
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	/* The robot is slowed down against the dance by its time constraints cut to a half */
+	const std::string slowed = scale_time_constraints(dance, 1, 2);
+	const char* names[] = { "plain", "catch up", "catch up and skip" };
+	const uint8_t flags[] = { 0, CALIBRATION_CATCH_UP, CALIBRATION_CATCH_UP | CALIBRATION_SKIP_LATE };
+	tempo_data tempo[3];
+	for (int variant = 0; variant < 3; ++variant)
+	{
+		dance_simulator_config config = calibrated_config(flags[variant]);
+		config.capture_serial = true;
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run(slowed);
+		simulator.drain_telemetry();
+
+		unsigned skipped = 0;
+		for (const telemetry_event& event : parse_telemetry(simulator.get_machine().serial_output).events)
+			if (event.id == TELEMETRY_SKIPPED)
+				++skipped;
+
+		tempo[variant] = robot.get_tempo().get_data();
+		const tempo_data& data = tempo[variant];
+		checks.expect(result.finished, "%s did not finish the dance", names[variant]);
+		checks.expect(skipped == data.skipped, "%s reported %u skips of %u", names[variant], skipped, data.skipped);
+		checks.expect(variant == 2 || data.skipped == 0, "%s skipped %u waypoints", names[variant], data.skipped);
+	}
+
+	/* The plain run falls behind, the order of the axes does not make the catch up later and the skips recover
+	 * most of the time */
+	checks.expect(tempo[0].late > 0, "the plain run kept the tempo");
+	checks.expect(tempo[1].last_drift <= tempo[0].last_drift, "the catch up ends %ld ms late, the plain run %ld ms",
+		(long) tempo[1].last_drift, (long) tempo[0].last_drift);
+	checks.expect(tempo[2].last_drift * 2 <= tempo[1].last_drift && tempo[2].max_lateness * 2 <= tempo[1].max_lateness,
+		"the skips end %ld ms late, %u ms at most, the catch up %ld ms, %u ms at most", (long) tempo[2].last_drift,
+		tempo[2].max_lateness, (long) tempo[1].last_drift, tempo[1].max_lateness);
+	return checks.finish();
+}
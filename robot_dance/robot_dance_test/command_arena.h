@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../planning.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump allocator of the commands made by the test planners. The commands of a route live
+ * until the reset before the next route, the memory is then reused, so a long run of
+ * routes touches the heap only until the longest route has been seen.
+ */
+class command_arena
+{
+	static const size_t CHUNK_SIZE = 4096;
+
+	std::vector<std::unique_ptr<unsigned char[]>> chunks;
+	/* Chunk being filled and the bytes used of it */
+	size_t chunk = 0;
+	size_t used = 0;
+	std::vector<command*> live;
+
+	size_t created = 0;
+	size_t heap_allocations = 0;
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		used = (used + alignment - 1) / alignment * alignment;
+		if (chunk < chunks.size() && used + size > CHUNK_SIZE)
+		{
+			++chunk;
+			used = 0;
+		}
+		if (chunk == chunks.size())
+		{
+			chunks.emplace_back(new unsigned char[CHUNK_SIZE]);
+			++heap_allocations;
+		}
+		void* memory = chunks[chunk].get() + used;
+		used += size;
+		return memory;
+	}
+
+public:
+	command_arena() = default;
+	command_arena(const command_arena&) = delete;
+	command_arena& operator=(const command_arena&) = delete;
+
+	~command_arena()
+	{
+		reset();
+	}
+
+	/**
+	 * Constructs the command in the arena, it is destroyed by the next reset().
+	 */
+	template <typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		static_assert(sizeof(T) <= CHUNK_SIZE, "command does not fit into a chunk");
+		void* memory = allocate(sizeof(T), alignof(T));
+		T* object = new (memory) T(std::forward<Args>(args)...);
+		if (live.size() == live.capacity())
+			++heap_allocations;
+		live.push_back(object);
+		++created;
+		return object;
+	}
+
+	/**
+	 * Destroys all the commands and keeps the memory for the next ones.
+	 */
+	void reset()
+	{
+		for (command* object : live)
+			object->~command();
+		live.clear();
+		chunk = 0;
+		used = 0;
+	}
+
+	/**
+	 * Gets number of the commands created since the construction.
+	 */
+	size_t get_created() const
+	{
+		return created;
+	}
+
+	/**
+	 * Gets number of the allocations of the heap since the construction, chunks and the list of the commands.
+	 */
+	size_t get_heap_allocations() const
+	{
+		return heap_allocations;
+	}
+};
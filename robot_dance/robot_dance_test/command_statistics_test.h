@@ -0,0 +1,76 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include "telemetry_decoder.h"
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * Simulates the dance, queries the timing statistics of the commands over the console
+ * and checks them against the commands the firmware reported to execute.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_command_statistics(const std::string& dance_path)
+{
+	test_checks checks("Command statistics of " + dance_path);
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	dance_simulator_config config;
+	config.capture_serial = true;
+	dance_simulator simulator(config);
+	simulator.run(dance);
+
+	/* The query is served while the robot waits for the button */
+	hal_machine* previous = hal_current();
+	hal_current() = &simulator.get_machine();
+	const size_t dance_output = simulator.get_machine().serial_output.size();
+	hal_serial_receive("M\n");
+	console.poll();
+	hal_current() = previous;
+
+	/* The telemetry reports the duration and the update calls of every finished command */
+	const std::string& output = simulator.get_machine().serial_output;
+	size_t processed = 0;
+	uint32_t updates = 0;
+	uint32_t reported[COMMAND_KINDS] = {};
+	uint16_t most_updates[COMMAND_KINDS] = {};
+	for (const telemetry_event& event : parse_telemetry(output.substr(0, dance_output)).events)
+	{
+		processed += event.id == TELEMETRY_COMMAND_START ? 1 : 0;
+		if (event.id == TELEMETRY_COMMAND_END && event.value(0, 1) < COMMAND_KINDS)
+		{
+			reported[event.value(0, 1)] += event.value(1, 2);
+			updates += event.value(3, 2);
+			most_updates[event.value(0, 1)] = std::max(most_updates[event.value(0, 1)], (uint16_t) event.value(3, 2));
+		}
+	}
+
+	const command_statistics& statistics = robot.get_command_statistics();
+	uint32_t commands = 0;
+	for (uint8_t kind = 0; kind < COMMAND_KINDS; ++kind)
+	{
+		const command_timing& timing = statistics.get_timing(kind);
+		uint32_t bucketed = 0;
+		for (uint8_t i = 0; i < COMMAND_BUCKETS; ++i)
+			bucketed += timing.buckets[i];
+		checks.expect(bucketed == timing.count && timing.min_duration <= timing.max_duration,
+			"histogram of the command kind %u holds %u of %u commands", kind, bucketed, timing.count);
+		checks.expect(timing.total_duration == reported[kind], "command kind %u took %lu ms, reported %u ms", kind,
+			(unsigned long) timing.total_duration, reported[kind]);
+		checks.expect(timing.max_updates == most_updates[kind], "command kind %u took up to %u updates, reported %u",
+			kind, timing.max_updates, most_updates[kind]);
+		commands += timing.count;
+	}
+
+	/* Every command finished, each update is one control step */
+	checks.expect(commands == processed && commands > 0, "%u commands of %zu processed", commands, processed);
+	checks.expect(updates <= robot.get_scheduler().get_steps(), "%u updates in %u control steps", updates,
+		robot.get_scheduler().get_steps());
+	checks.expect(output.find("move: n=", dance_output) != std::string::npos &&
+		output.find(" updates<=", dance_output) != std::string::npos, "the statistics are not printed");
+	return checks.finish();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Mean and maximal heading error of the robot at the ends of the moves.
+ */
+struct move_heading_error
+{
+	int moves = 0;
+	double mean = 0;
+	double max = 0;
+
+	explicit move_heading_error(const dance_result& result)
+	{
+		double sum = 0;
+		for (size_t i = 1; i < result.crosses.size(); ++i)
+		{
+			/* The turns end on the same cross */
+			if (result.crosses[i].reported.get_position() == result.crosses[i - 1].reported.get_position())
+				continue;
+			const double error = std::fabs(result.crosses[i].heading_error);
+			sum += error;
+			max = std::max(max, error);
+			++moves;
+		}
+		mean = moves > 0 ? sum / moves : 0;
+	}
+};
+
+/**
+ * Simulates the dance without and with the heading correction by the entry skew of the outer sensors
+ * on the crosses, polled and captured by the edges. The corrected runs must finish the dance
+ * with the robot heading along the lines at the ends of the moves at least as well.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_cross_skew(const std::string& dance_path)
+{
+	test_checks checks("Skew correction on " + dance_path);
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	const char* names[] = { "table", "skew polled", "skew captured" };
+	const uint8_t flags[] = { 0, CALIBRATION_SKEW_CORRECTION, CALIBRATION_SKEW_CORRECTION | CALIBRATION_EDGE_CAPTURE };
+	double uncorrected = 0;
+	for (int variant = 0; variant < 3; ++variant)
+	{
+		const dance_simulator_config config = calibrated_config(flags[variant]);
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run(dance);
+		const move_heading_error heading(result);
+
+		if (variant == 0)
+			uncorrected = heading.mean;
+		checks.expect_on_course(result, config, names[variant]);
+		checks.expect(heading.moves > 0 && heading.mean <= uncorrected, "%s ends the moves %.1f mrad off the lines, "
+			"the table %.1f mrad", names[variant], 1000 * heading.mean, 1000 * uncorrected);
+	}
+
+	return checks.finish();
+}
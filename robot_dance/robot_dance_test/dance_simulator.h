@@ -0,0 +1,532 @@
+#pragma once
+
+#include "firmware_host.h"
+#include "sim_model.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * Error of the physical robot after the firmware reported a new location.
+ */
+struct cross_error
+{
+	location reported;
+	double time = 0;
+	double position_error = 0;
+	double heading_error = 0;
+};
+
+/**
+ * Arrival of the robot to one waypoint of the dance.
+ */
+struct waypoint_arrival
+{
+	position target;
+	/* Time constraint of the waypoint in s since the start */
+	double deadline = 0;
+	/* Time of the arrival in s since the start, negative if not reached */
+	double arrival = -1;
+
+	bool is_reached() const
+	{
+		return arrival >= 0;
+	}
+
+	/* An unreached waypoint is not late, it is counted apart */
+	bool is_late() const
+	{
+		return is_reached() && arrival > deadline;
+	}
+};
+
+/**
+ * Outcome of one simulated dance.
+ */
+struct dance_result
+{
+	std::vector<cross_error> crosses;
+	std::vector<waypoint_arrival> waypoints;
+	double dance_time = 0;
+	double mean_position_error = 0;
+	double max_position_error = 0;
+	double max_heading_error = 0;
+	/* Serial writes which blocked the firmware between the start and the last reported cross, their wait in s */
+	uint32_t serial_stalls = 0;
+	double serial_stall_time = 0;
+	bool finished = false;
+	bool lost = false;
+};
+
+/**
+ * Parameters of the simulated robot and its world.
+ */
+struct dance_simulator_config
+{
+	robot_geometry geometry;
+	grid_map map = grid_map(4, 4);
+
+	/* Integration step of the robot motion in us */
+	uint64_t step = 500;
+
+	/* Limit of the virtual time of one dance in s */
+	double time_limit = 600;
+
+	/* Probability of a wrong reading of each sensor in one step */
+	double sensor_noise = 0;
+
+	/* Seed of the random noise */
+	uint32_t seed = 1;
+
+	/* Calibration written to the EEPROM before the power-on, the firmware defaults are used otherwise */
+	bool preload_calibration = false;
+	calibration_data calibration = {};
+
+	/* Keeps the Serial output in the machine, e.g. for the trace */
+	bool capture_serial = false;
+
+	/* Stops the dance when the robot is farther than half a tile from the reported cross */
+	bool stop_when_lost = true;
+};
+
+/**
+ * Runs the real firmware on the virtual machine of the Linux HAL with a Boe-Bot
+ * driving on a black line grid. The servo pulses are integrated by the differential
+ * drive model and the five IR sensors are rendered over the grid at every step.
+ * The button is pushed by a script, which uploads the dance over the Serial line
+ * and starts it, exactly as the user does.
+ */
+class dance_simulator
+{
+protected:
+	dance_simulator_config config;
+	hal_machine machine;
+	diff_drive_model model;
+
+	/* Time of the next change of the sensor inputs other than the motion steps, if sense() knows it */
+	uint64_t sense_time = UINT64_MAX;
+
+	/**
+	 * Gets the sensor pattern seen at the given time, rendered over the map with the random errors.
+	 */
+	virtual uint8_t sense(uint64_t)
+	{
+		uint8_t pattern = model.read_pattern(config.map);
+		if (config.sensor_noise > 0)
+		{
+			for (uint8_t i = 0; i < 5; ++i)
+				if (sensor_flip(random))
+					pattern ^= (uint8_t) (1 << i);
+		}
+		return pattern;
+	}
+
+private:
+	enum script_phase
+	{
+		LONG_PRESS,
+		UPLOAD,
+		UPLOAD_DONE,
+		START,
+		DANCING
+	};
+
+	/* Length of a short push in us, the firmware samples the button twice by DEBOUNCE_TIME */
+	static const uint64_t SHORT_PUSH = 4 * DEBOUNCE_TIME * 1000;
+
+	std::mt19937 random;
+	std::bernoulli_distribution sensor_flip;
+
+	std::string dance;
+	script_phase phase = LONG_PRESS;
+	uint64_t phase_time = 0;
+	uint64_t next_step = 0;
+	uint64_t dance_start = 0;
+	uint32_t stalls_at_start = 0;
+	uint64_t stall_time_at_start = 0;
+	location last_location;
+	size_t next_waypoint = 0;
+	dance_result result;
+
+	/**
+	 * Converts the servo pulse to the wheel speed from [-1; 1] as wheel_control computes it.
+	 */
+	static double pulse_to_speed(uint16_t pulse, int min_pulse, int max_pulse)
+	{
+		if (pulse == 0)
+			return 0;
+		return 2.0 * (pulse - min_pulse) / (max_pulse - min_pulse) - 1;
+	}
+
+	static void hook(void* context)
+	{
+		((dance_simulator*) context)->advance();
+	}
+
+	void press(bool pushed)
+	{
+		hal_set_input(2, pushed ? LOW : HIGH);
+	}
+
+	void advance()
+	{
+		const uint64_t now = machine.time;
+		while (next_step <= now)
+		{
+			model.set_wheel_speeds(
+				pulse_to_speed(machine.servo_pulse[12], MIN_LEFT_SPEED, MAX_LEFT_SPEED),
+				pulse_to_speed(machine.servo_pulse[13], MIN_RIGHT_SPEED, MAX_RIGHT_SPEED));
+			model.step(config.step * 1e-6);
+			next_step += config.step;
+		}
+
+		const uint8_t pattern = sense(now);
+		for (uint8_t i = 0; i < 5; ++i)
+			hal_set_input((uint8_t) (3 + i), (pattern & (1 << i)) ? LOW : HIGH);
+
+		run_script(now);
+		check_location(now);
+		machine.hook_time = std::min(next_step, sense_time);
+
+		if (now * 1e-6 > config.time_limit || result.lost)
+			throw firmware_halt();
+	}
+
+	void run_script(uint64_t now)
+	{
+		switch (phase)
+		{
+		case LONG_PRESS:
+			/* Long push switches the firmware to the upload */
+			press(now >= 100000 && now < 800000);
+			if (now >= 800000)
+			{
+				hal_serial_receive(dance.c_str());
+				phase = UPLOAD;
+			}
+			break;
+		case UPLOAD:
+			/* Every character is written to the EEPROM, push when all were read */
+			if (machine.serial_input.empty())
+			{
+				phase = UPLOAD_DONE;
+				phase_time = now + 50000;
+			}
+			break;
+		case UPLOAD_DONE:
+			press(now >= phase_time && now < phase_time + SHORT_PUSH);
+			/* The firmware prints the parsed dance, it polls the button again when the Serial line is quiet */
+			if (now >= phase_time + 2 * SHORT_PUSH && now >= machine.serial_empty_time + 200000)
+			{
+				phase = START;
+				phase_time = now;
+			}
+			break;
+		case START:
+			press(now < phase_time + SHORT_PUSH);
+			if (now >= phase_time + SHORT_PUSH)
+			{
+				/* The dance starts by the release */
+				phase = DANCING;
+				dance_start = now;
+				stalls_at_start = machine.serial_stalls;
+				stall_time_at_start = machine.serial_stall_time;
+				last_location = robot.get_location();
+				reach_waypoints(last_location.get_position(), 0);
+			}
+			break;
+		case DANCING:
+			break;
+		}
+	}
+
+	/**
+	 * Every route ends on its waypoint and passes it only there,
+	 * the following waypoints at the same place are reached at once.
+	 */
+	void reach_waypoints(const position& at, double time)
+	{
+		while (next_waypoint < result.waypoints.size() && result.waypoints[next_waypoint].target == at)
+			result.waypoints[next_waypoint++].arrival = time;
+	}
+
+	void check_location(uint64_t now)
+	{
+		if (phase != DANCING)
+			return;
+
+		const location& current = robot.get_location();
+		if (current == last_location)
+			return;
+		last_location = current;
+
+		cross_error error;
+		error.reported = current;
+		error.time = (now - dance_start) * 1e-6;
+
+		reach_waypoints(current.get_position(), error.time);
+		result.serial_stalls = machine.serial_stalls - stalls_at_start;
+		result.serial_stall_time = (machine.serial_stall_time - stall_time_at_start) * 1e-6;
+
+		const double cross_x = current.get_position().get_x() * config.map.tile;
+		const double cross_y = current.get_position().get_y() * config.map.tile;
+		error.position_error = std::hypot(model.get_x() - cross_x, model.get_y() - cross_y);
+		error.heading_error = std::remainder(model.get_heading() - direction_heading(current.get_direction()), 2 * M_PI);
+		result.crosses.push_back(error);
+
+		if (error.position_error > config.map.tile / 2 && config.stop_when_lost)
+			result.lost = true;
+	}
+
+	static double direction_heading(direction dir)
+	{
+		switch (dir)
+		{
+		case East: return 0;
+		case North: return M_PI / 2;
+		case West: return M_PI;
+		case South: return -M_PI / 2;
+		default: return 0;
+		}
+	}
+
+	/**
+	 * Parses a location like "B3" or "3B", the direction is not part of it.
+	 *
+	 * @return Number of the characters read, 0 if the token is not a location.
+	 */
+	static size_t parse_position(const std::string& token, position& parsed)
+	{
+		size_t i = 0;
+		int x = 0, y = 0;
+		if (i < token.size() && std::isalpha((unsigned char) token[i]))
+		{
+			x = std::tolower(token[i++]) - 'a';
+			if (i >= token.size() || !std::isdigit((unsigned char) token[i]))
+				return 0;
+			y = std::atoi(token.c_str() + i) - 1;
+			while (i < token.size() && std::isdigit((unsigned char) token[i]))
+				++i;
+		}
+		else if (i < token.size() && std::isdigit((unsigned char) token[i]))
+		{
+			y = std::atoi(token.c_str() + i) - 1;
+			while (i < token.size() && std::isdigit((unsigned char) token[i]))
+				++i;
+			if (i >= token.size() || !std::isalpha((unsigned char) token[i]))
+				return 0;
+			x = std::tolower(token[i++]) - 'a';
+		}
+		else
+		{
+			return 0;
+		}
+		parsed = position(x, y);
+		return i;
+	}
+
+	/**
+	 * Reads the initial location, e.g. "A2E" or "2AE", and the waypoints with their time constraints.
+	 * The robot is placed to the initial location.
+	 */
+	void parse_dance()
+	{
+		std::istringstream tokens(dance);
+		std::string token;
+		position initial(0, 0);
+		direction dir = North;
+
+		if (tokens >> token)
+		{
+			const size_t length = parse_position(token, initial);
+			switch (length < token.size() ? std::toupper(token[length]) : 'N')
+			{
+			case 'E': dir = East; break;
+			case 'S': dir = South; break;
+			case 'W': dir = West; break;
+			default: dir = North; break;
+			}
+		}
+
+		while (tokens >> token)
+		{
+			position target(0, 0);
+			if (std::toupper(token[0]) == 'T' && !result.waypoints.empty())
+				result.waypoints.back().deadline = std::atoi(token.c_str() + 1) / 10.0;
+			else if (parse_position(token, target) > 0)
+			{
+				waypoint_arrival waypoint;
+				waypoint.target = target;
+				result.waypoints.push_back(waypoint);
+			}
+		}
+
+		model.set_pose(initial.get_x() * config.map.tile, initial.get_y() * config.map.tile, direction_heading(dir));
+	}
+
+public:
+	explicit dance_simulator(const dance_simulator_config& config)
+		: config(config), model(config.geometry), random(config.seed), sensor_flip(config.sensor_noise)
+	{
+	}
+
+	virtual ~dance_simulator()
+	{
+	}
+
+	/**
+	 * Gets the virtual machine, e.g. to inspect the Serial output.
+	 */
+	hal_machine& get_machine()
+	{
+		return machine;
+	}
+
+	/**
+	 * Sends the rest of the telemetry of the dance, as the firmware does while it waits for the button.
+	 */
+	void drain_telemetry()
+	{
+		hal_machine* previous = hal_current();
+		hal_current() = &machine;
+		while (robot.get_telemetry().drain())
+			delay(1);
+		hal_current() = previous;
+	}
+
+	/**
+	 * Powers the robot on, uploads the dance and runs it until its end.
+	 *
+	 * @param dance_text Dance in the format of the EEPROM parser.
+	 */
+	dance_result run(const std::string& dance_text)
+	{
+		dance = dance_text;
+		/* The parser accepts line breaks only after a time, the upload tools send one line */
+		for (char& c : dance)
+			if (c == '\n' || c == '\r')
+				c = ' ';
+		/* The parser needs a separator after the last waypoint */
+		dance += " ";
+
+		firmware_construct();
+		hal_machine* previous = hal_current();
+		hal_current() = &machine;
+		machine.serial_capture = config.capture_serial;
+		machine.hook = &dance_simulator::hook;
+		machine.hook_context = this;
+
+		parse_dance();
+		if (config.preload_calibration)
+			std::memcpy(machine.eeprom + EEPROM_CALIBRATION_ADDRESS, &config.calibration, sizeof(calibration_data));
+		try
+		{
+			firmware_reset();
+			setup();
+			loop();
+			result.finished = !result.lost;
+		}
+		catch (const firmware_halt&)
+		{
+		}
+
+		result.dance_time = (machine.time - dance_start) * 1e-6;
+		for (const cross_error& error : result.crosses)
+		{
+			result.mean_position_error += error.position_error / result.crosses.size();
+			result.max_position_error = std::fmax(result.max_position_error, error.position_error);
+			result.max_heading_error = std::fmax(result.max_heading_error, std::fabs(error.heading_error));
+		}
+
+		machine.hook = nullptr;
+		hal_current() = previous;
+		return result;
+	}
+};
+
+/**
+ * Gets the configuration of a dance with the firmware defaults and the given calibration flags in the EEPROM.
+ */
+inline dance_simulator_config calibrated_config(uint16_t flags)
+{
+	dance_simulator_config config;
+	config.preload_calibration = true;
+	config.calibration = calibration().get_data();
+	config.calibration.flags |= flags;
+	return config;
+}
+
+/**
+ * Failed checks of one test. Each failure is printed with its description,
+ * the test ends by a single summary line.
+ */
+class test_checks
+{
+	std::string name;
+	int failures = 0;
+
+public:
+	explicit test_checks(const std::string& name) : name(name)
+	{
+	}
+
+	/**
+	 * Counts the check as failed unless it holds.
+	 *
+	 * @param ok Result of the check.
+	 * @param format Description of the failure in the printf format.
+	 * @return The result of the check.
+	 */
+	bool expect(bool ok, const char* format, ...) __attribute__((format(printf, 3, 4)))
+	{
+		if (ok)
+			return true;
+		++failures;
+		std::printf("%s: ", name.c_str());
+		va_list args;
+		va_start(args, format);
+		std::vprintf(format, args);
+		va_end(args);
+		std::printf(": FAILED\n");
+		return false;
+	}
+
+	/**
+	 * Checks that the robot finished the dance with the reported crosses within a quarter of the tile.
+	 *
+	 * @param variant Name of the simulated variant in the descriptions of the failures.
+	 * @return If both checks hold.
+	 */
+	bool expect_on_course(const dance_result& result, const dance_simulator_config& config, const char* variant)
+	{
+		return expect(result.finished && !result.lost, "%s did not finish the dance", variant)
+			&& expect(result.max_position_error < config.map.tile / 4, "%s drove %.1f mm off the crosses", variant,
+				result.max_position_error);
+	}
+
+	/**
+	 * Adds the failures counted apart, e.g. by a unit test of the feature.
+	 */
+	void add(int count)
+	{
+		failures += count;
+	}
+
+	/**
+	 * Prints the summary line of the test.
+	 *
+	 * @return Number of failed checks.
+	 */
+	int finish() const
+	{
+		std::printf("->=>-> %s: %s\n", name.c_str(), failures == 0 ? "ok" : "FAILED");
+		return failures;
+	}
+};
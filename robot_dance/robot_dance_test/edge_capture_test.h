@@ -0,0 +1,162 @@
+#pragma once
+
+#include "../sensor_edges.h"
+#include "sim_model.h"
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+/**
+ * Checks order, wrap-around and drop accounting of the edge ring.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_edge_ring()
+{
+	int failures = 0;
+	sensor_edge_ring ring;
+	sensor_edge edge;
+
+	/* Indices wrap around 256 many times */
+	for (int i = 0; i < 1000; ++i)
+	{
+		ring.push((uint8_t) (i & 0x1F), (time_type) i);
+		if (!ring.pop(&edge) || edge.time != (time_type) i || edge.pattern != (i & 0x1F))
+			++failures;
+	}
+
+	for (int i = 0; i < SENSOR_EDGE_RING_SIZE + 4; ++i)
+		ring.push(0, (time_type) i);
+	if (ring.get_dropped() != 4)
+		++failures;
+	for (int i = 0; i < SENSOR_EDGE_RING_SIZE; ++i)
+	{
+		if (!ring.pop(&edge) || edge.time != (time_type) i)
+			++failures;
+	}
+	if (ring.pop(&edge) || !ring.empty())
+		++failures;
+
+	std::cout << "edge ring: " << (failures == 0 ? "ok" : "FAILED") << std::endl;
+	return failures;
+}
+
+/**
+ * Accuracy of the entry skew of the outer sensors over a cross line.
+ */
+struct skew_accuracy
+{
+	double error_sum = 0;
+	double max_error = 0;
+	int count = 0;
+
+	void add(double error)
+	{
+		error = std::fabs(error);
+		error_sum += error;
+		max_error = std::fmax(max_error, error);
+		++count;
+	}
+
+	void print(const char* name, double heading_per_us) const
+	{
+		double mean = error_sum / std::max(1, count);
+		std::cout << name << " skew error mean " << mean << " us, max " << max_error
+			<< " us, heading error mean " << mean * heading_per_us * 1000 << " mrad" << std::endl;
+	}
+};
+
+/**
+ * Drives the robot over a perpendicular line with a random heading error and compares
+ * the entry skew of the outer sensors taken by polling in a loop with a jittering period
+ * and by the edges pushed from the simulated pin change interrupt.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_edge_capture(int runs = 500)
+{
+	int failures = test_edge_ring();
+
+	robot_geometry geometry;
+	geometry.servo_lag = 0;
+	grid_map map(3, 3);
+	const double speed = 0.85;
+	const double dt_us = 10;
+	const double line_edge = map.tile - map.line_width / 2;
+
+	std::mt19937 generator(2028);
+	std::uniform_real_distribution<double> heading(-0.1, 0.1);
+	std::uniform_int_distribution<int> loop_period(1000, 4000);
+
+	skew_accuracy polled, captured;
+	double velocity = 0;
+
+	for (int run = 0; run < runs; ++run)
+	{
+		diff_drive_model model(geometry);
+		model.set_pose(map.tile, map.tile / 2, M_PI / 2 + heading(generator));
+		model.set_wheel_speeds(speed, speed);
+		velocity = model.servo_speed(speed);
+
+		/* Sensors move straight with a constant speed, their entry times are known exactly */
+		double sin_heading = std::sin(model.get_heading());
+		double left_x, left_y, right_x, right_y;
+		model.sensor_position(0, &left_x, &left_y);
+		model.sensor_position(4, &right_x, &right_y);
+		double true_skew = ((line_edge - right_y) - (line_edge - left_y)) / (velocity * sin_heading) * 1e6;
+
+		sensor_edge_ring ring;
+		sensor_entry_times polling_entries, edge_entries;
+		uint8_t isr_pattern = model.read_pattern(map);
+		polling_entries.process(isr_pattern, 0);
+		edge_entries.process(isr_pattern, 0);
+
+		double t_us = 0;
+		double next_loop = loop_period(generator);
+		while (t_us < 1.5e6 && !((edge_entries.get_pattern() & PATTERN_FIRST_LEFT)
+		                         && (edge_entries.get_pattern() & PATTERN_FIRST_RIGHT)
+		                         && (polling_entries.get_pattern() & PATTERN_FIRST_LEFT)
+		                         && (polling_entries.get_pattern() & PATTERN_FIRST_RIGHT)))
+		{
+			model.step(dt_us * 1e-6);
+			t_us += dt_us;
+
+			/* Simulated pin change interrupt */
+			uint8_t pattern = model.read_pattern(map);
+			if (pattern != isr_pattern)
+			{
+				isr_pattern = pattern;
+				ring.push(pattern, (time_type) t_us);
+			}
+
+			/* Simulated main loop */
+			if (t_us >= next_loop)
+			{
+				next_loop += loop_period(generator);
+				if (pattern != polling_entries.get_pattern())
+					polling_entries.process(pattern, (time_type) t_us);
+				sensor_edge edge;
+				while (ring.pop(&edge))
+					edge_entries.process(edge.pattern, edge.time);
+			}
+		}
+
+		if (ring.get_dropped() != 0)
+			++failures;
+
+		polled.add((double) polling_entries.get_entry_time(4) - (double) polling_entries.get_entry_time(0) - true_skew);
+		captured.add((double) edge_entries.get_entry_time(4) - (double) edge_entries.get_entry_time(0) - true_skew);
+	}
+
+	/* Heading change per us of skew: lateral distance of the outer sensors covered by the skew */
+	double heading_per_us = velocity * 1e-6 / (4 * geometry.sensor_pitch);
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "->=>-> Cross entry skew " << runs << " runs, loop period 1-4 ms" << std::endl;
+	polled.print("polling:", heading_per_us);
+	captured.print("edges:  ", heading_per_us);
+
+	if (captured.max_error > 2 * dt_us)
+		++failures;
+	return failures;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/**
+ * Reads the whole file, e.g. a dance or a Serial log.
+ *
+ * @return If the file could be read.
+ */
+inline bool read_file(const std::string& path, std::string& content)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "cannot open " << path << std::endl;
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	content = text.str();
+	return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/* The whole firmware as one translation unit, the same way the Arduino IDE builds the sketch */
+#include "../robot_dance.ino"
+#include <new>
+
+/**
+ * Thrown from a machine hook to stop the firmware running in loop().
+ */
+struct firmware_halt
+{
+};
+
+/**
+ * Constructs the globals of the sketch in this thread if it did not happen yet. The constructors
+ * access the EEPROM and the Serial line of the current machine, so this should be called before
+ * switching to a simulated one, which is then the same in the first run of the thread as in the others.
+ */
+inline void firmware_construct()
+{
+	(void) &robot;
+	(void) &cmep;
+	(void) &bbp;
+	(void) &console;
+	(void) &idle;
+}
+
+/**
+ * Constructs all globals of the sketch again on the current machine, as after a power-on.
+ */
+inline void firmware_reset()
+{
+	robot.~boe_bot();
+	new (&robot) boe_bot();
+	cmep.~command_parser_eeprom();
+	new (&cmep) command_parser_eeprom();
+	bbp.~boe_bot_planner();
+	new (&bbp) boe_bot_planner();
+	console.~serial_console();
+	new (&console) serial_console(&robot);
+	idle.~idle_phase();
+	new (&idle) idle_phase(&robot);
+
+	cmd_parser = nullptr;
+	pl = nullptr;
+	next_fetched = false;
+	next_exists = false;
+	next_planned = false;
+}
+
+/**
+ * Runs loop() until a hook of the machine throws firmware_halt.
+ */
+inline void firmware_run()
+{
+	try
+	{
+		for (;;)
+			loop();
+	}
+	catch (const firmware_halt&)
+	{
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "firmware_host.h"
+#include "telemetry_decoder.h"
+#include <iostream>
+#include <chrono>
+
+/**
+ * Environment of the firmware smoke test: pushes the button by a script, no line is ever seen.
+ */
+struct button_script
+{
+	/* Times of the button changes in us, pushed between the odd and even ones */
+	uint64_t changes[4] = {1000000, 1100000, 2000000, 2100000};
+	uint64_t halt_time = 6000000;
+
+	static void hook(void* context)
+	{
+		const button_script* script = (const button_script*) context;
+		const uint64_t now = hal().time;
+		bool pushed = false;
+		for (int i = 0; i < 4; i += 2)
+			pushed |= now >= script->changes[i] && now < script->changes[i + 1];
+		hal_set_input(2, pushed ? LOW : HIGH);
+		if (now >= script->halt_time)
+			throw firmware_halt();
+	}
+};
+
+inline int expect_output(const std::string& output, const char* text)
+{
+	if (output.find(text) != std::string::npos)
+		return 0;
+	std::cout << "missing output: " << text << std::endl;
+	return 1;
+}
+
+/**
+ * Boots the real firmware on the virtual machine of the Linux HAL, configures it over
+ * the Serial line and starts the default dance by the button.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_firmware()
+{
+	int failures = 0;
+	auto wall_start = std::chrono::steady_clock::now();
+
+	hal_machine machine;
+	hal_machine* previous = hal_current();
+	hal_current() = &machine;
+	firmware_reset();
+	setup();
+
+	failures += expect_output(machine.serial_output, "Magic not found, writing default...");
+	failures += expect_output(machine.serial_output, "Calibration not found, using defaults");
+
+	hal_serial_receive("K 700 10 20\nV 600\nC\n");
+	button_script script;
+	machine.hook = &button_script::hook;
+	machine.hook_context = &script;
+	firmware_run();
+
+	failures += expect_output(machine.serial_output, "flags=0 kp=700 ki=10 kd=20 cruise=600 loop=700");
+	failures += expect_output(machine.serial_output, "Short button press.");
+	failures += expect_output(parse_telemetry(machine.serial_output).text, "processing: move");
+
+	/* The calibration was stored in the background while waiting for the button */
+	calibration stored;
+	if (!stored.load() || stored.get_gains().kp != 700 || stored.get_cruise_speed() != 0.6)
+	{
+		std::cout << "calibration not stored" << std::endl;
+		++failures;
+	}
+
+	/* No line is found, the robot stands after the bounded search for it until the watchdog abandons the move */
+	if (machine.servo_pulse[12] != 1500 || machine.servo_pulse[13] != 1500)
+	{
+		std::cout << "robot does not stop after the line search" << std::endl;
+		++failures;
+	}
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	std::cout << "->=>-> Firmware on the Linux HAL: " << machine.time / 1e6 << " s of virtual time in "
+		<< wall << " s, " << machine.eeprom_writes << " EEPROM writes" << std::endl;
+	std::cout << (failures == 0 ? "ok" : "FAILED") << std::endl;
+
+	hal_current() = previous;
+	return failures;
+}
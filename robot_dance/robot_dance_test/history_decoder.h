@@ -0,0 +1,99 @@
+#pragma once
+
+#include "telemetry_decoder.h"
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Pattern valid since the given time, expanded from the sensor history.
+ */
+struct history_change
+{
+	/* Time in ms of the robot clock */
+	long time = 0;
+	uint8_t pattern = 0;
+};
+
+/**
+ * Dump of the sensor history as printed by sensors::print_history.
+ */
+struct history_dump
+{
+	std::vector<uint8_t> bytes;
+	/* Time of the newest change in ms */
+	long last_time = 0;
+};
+
+/**
+ * Finds the last dump of the sensor history in the Serial output.
+ *
+ * @return If there was any dump.
+ */
+inline bool parse_history_dump(const std::string& output, history_dump& dump)
+{
+	static const std::string header = "sensor history: ";
+	/* The binary frames of the telemetry may contain line ends */
+	std::istringstream lines(parse_telemetry(output).text);
+	std::string line;
+	bool found = false;
+	bool inside = false;
+	while (std::getline(lines, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.compare(0, header.size(), header) == 0)
+		{
+			const size_t until = line.find("until ");
+			dump = history_dump();
+			dump.last_time = until != std::string::npos ? std::atol(line.c_str() + until + 6) : 0;
+			found = inside = true;
+		}
+		else if (inside && !line.empty() && line[0] == '%')
+		{
+			for (size_t i = 1; i + 1 < line.size(); i += 2)
+				dump.bytes.push_back((uint8_t) std::strtoul(line.substr(i, 2).c_str(), nullptr, 16));
+		}
+		else
+		{
+			inside = false;
+		}
+	}
+	return found;
+}
+
+/**
+ * Expands the stored changes into a timeline, the oldest change first.
+ */
+inline std::vector<history_change> decode_history(const history_dump& dump)
+{
+	std::vector<history_change> changes;
+	std::vector<long> deltas;
+	size_t i = 0;
+	while (i < dump.bytes.size())
+	{
+		uint8_t value = dump.bytes[i++];
+		history_change change;
+		change.pattern = value & 0x1F;
+		long delta = (value >> 5) & 0x03;
+		int shift = 2;
+		while ((value & 0x80) && i < dump.bytes.size())
+		{
+			value = dump.bytes[i++];
+			delta |= (long) (value & 0x7F) << shift;
+			shift += 7;
+		}
+		changes.push_back(change);
+		deltas.push_back(delta);
+	}
+
+	/* The times run back from the newest change */
+	long time = dump.last_time;
+	for (size_t j = changes.size(); j-- > 0;)
+	{
+		changes[j].time = time;
+		time -= deltas[j];
+	}
+	return changes;
+}
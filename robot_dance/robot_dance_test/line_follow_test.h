@@ -0,0 +1,259 @@
+#pragma once
+
+#include "../line_controller.h"
+#include "../loop_scheduler.h"
+#include "sim_model.h"
+#include "sensor_table_test.h"
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <functional>
+#include <memory>
+
+/**
+ * Number of firmware loop iterations per millisecond paced by the loop scheduler.
+ */
+#define FIRMWARE_CALLS_PER_MS   (1000 / DEFAULT_LOOP_PERIOD)
+
+/**
+ * Identity of the PID steering for the smoothing, it is not one of the table primitives.
+ */
+#define STEERING_PRIMITIVE      (MP_COUNT)
+
+/**
+ * Outcome of one simulated straight run.
+ */
+struct line_follow_result
+{
+	double tile_time = 0;
+	double rms_offset = 0;
+	double stop_error = 0;
+	bool lost = false;
+};
+
+/**
+ * Wheel command of one primitive call.
+ */
+struct wheel_command
+{
+	int primitive = MP_NONE;
+	double left = 0;
+	double right = 0;
+};
+
+/**
+ * Steering of the robot: gets the sensor pattern, time in ms and desired speed, returns the wheel command.
+ */
+typedef std::function<wheel_command(uint8_t pattern, time_type now, double speed)> steering;
+
+inline wheel_command primitive_command(motion_primitive primitive)
+{
+	wheel_command command;
+	command.primitive = primitive;
+	primitive_wheel_speeds(primitive, &command.left, &command.right);
+	return command;
+}
+
+/**
+ * Drives the middle line of a grid tile by tile with the phases of move_command
+ * (minimal move, cross encounter, cross correction, centering), the steering only
+ * replaces move_command::go_straight.
+ */
+inline line_follow_result run_line_follow(const robot_geometry& geometry, double offset, double heading_error,
+                                          int tiles, double cruise_speed, const std::function<steering()>& make_steering)
+{
+	const double dt = 0.001;
+	const double lost_offset = 2.5 * geometry.sensor_pitch;
+
+	grid_map map(3, tiles + 3);
+	diff_drive_model model(geometry);
+	wheel_smoothing wheels;
+	model.set_pose(map.tile + offset, map.tile, M_PI / 2 + heading_error);
+
+	line_follow_result result;
+	double squared_offset = 0;
+	long steps = 0;
+	double t = 0;
+
+	for (int tile = 0; tile < tiles && !result.lost; ++tile)
+	{
+		steering go_straight = make_steering();
+		time_type move_started = (time_type) (t * 1000);
+		time_type cross_encountered_time = 0;
+		bool cross_encountered = false;
+		bool cross_corrected = false;
+		bool done = false;
+
+		while (!done && t < 120)
+		{
+			uint8_t pattern = model.read_pattern(map);
+			time_type now = (time_type) (t * 1000);
+			pattern_sensors sensors(pattern);
+			wheel_command command;
+			int calls = FIRMWARE_CALLS_PER_MS;
+
+			if (!cross_encountered)
+			{
+				if (now - move_started >= 300 && (sensors.first_left() || sensors.first_right()))
+				{
+					cross_encountered = true;
+					cross_encountered_time = now;
+					calls = 0;
+				}
+				else
+				{
+					command = go_straight(pattern, now, cruise_speed);
+				}
+			}
+			else if (!cross_corrected)
+			{
+				command = primitive_command(lookup_primitive(CROSS_CORRECTION_TABLE, pattern));
+				cross_corrected = true;
+				calls = 1;
+			}
+			else if (now - cross_encountered_time < 375 || sensors.left_part() || sensors.right_part())
+			{
+				command = go_straight(pattern, now, 0.25);
+			}
+			else
+			{
+				/* move_command finishes after a single stop_smoothly call */
+				command = primitive_command(MP_STOP_SMOOTHLY);
+				calls = 1;
+				done = true;
+			}
+
+			if (calls > 0 && command.primitive != MP_NONE)
+				wheels.command(command.primitive, command.left, command.right, calls, model);
+
+			model.step(dt);
+			t += dt;
+
+			double current_offset = model.get_x() - map.tile;
+			squared_offset += current_offset * current_offset;
+			++steps;
+
+			if (std::fabs(current_offset) > lost_offset)
+			{
+				result.lost = true;
+				break;
+			}
+		}
+
+		result.stop_error += std::fabs(model.get_y() - map.tile * (tile + 2));
+	}
+
+	result.tile_time = t / tiles;
+	result.rms_offset = std::sqrt(squared_offset / steps);
+	result.stop_error /= tiles;
+	return result;
+}
+
+/**
+ * Bang-bang steering by the GO_STRAIGHT decision table.
+ */
+inline steering table_steering()
+{
+	return [](uint8_t pattern, time_type, double)
+	{
+		return primitive_command(lookup_primitive(GO_STRAIGHT_TABLE, pattern));
+	};
+}
+
+/**
+ * PID steering of the line_controller, mirrors boe_bot::steer.
+ */
+inline steering pid_steering(const line_controller_gains& gains)
+{
+	auto controller = std::make_shared<line_controller>();
+	return [controller, gains](uint8_t pattern, time_type now, double speed)
+	{
+		double correction = controller->update(pattern, now, gains) / (double) LINE_CORRECTION_MAX;
+		wheel_command command;
+		command.primitive = STEERING_PRIMITIVE;
+		command.left = speed + correction;
+		command.right = speed - correction;
+		double excess = std::fmax(command.left, command.right) - 1.0;
+		if (excess > 0)
+		{
+			command.left -= excess;
+			command.right -= excess;
+		}
+		command.left = std::fmax(-1.0, command.left);
+		command.right = std::fmax(-1.0, command.right);
+		return command;
+	};
+}
+
+/**
+ * Summary of the runs of one steering.
+ */
+struct line_follow_summary
+{
+	double tile_time = 0;
+	double rms_offset = 0;
+	double stop_error = 0;
+	int finished = 0;
+	int lost = 0;
+
+	void add(const line_follow_result& result)
+	{
+		if (result.lost)
+		{
+			++lost;
+			return;
+		}
+		tile_time += result.tile_time;
+		rms_offset += result.rms_offset;
+		stop_error += result.stop_error;
+		++finished;
+	}
+
+	void print(const char* name) const
+	{
+		int count = std::max(1, finished);
+		std::cout << name << " tile " << tile_time / count << " s, rms offset " << rms_offset / count
+			<< " mm, stop error " << stop_error / count << " mm, lost " << lost << std::endl;
+	}
+};
+
+/**
+ * Compares average tile time of the decision table and the PID steering
+ * on randomized initial offsets, headings and wheel asymmetries.
+ *
+ * @return Number of runs where the PID steering lost the line.
+ */
+inline int test_line_follow(int runs = 100, int tiles = 10)
+{
+	line_controller_gains gains;
+	gains.kp = DEFAULT_KP;
+	gains.ki = DEFAULT_KI;
+	gains.kd = DEFAULT_KD;
+
+	std::mt19937 generator(2017);
+	std::uniform_real_distribution<double> offset(-8, 8);
+	std::uniform_real_distribution<double> heading(-0.1, 0.1);
+	std::uniform_real_distribution<double> asymmetry(0.95, 1.05);
+
+	line_follow_summary table, pid;
+
+	for (int i = 0; i < runs; ++i)
+	{
+		robot_geometry geometry;
+		geometry.left_gain = asymmetry(generator);
+		geometry.right_gain = asymmetry(generator);
+		double initial_offset = offset(generator);
+		double initial_heading = heading(generator);
+
+		table.add(run_line_follow(geometry, initial_offset, initial_heading, tiles, 0.25, table_steering));
+		pid.add(run_line_follow(geometry, initial_offset, initial_heading, tiles, DEFAULT_CRUISE_SPEED / 1000.0,
+		                        [&gains]() { return pid_steering(gains); }));
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "->=>-> Line following " << runs << " runs x " << tiles << " tiles" << std::endl;
+	table.print("table:");
+	pid.print("pid:  ");
+
+	return pid.lost;
+}
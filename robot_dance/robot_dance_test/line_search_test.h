@@ -0,0 +1,54 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "telemetry_decoder.h"
+#include <cstdio>
+
+/**
+ * Simulates a dance along the middle line of a narrow grid with the tape missing in the middle of every segment.
+ * The moves must get over the gaps, or find the line again by the search when the robot
+ * cannot see it behind the gap, without losing the count of the crosses.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_line_search()
+{
+	test_checks checks("Line search over the gaps");
+
+	/* Wheel gain and gap length in mm, the longer gap is not bridged at the line speed of the table steering
+	 * without the search */
+	const double variants[][2] = { { 1.0, 40 }, { 1.0, 80 }, { 0.95, 40 } };
+	for (const auto& variant : variants)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "gap %.0f mm with left wheel gain %.2f", variant[1], variant[0]);
+		dance_simulator_config config;
+		config.map = grid_map(3, 8);
+		config.map.gap = variant[1];
+		config.geometry.left_gain = variant[0];
+		config.capture_serial = true;
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run("B1N B1 T0 B8 T0 B1 T0 ");
+		simulator.drain_telemetry();
+
+		unsigned found = 0, searched = 0, dropped = 0;
+		for (const telemetry_event& event : parse_telemetry(simulator.get_machine().serial_output).events)
+		{
+			dropped += event.id == TELEMETRY_DROPPED ? 1 : 0;
+			if (event.id != TELEMETRY_LINE_FOUND)
+				continue;
+			++found;
+			searched += event.value(2, 1);
+		}
+
+		/* Every segment has a gap, the first and the last cross of each move have none in front of them */
+		checks.expect_on_course(result, config, name);
+		checks.expect(result.crosses.size() == 16, "%s reported %zu crosses instead of 16", name, result.crosses.size());
+		checks.expect(found == 14 && dropped == 0, "%s found the line %u times instead of 14, %u events dropped", name,
+			found, dropped);
+		/* The short gaps are bridged by the coast */
+		checks.expect((searched > 0) == (variant[1] > 60), "%s searched the line %u times", name, searched);
+	}
+
+	return checks.finish();
+}
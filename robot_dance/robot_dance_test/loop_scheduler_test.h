@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../loop_scheduler.h"
+#include <iostream>
+#include <random>
+
+/**
+ * Runs the scheduler on a virtual clock with random step durations and a few
+ * blocking Serial writes, checks the recorded periods and overruns.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_loop_scheduler(int ticks = 10000)
+{
+	const time_type period = DEFAULT_LOOP_PERIOD;
+	const int blocks = 7;
+	int failures = 0;
+
+	std::mt19937 generator(2029);
+	std::uniform_int_distribution<int> step_duration(20, period - 20);
+
+	loop_scheduler scheduler;
+	scheduler.set_period(period);
+
+	/* Start close to the overflow of micros() */
+	time_type now = 0xFFFFFFFFul - 50 * period;
+	scheduler.start(now);
+
+	int executed = 0;
+	uint32_t busy = 0;
+	while (executed < ticks)
+	{
+		if (!scheduler.is_due(now))
+		{
+			now += 4;
+			continue;
+		}
+
+		const int duration = step_duration(generator);
+		now += duration;
+		scheduler.end_step(now);
+		busy += duration;
+		if (++executed % (ticks / blocks) == 0)
+			now += 3 * period;
+	}
+
+	std::cout << "->=>-> Loop scheduler period " << period << " us, " << ticks << " ticks" << std::endl;
+	std::cout << "min " << scheduler.get_min_period() << " us, mean " << scheduler.get_mean_period()
+		<< " us, max " << scheduler.get_max_period() << " us, overruns " << scheduler.get_overruns() << std::endl;
+	std::cout << "busy mean " << scheduler.get_mean_busy() << " us, max " << scheduler.get_max_busy() << " us" << std::endl;
+
+	if (scheduler.get_count() != (uint32_t) ticks - 1)
+		++failures;
+	if (scheduler.get_overruns() != blocks)
+		++failures;
+	if (scheduler.get_min_period() < period - 4 || scheduler.get_max_period() < 3 * period)
+		++failures;
+	if (scheduler.get_mean_period() < period || scheduler.get_mean_period() > period + period / 10)
+		++failures;
+	if (scheduler.get_steps() != (uint32_t) ticks || scheduler.get_busy_time() != busy
+		|| scheduler.get_max_busy() > period - 20)
+		++failures;
+
+	return failures;
+}
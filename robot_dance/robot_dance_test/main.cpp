@@ -1,8 +1,33 @@
 #include "iostream"
 #include "planner_test.h"
+#include "planner_benchmark_test.h"
+#include "sensor_table_test.h"
+#include "line_follow_test.h"
+#include "edge_capture_test.h"
+#include "loop_scheduler_test.h"
+#include "firmware_test.h"
+#include "simulator_test.h"
+#include "monte_carlo_test.h"
+#include "autotuner_test.h"
+#include "batch_test.h"
+#include "trace_replay_test.h"
+#include "sensor_history_test.h"
+#include "regression_suite_test.h"
+#include "command_statistics_test.h"
+#include "telemetry_test.h"
+#include "tempo_report_test.h"
+#include "catch_up_test.h"
+#include "watchdog_test.h"
+#include "line_search_test.h"
+#include "cross_skew_test.h"
+#include "tile_odometry_test.h"
+#include "turn_prediction_test.h"
+#include "arc_corner_test.h"
+#include "pid_steering_test.h"
 #include <memory>
 #include <vector>
 #include <tuple>
+#include <string>
 
 using namespace std;
 
@@ -125,6 +150,55 @@ void test_planner_border_forward_back()
 
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && string(argv[1]) == "planner")
+		return test_planner_throughput(argc > 2 ? atol(argv[2]) : 2000000) == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "tables")
+		return test_sensor_tables() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "follow")
+		return test_line_follow() + test_pid_steering(argc > 2 ? argv[2] : "../dance1.txt") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "edges")
+		return test_edge_capture() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "scheduler")
+		return test_loop_scheduler() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "firmware")
+		return test_firmware() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "simulate")
+		return test_simulator(argc > 2 ? argv[2] : "../dance1.txt") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "montecarlo")
+		return test_monte_carlo(argc > 2 ? argv[2] : "../dance_choreo/dance.out",
+			argc > 3 ? atoi(argv[3]) : 200, argc > 4 ? atoi(argv[4]) : 0) == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "batch")
+		return test_batch() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "history")
+		return test_sensor_history(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "commands")
+		return test_command_statistics(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "telemetry")
+		return test_telemetry(argc > 2 ? argv[2] : "../dance_choreo/dance.out", argc > 3 ? argv[3] : "") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "tempo")
+		return test_tempo_report(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "watchdog")
+		return test_watchdog() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "linesearch")
+		return test_line_search() == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "skew")
+		return test_cross_skew(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "odometry")
+		return test_tile_odometry(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "turns")
+		return (argc > 2 ? test_turn_prediction(argv[2]) : test_turn_prediction()) == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "arcs")
+		return test_arc_corners(argc > 2 ? argv[2] : "../dance1.txt") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "catchup")
+		return test_catch_up(argc > 2 ? argv[2] : "../dance_choreo/dance.out") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "replay")
+		return test_replay(argc > 2 ? argv[2] : "../dance_choreo/dance.out", argc > 3 ? argv[3] : "") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "regression")
+		return test_regression(argc > 2 ? argv[2] : "regression.json", argc > 3 ? argv[3] : "") == 0 ? 0 : 1;
+	if (argc > 1 && string(argv[1]) == "autotune")
+		return test_autotuner(argc > 2 ? argv[2] : "calibration.eep",
+			argc > 3 ? atoi(argv[3]) : 8, argc > 4 ? atoi(argv[4]) : 0) == 0 ? 0 : 1;
+
 	test_planner_2moves();
 	test_planner_2moves_invert();
 	test_planner_go_first_0();
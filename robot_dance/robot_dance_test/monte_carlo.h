@@ -0,0 +1,214 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/**
+ * Spread of the randomized parameters of the Monte Carlo runs.
+ */
+struct monte_carlo_config
+{
+	/* Nominal robot and arena, the other fields vary around it */
+	dance_simulator_config base;
+
+	int runs = 200;
+	/* 0 means one thread per core */
+	unsigned threads = 0;
+	uint32_t seed = 1;
+
+	/* Standard deviation of the relative speed of each wheel */
+	double wheel_gain_sigma = 0.03;
+	/* Standard deviation of the servo knee in us */
+	double servo_knee_sigma = 5;
+	/* Range of the tape width in mm */
+	double min_line_width = 17;
+	double max_line_width = 21;
+	/* Highest probability of a wrong sensor reading in one step */
+	double max_sensor_noise = 0.00005;
+};
+
+/**
+ * Nearest-rank percentile of the sorted values.
+ */
+inline double percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0;
+	size_t rank = (size_t) std::ceil(fraction * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Timing of one waypoint over all runs which reached it.
+ */
+struct waypoint_statistics
+{
+	position target;
+	double deadline = 0;
+	int reached = 0;
+	int late = 0;
+	int unreached = 0;
+	double p50 = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double max = 0;
+};
+
+/**
+ * Summary of all runs.
+ */
+struct monte_carlo_report
+{
+	int runs = 0;
+	int finished = 0;
+	int lost = 0;
+	int crosses = 0;
+	/* Waypoints not reached in all runs, they are not late */
+	int unreached = 0;
+
+	/* Number of runs by the number of late arrivals, the last bucket holds all bigger counts */
+	std::vector<int> miss_histogram;
+	/* Lateness of the late arrivals in s */
+	std::vector<double> lateness;
+
+	std::vector<waypoint_statistics> waypoints;
+
+	double success_rate() const
+	{
+		return runs > 0 ? (double) finished / runs : 0;
+	}
+
+	double lost_cross_rate() const
+	{
+		return crosses > 0 ? (double) lost / crosses : 0;
+	}
+};
+
+/**
+ * Runs the dance many times with randomized sensor noise, servo asymmetry
+ * and line width on all cores and collects the robustness statistics.
+ */
+class monte_carlo_runner
+{
+	monte_carlo_config config;
+	size_t steals = 0;
+
+public:
+	static const size_t MISS_BUCKETS = 8;
+
+	explicit monte_carlo_runner(const monte_carlo_config& config)
+		: config(config)
+	{
+	}
+
+	/**
+	 * Draws the robot and arena of the given run, the same run always gets the same parameters.
+	 */
+	dance_simulator_config sample(int run) const
+	{
+		std::mt19937 random(config.seed * 7919u + (uint32_t) run);
+		std::normal_distribution<double> gain(1.0, config.wheel_gain_sigma);
+		std::normal_distribution<double> knee(config.base.geometry.servo_knee, config.servo_knee_sigma);
+		std::uniform_real_distribution<double> width(config.min_line_width, config.max_line_width);
+		std::uniform_real_distribution<double> noise(0, config.max_sensor_noise);
+
+		dance_simulator_config sampled = config.base;
+		sampled.geometry.left_gain = gain(random);
+		sampled.geometry.right_gain = gain(random);
+		sampled.geometry.servo_knee = std::max(10.0, knee(random));
+		sampled.map.line_width = width(random);
+		sampled.sensor_noise = noise(random);
+		sampled.seed = random();
+		return sampled;
+	}
+
+	/**
+	 * Runs all the simulations of the dance.
+	 */
+	std::vector<dance_result> run_all(const std::string& dance)
+	{
+		std::vector<dance_result> results(config.runs);
+		work_stealing_pool pool(config.threads);
+		for (int i = 0; i < config.runs; ++i)
+		{
+			pool.submit([this, i, &dance, &results]()
+			{
+				dance_simulator simulator(sample(i));
+				results[i] = simulator.run(dance);
+			});
+		}
+		pool.run();
+		steals = pool.get_steals();
+		return results;
+	}
+
+	size_t get_steals() const
+	{
+		return steals;
+	}
+
+	/**
+	 * Summarizes the results of run_all().
+	 */
+	static monte_carlo_report summarize(const std::vector<dance_result>& results)
+	{
+		monte_carlo_report report;
+		report.miss_histogram.assign(MISS_BUCKETS + 1, 0);
+		std::vector<std::vector<double>> arrivals;
+
+		for (const dance_result& result : results)
+		{
+			++report.runs;
+			report.finished += result.finished ? 1 : 0;
+			report.lost += result.lost ? 1 : 0;
+			report.crosses += (int) result.crosses.size();
+
+			if (report.waypoints.size() < result.waypoints.size())
+			{
+				report.waypoints.resize(result.waypoints.size());
+				arrivals.resize(result.waypoints.size());
+			}
+
+			size_t misses = 0;
+			for (size_t i = 0; i < result.waypoints.size(); ++i)
+			{
+				const waypoint_arrival& waypoint = result.waypoints[i];
+				waypoint_statistics& statistics = report.waypoints[i];
+				statistics.target = waypoint.target;
+				statistics.deadline = waypoint.deadline;
+				if (waypoint.is_reached())
+				{
+					++statistics.reached;
+					arrivals[i].push_back(waypoint.arrival);
+				}
+				else
+				{
+					++statistics.unreached;
+					++report.unreached;
+				}
+				if (waypoint.is_late())
+				{
+					++statistics.late;
+					++misses;
+					report.lateness.push_back(waypoint.arrival - waypoint.deadline);
+				}
+			}
+			++report.miss_histogram[std::min(misses, (size_t) MISS_BUCKETS)];
+		}
+
+		for (size_t i = 0; i < arrivals.size(); ++i)
+		{
+			std::sort(arrivals[i].begin(), arrivals[i].end());
+			waypoint_statistics& statistics = report.waypoints[i];
+			statistics.p50 = percentile(arrivals[i], 0.5);
+			statistics.p90 = percentile(arrivals[i], 0.9);
+			statistics.p99 = percentile(arrivals[i], 0.99);
+			statistics.max = arrivals[i].empty() ? 0 : arrivals[i].back();
+		}
+		std::sort(report.lateness.begin(), report.lateness.end());
+		return report;
+	}
+};
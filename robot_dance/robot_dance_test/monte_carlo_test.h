@@ -0,0 +1,64 @@
+#pragma once
+
+#include "file_io.h"
+#include "monte_carlo.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+/**
+ * Runs the dance of the file many times with randomized noise and calibration and prints the robustness report.
+ * The sensor glitches of the noisiest runs fake crosses, the robot is lost then, without them every run finishes.
+ * The rates of the finished runs and of the lost crosses are bounded, so that a less robust firmware fails.
+ *
+ * @return 0 if all runs were simulated and the rates are within their bounds.
+ */
+inline int test_monte_carlo(const std::string& path, int runs, unsigned threads)
+{
+	std::string dance;
+	if (!read_file(path, dance))
+		return 1;
+
+	monte_carlo_config config;
+	config.base.time_limit = 300;
+	config.runs = runs;
+	config.threads = threads;
+	monte_carlo_runner runner(config);
+
+	const auto started = std::chrono::steady_clock::now();
+	const std::vector<dance_result> results = runner.run_all(dance);
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	const monte_carlo_report report = monte_carlo_runner::summarize(results);
+
+	std::printf("%s: %d runs in %.2f s of wall time, %zu steals\n", path.c_str(), report.runs, wall, runner.get_steals());
+	std::printf("success rate %.1f %%, lost-cross rate %.3f %% (%d of %d crosses)\n",
+		100 * report.success_rate(), 100 * report.lost_cross_rate(), report.lost, report.crosses);
+
+	std::printf("late arrivals per run:");
+	for (size_t i = 0; i < report.miss_histogram.size(); ++i)
+		std::printf("  %zu%s: %d", i, i + 1 == report.miss_histogram.size() ? "+" : "", report.miss_histogram[i]);
+	std::printf("\n");
+	if (report.lateness.empty())
+		std::printf("no late arrivals, %d waypoints not reached\n", report.unreached);
+	else
+		std::printf("lateness of %zu late arrivals: p50 %.2f s, p90 %.2f s, p99 %.2f s, %d waypoints not reached\n",
+			report.lateness.size(), percentile(report.lateness, 0.5), percentile(report.lateness, 0.9),
+			percentile(report.lateness, 0.99), report.unreached);
+
+	std::printf("waypoint  deadline  reached  late  unreached    p50    p90    p99    max\n");
+	for (const waypoint_statistics& waypoint : report.waypoints)
+	{
+		std::printf("  %c%-5d %8.1f  %7d  %4d  %9d  %5.1f  %5.1f  %5.1f  %5.1f\n",
+			'A' + waypoint.target.get_x(), waypoint.target.get_y() + 1, waypoint.deadline,
+			waypoint.reached, waypoint.late, waypoint.unreached, waypoint.p50, waypoint.p90, waypoint.p99, waypoint.max);
+	}
+
+	/* 14.5 % of the runs finish and 1.9 % of the crosses are lost with the default spread */
+	const double min_success = 0.10;
+	const double max_lost_crosses = 0.025;
+	const bool ok = report.runs == runs && !report.waypoints.empty() && report.success_rate() >= min_success
+		&& report.lost_cross_rate() <= max_lost_crosses;
+	std::printf("success rate at least %.1f %%, lost-cross rate at most %.1f %%: %s\n", 100 * min_success,
+		100 * max_lost_crosses, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+
+/**
+ * Simulates the dance with the PID steering at the default loop period, with even and uneven wheels.
+ * The controller must keep the robot on course after the turns, which end off the line.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_pid_steering(const std::string& dance_path)
+{
+	test_checks checks("PID steering on " + dance_path);
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	const std::pair<const char*, double> wheels[] = { {"even wheels", 1.0}, {"slower left wheel", 0.97},
+		{"slower right wheel", -0.97} };
+	for (const auto& wheel : wheels)
+	{
+		dance_simulator_config config = calibrated_config(CALIBRATION_PID_STEERING);
+		if (wheel.second > 0)
+			config.geometry.left_gain = wheel.second;
+		else
+			config.geometry.right_gain = -wheel.second;
+		checks.expect(config.calibration.loop_period == DEFAULT_LOOP_PERIOD, "%s run at %u us", wheel.first,
+			config.calibration.loop_period);
+		dance_simulator simulator(config);
+		checks.expect_on_course(simulator.run(dance), config, wheel.first);
+	}
+
+	return checks.finish();
+}
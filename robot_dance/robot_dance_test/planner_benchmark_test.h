@@ -0,0 +1,65 @@
+#pragma once
+
+#include "planner_test.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+/**
+ * Drives random routes through the grid planner with the mock commands, checks that every route
+ * ends on its target and prints the throughput and the heap allocations per route.
+ *
+ * @return Number of routes which missed their target.
+ */
+inline int test_planner_throughput(long routes)
+{
+	const int size = 8;
+	std::mt19937 random(39);
+	std::uniform_int_distribution<int> coordinate(0, size - 1);
+	std::uniform_int_distribution<int> heading(0, 4);
+	static const direction headings[] = {North, East, South, West, NotSpecified};
+
+	context ctx(location(0, 0, North));
+	test_planner planner(&ctx);
+
+	long commands = 0;
+	int failures = 0;
+	size_t warm_allocations = 0;
+	const long warm_up = routes / 100;
+	const auto started = std::chrono::steady_clock::now();
+	for (long i = 0; i < routes; ++i)
+	{
+		if (i == warm_up)
+			warm_allocations = planner.get_arena().get_heap_allocations();
+
+		const location target(position(coordinate(random), coordinate(random)), headings[heading(random)]);
+		planner.prepare_route(ctx.get_location(), target, (random() & 1) != 0);
+
+		command* cmd;
+		while ((cmd = planner.get_next_command()) != nullptr)
+		{
+			while (!cmd->is_done())
+				cmd->update();
+			++commands;
+		}
+
+		const location reached = ctx.get_location();
+		if (!(reached.get_position() == target.get_position())
+			|| (target.get_direction() != NotSpecified && reached.get_direction() != target.get_direction()))
+			++failures;
+	}
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	const command_arena& arena = planner.get_arena();
+
+	std::printf("->=>-> Planner throughput: %ld routes on a %dx%d grid, %d missed the target\n", routes, size, size, failures);
+	std::printf("%.2f M routes/s, %.2f M commands/s, %.2f commands per route\n",
+		wall > 0 ? routes / wall * 1e-6 : 0, wall > 0 ? commands / wall * 1e-6 : 0, (double) commands / routes);
+	std::printf("heap allocations: %zu in total, %.6f per route after the first %ld routes\n",
+		arena.get_heap_allocations(), (double) (arena.get_heap_allocations() - warm_allocations) / (routes - warm_up),
+		warm_up);
+
+	/* The memory of the longest route is reused by all the others */
+	if (arena.get_created() != (size_t) commands || arena.get_heap_allocations() > 16)
+		++failures;
+	return failures;
+}
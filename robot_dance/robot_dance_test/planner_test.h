@@ -2,6 +2,7 @@
 
 #include "../planning.h"
 #include "../square_grid_planner.h"
+#include "command_arena.h"
 #include <ostream>
 
 class context
@@ -153,6 +154,8 @@ public:
 class test_planner : public square_grid_planner
 {
 	context* ctx;
+	/* Commands of the current route, the caller finishes them before it prepares the next one */
+	command_arena arena;
 
 protected:
 	command* get_move_forward_cmd(const location& final_location) override;
@@ -164,14 +167,27 @@ public:
 	{
 	}
 
+	bool prepare_route(const location& source, const location& target, bool moveFirstX) override;
+
+	const command_arena& get_arena() const
+	{
+		return arena;
+	}
+
 };
 
+inline bool test_planner::prepare_route(const location& source, const location& target, bool moveFirstX)
+{
+	arena.reset();
+	return square_grid_planner::prepare_route(source, target, moveFirstX);
+}
+
 inline command* test_planner::get_move_forward_cmd(const location& final_location)
 {
-	return new move_command_mocap(ctx, final_location);
+	return arena.create<move_command_mocap>(ctx, final_location);
 }
 
 inline command* test_planner::get_turn_cmd(bool left, const location& final_location)
 {
-	return new turn_command_mocap(left, ctx, final_location);
+	return arena.create<turn_command_mocap>(left, ctx, final_location);
 }
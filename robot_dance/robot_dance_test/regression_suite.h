@@ -0,0 +1,468 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Dance of the benchmark corpus.
+ */
+struct benchmark_case
+{
+	std::string name;
+	std::string dance;
+};
+
+/**
+ * Timing of one waypoint of a benchmarked dance.
+ */
+struct benchmark_waypoint
+{
+	std::string target;
+	double deadline = 0;
+	/* Negative if not reached */
+	double arrival = -1;
+};
+
+/**
+ * Measured performance of the firmware on one dance.
+ */
+struct benchmark_record
+{
+	std::string name;
+	bool finished = false;
+	bool lost = false;
+	int crosses = 0;
+
+	/* Time from the start to the end of the show in s */
+	double show_time = 0;
+	std::vector<benchmark_waypoint> waypoints;
+	int late = 0;
+	/* Waypoints not reached, e.g. given up by the watchdog, they are not late */
+	int unreached = 0;
+	/* Lateness of the reached waypoints in s, negative if all were early */
+	double max_lateness = 0;
+	double total_lateness = 0;
+
+	/* Control-loop iterations and the CPU time they took in the virtual costs of the HAL */
+	uint32_t loop_iterations = 0;
+	int overruns = 0;
+	double cpu_time = 0;
+	double mean_step = 0;
+	double max_step = 0;
+	double max_period = 0;
+
+	double mean_position_error = 0;
+	double max_position_error = 0;
+
+	/* Time of the host to simulate the dance, not compared */
+	double wall_time = 0;
+};
+
+/**
+ * Appends a time of 0, i.e. no waiting, to every waypoint without one, the parser needs a time after each location.
+ */
+inline std::string complete_times(const std::string& dance)
+{
+	std::istringstream tokens(dance);
+	std::vector<std::string> words;
+	std::string token;
+	while (tokens >> token)
+		words.push_back(token);
+
+	std::string completed;
+	for (size_t i = 0; i < words.size(); ++i)
+	{
+		completed += words[i];
+		const bool is_time = std::toupper(words[i][0]) == 'T';
+		const bool timed = i + 1 < words.size() && std::toupper(words[i + 1][0]) == 'T';
+		completed += i > 0 && !is_time && !timed ? " T0 " : " ";
+	}
+	return completed;
+}
+
+/**
+ * Formats the cross as the dance does, e.g. "B3".
+ */
+inline std::string cross_name(int x, int y)
+{
+	return std::string(1, (char) ('A' + x)) + std::to_string(y + 1);
+}
+
+/**
+ * Builds the stress dances of the 4x4 arena. The deadlines follow the Manhattan distance
+ * at the given time per tile, so the tight ones measure how late the robot gets.
+ */
+inline std::vector<benchmark_case> stress_dances()
+{
+	std::vector<benchmark_case> dances;
+	struct waypoint
+	{
+		int x;
+		int y;
+		bool first_x;
+	};
+	auto compose = [](const std::string& name, const std::string& initial, int x, int y,
+		const std::vector<waypoint>& waypoints, int tile_time)
+	{
+		benchmark_case stress;
+		stress.name = name;
+		stress.dance = initial + " ";
+		int time = 0;
+		for (const waypoint& next : waypoints)
+		{
+			time += (std::abs(next.x - x) + std::abs(next.y - y)) * tile_time;
+			x = next.x;
+			y = next.y;
+			const std::string cross = cross_name(x, y);
+			stress.dance += (next.first_x ? cross : cross.substr(1) + cross[0]) + " T" + std::to_string(time) + " ";
+		}
+		return stress;
+	};
+
+	/* Back and forth along the edge, every route starts by a U-turn */
+	std::vector<waypoint> uturns;
+	for (int i = 0; i < 12; ++i)
+		uturns.push_back({0, i % 2 == 0 ? 3 : 0, false});
+	dances.push_back(compose("stress_uturns", "A1N", 0, 0, uturns, 15));
+
+	/* All crosses tile by tile with a turn at every row end, too fast to keep up */
+	std::vector<waypoint> serpentine;
+	for (int y = 0; y < 4; ++y)
+		for (int i = 0; i < 4; ++i)
+			if (y > 0 || i > 0)
+				serpentine.push_back({y % 2 == 0 ? i : 3 - i, y, true});
+	dances.push_back(compose("stress_serpentine", "A1E", 0, 0, serpentine, 10));
+
+	/* Long routes with alternating order of the axes */
+	std::vector<waypoint> diagonals;
+	for (int i = 0; i < 10; ++i)
+		diagonals.push_back({i % 2 == 0 ? 3 : 0, (i / 2) % 2 == 0 ? 3 : 0, i % 3 != 0});
+	dances.push_back(compose("stress_diagonals", "A1E", 0, 0, diagonals, 15));
+
+	/* Random waypoints, the same ones in every build */
+	std::mt19937 random(38);
+	std::uniform_int_distribution<int> coordinate(0, 3);
+	std::vector<waypoint> scattered;
+	for (int i = 0; i < 40; ++i)
+		scattered.push_back({coordinate(random), coordinate(random), (random() & 1) != 0});
+	dances.push_back(compose("stress_random", "B2N", 1, 1, scattered, 20));
+
+	return dances;
+}
+
+/**
+ * Runs the dance by the firmware in the simulator with the default calibration and no noise,
+ * so that the same firmware always gives the same numbers.
+ */
+inline benchmark_record run_benchmark(const benchmark_case& benchmark)
+{
+	dance_simulator_config config;
+	config.time_limit = 900;
+	dance_simulator simulator(config);
+
+	const auto started = std::chrono::steady_clock::now();
+	const dance_result result = simulator.run(benchmark.dance);
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	benchmark_record record;
+	record.name = benchmark.name;
+	record.finished = result.finished;
+	record.lost = result.lost;
+	record.crosses = (int) result.crosses.size();
+	record.show_time = result.dance_time;
+	record.max_lateness = -INFINITY;
+	for (const waypoint_arrival& arrival : result.waypoints)
+	{
+		benchmark_waypoint waypoint;
+		waypoint.target = cross_name(arrival.target.get_x(), arrival.target.get_y());
+		waypoint.deadline = arrival.deadline;
+		waypoint.arrival = arrival.arrival;
+		record.waypoints.push_back(waypoint);
+
+		record.late += arrival.is_late() ? 1 : 0;
+		record.unreached += arrival.is_reached() ? 0 : 1;
+		if (arrival.is_reached())
+		{
+			const double lateness = arrival.arrival - arrival.deadline;
+			record.max_lateness = std::fmax(record.max_lateness, lateness);
+			record.total_lateness += std::fmax(0.0, lateness);
+		}
+	}
+	if (std::isinf(record.max_lateness))
+		record.max_lateness = 0;
+
+	/* The statistics of the firmware of this thread survive the end of the dance */
+	const loop_scheduler& scheduler = robot.get_scheduler();
+	record.loop_iterations = scheduler.get_count();
+	record.overruns = scheduler.get_overruns();
+	record.cpu_time = scheduler.get_busy_time() * 1e-6;
+	record.mean_step = scheduler.get_mean_busy();
+	record.max_step = scheduler.get_max_busy();
+	record.max_period = scheduler.get_max_period();
+
+	record.mean_position_error = result.mean_position_error;
+	record.max_position_error = result.max_position_error;
+	record.wall_time = wall;
+	return record;
+}
+
+/**
+ * Writes the records as JSON, one dance per object and the waypoints in an array.
+ */
+inline void write_benchmark_json(std::ostream& out, const std::vector<benchmark_record>& records)
+{
+	auto number = [](double value)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%.6g", value);
+		return std::string(text);
+	};
+
+	out << "{\n  \"dances\": [";
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const benchmark_record& record = records[i];
+		out << (i > 0 ? "," : "") << "\n    {\n";
+		out << "      \"name\": \"" << record.name << "\",\n";
+		out << "      \"finished\": " << (record.finished ? "true" : "false") << ",\n";
+		out << "      \"lost\": " << (record.lost ? "true" : "false") << ",\n";
+		out << "      \"crosses\": " << record.crosses << ",\n";
+		out << "      \"show_time\": " << number(record.show_time) << ",\n";
+		out << "      \"late\": " << record.late << ",\n";
+		out << "      \"unreached\": " << record.unreached << ",\n";
+		out << "      \"max_lateness\": " << number(record.max_lateness) << ",\n";
+		out << "      \"total_lateness\": " << number(record.total_lateness) << ",\n";
+		out << "      \"loop_iterations\": " << record.loop_iterations << ",\n";
+		out << "      \"overruns\": " << record.overruns << ",\n";
+		out << "      \"cpu_time\": " << number(record.cpu_time) << ",\n";
+		out << "      \"mean_step\": " << number(record.mean_step) << ",\n";
+		out << "      \"max_step\": " << number(record.max_step) << ",\n";
+		out << "      \"max_period\": " << number(record.max_period) << ",\n";
+		out << "      \"mean_position_error\": " << number(record.mean_position_error) << ",\n";
+		out << "      \"max_position_error\": " << number(record.max_position_error) << ",\n";
+		out << "      \"wall_time\": " << number(record.wall_time) << ",\n";
+		out << "      \"waypoints\": [";
+		for (size_t j = 0; j < record.waypoints.size(); ++j)
+		{
+			const benchmark_waypoint& waypoint = record.waypoints[j];
+			out << (j > 0 ? "," : "") << "\n        {\"target\": \"" << waypoint.target << "\", \"deadline\": "
+				<< number(waypoint.deadline) << ", \"arrival\": "
+				<< (waypoint.arrival >= 0 ? number(waypoint.arrival) : "null") << ", \"lateness\": "
+				<< (waypoint.arrival >= 0 ? number(waypoint.arrival - waypoint.deadline) : "null") << "}";
+		}
+		out << "\n      ]\n    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+/**
+ * Value of the JSON written by write_benchmark_json, enough of JSON to read the results back.
+ */
+struct json_value
+{
+	enum kind_type
+	{
+		NONE,
+		BOOLEAN,
+		NUMBER,
+		STRING,
+		ARRAY,
+		OBJECT
+	};
+
+	kind_type kind = NONE;
+	double number = 0;
+	std::string text;
+	std::vector<json_value> items;
+	std::map<std::string, json_value> members;
+
+	/**
+	 * Gets the member, a null value if there is none.
+	 */
+	const json_value& operator[](const std::string& name) const
+	{
+		static const json_value none;
+		const auto found = members.find(name);
+		return found != members.end() ? found->second : none;
+	}
+};
+
+/**
+ * Recursive descent parser of json_value.
+ */
+class json_reader
+{
+	const std::string& input;
+	size_t at = 0;
+
+	void skip_space()
+	{
+		while (at < input.size() && std::isspace((unsigned char) input[at]))
+			++at;
+	}
+
+	bool expect(char c)
+	{
+		skip_space();
+		if (at < input.size() && input[at] == c)
+		{
+			++at;
+			return true;
+		}
+		return false;
+	}
+
+	bool read_string(std::string& text)
+	{
+		if (!expect('"'))
+			return false;
+		while (at < input.size() && input[at] != '"')
+		{
+			if (input[at] == '\\' && at + 1 < input.size())
+				++at;
+			text += input[at++];
+		}
+		return expect('"');
+	}
+
+public:
+	explicit json_reader(const std::string& input)
+		: input(input)
+	{
+	}
+
+	bool read(json_value& value)
+	{
+		skip_space();
+		if (at >= input.size())
+			return false;
+
+		const char c = input[at];
+		if (c == '{')
+		{
+			value.kind = json_value::OBJECT;
+			++at;
+			if (expect('}'))
+				return true;
+			do
+			{
+				std::string name;
+				if (!read_string(name) || !expect(':') || !read(value.members[name]))
+					return false;
+			} while (expect(','));
+			return expect('}');
+		}
+		if (c == '[')
+		{
+			value.kind = json_value::ARRAY;
+			++at;
+			if (expect(']'))
+				return true;
+			do
+			{
+				value.items.emplace_back();
+				if (!read(value.items.back()))
+					return false;
+			} while (expect(','));
+			return expect(']');
+		}
+		if (c == '"')
+		{
+			value.kind = json_value::STRING;
+			return read_string(value.text);
+		}
+		if (input.compare(at, 4, "null") == 0)
+		{
+			at += 4;
+			return true;
+		}
+		if (input.compare(at, 4, "true") == 0 || input.compare(at, 5, "false") == 0)
+		{
+			value.kind = json_value::BOOLEAN;
+			value.number = c == 't' ? 1 : 0;
+			at += c == 't' ? 4 : 5;
+			return true;
+		}
+
+		char* end = nullptr;
+		value.kind = json_value::NUMBER;
+		value.number = std::strtod(input.c_str() + at, &end);
+		if (end == input.c_str() + at)
+			return false;
+		at = end - input.c_str();
+		return true;
+	}
+};
+
+/**
+ * Metric of the comparison with the limit of its growth, which is still not a regression.
+ */
+struct benchmark_metric
+{
+	const char* name;
+	double relative_limit;
+	double absolute_limit;
+};
+
+/**
+ * Compares the results with the baseline ones and prints the changes of every dance found in both.
+ *
+ * @return Number of regressions, i.e. metrics grown over their limits and dances which stopped finishing.
+ */
+inline int compare_benchmarks(const json_value& baseline, const json_value& current)
+{
+	static const benchmark_metric metrics[] = {
+		{"show_time", 0.01, 0.05},
+		{"late", 0, 0},
+		{"unreached", 0, 0},
+		{"max_lateness", 0, 0.1},
+		{"total_lateness", 0.02, 0.1},
+		{"loop_iterations", 0.01, 0},
+		{"cpu_time", 0.05, 0},
+		{"max_step", 0.1, 4},
+		{"max_position_error", 0.1, 1},
+	};
+
+	int regressions = 0;
+	for (const json_value& now : current["dances"].items)
+	{
+		const json_value* before = nullptr;
+		for (const json_value& candidate : baseline["dances"].items)
+			if (candidate["name"].text == now["name"].text)
+				before = &candidate;
+		if (before == nullptr)
+		{
+			std::printf("%s: not in the baseline\n", now["name"].text.c_str());
+			continue;
+		}
+
+		std::printf("%s:\n", now["name"].text.c_str());
+		if ((*before)["finished"].number > 0 && now["finished"].number == 0)
+		{
+			std::printf("  REGRESSION: the dance does not finish any more\n");
+			++regressions;
+		}
+		for (const benchmark_metric& metric : metrics)
+		{
+			const double old_value = (*before)[metric.name].number;
+			const double new_value = now[metric.name].number;
+			const double limit = std::fabs(old_value) * metric.relative_limit + metric.absolute_limit;
+			const bool regressed = new_value - old_value > limit + 1e-9;
+			regressions += regressed ? 1 : 0;
+			std::printf("  %-20s %12.4g -> %12.4g  (%+.2f %%)%s\n", metric.name, old_value, new_value,
+				old_value != 0 ? 100 * (new_value - old_value) / std::fabs(old_value) : 0.0,
+				regressed ? "  REGRESSION" : "");
+		}
+	}
+	return regressions;
+}
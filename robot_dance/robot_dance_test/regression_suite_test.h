@@ -0,0 +1,69 @@
+#pragma once
+
+#include "regression_suite.h"
+#include "file_io.h"
+#include <fstream>
+
+/**
+ * Runs the firmware on the dances of the repository and the stress dances, prints the performance
+ * of each and writes it as JSON. With a baseline written by an older build, the changes are compared.
+ *
+ * @return 0 if the dances of the repository finished and nothing regressed.
+ */
+inline int test_regression(const std::string& results_path, const std::string& baseline_path)
+{
+	static const char* const corpus[] = {"../dance.txt", "../dance1.txt", "../dance_choreo/dance.out"};
+
+	std::vector<benchmark_case> cases;
+	for (const char* path : corpus)
+	{
+		benchmark_case benchmark;
+		benchmark.name = path + 3;
+		if (!read_file(path, benchmark.dance))
+			return 1;
+		/* dance.txt lists only the waypoints, it is danced as fast as possible */
+		benchmark.dance = complete_times(benchmark.dance);
+		cases.push_back(benchmark);
+	}
+	const size_t repository_dances = cases.size();
+	for (const benchmark_case& stress : stress_dances())
+		cases.push_back(stress);
+
+	int failures = 0;
+	std::vector<benchmark_record> records;
+	std::printf("->=>-> Regression suite of %zu dances\n", cases.size());
+	std::printf("dance                      show [s]  late  unreached  max late [s]  iterations  cpu [s]  step [us]  max step  wall [s]\n");
+	for (size_t i = 0; i < cases.size(); ++i)
+	{
+		const benchmark_record record = run_benchmark(cases[i]);
+		std::printf("%-25s %9.2f  %4d  %9d  %12.2f  %10u  %7.3f  %9.1f  %8.0f  %8.3f%s\n", record.name.c_str(),
+			record.show_time, record.late, record.unreached, record.max_lateness, record.loop_iterations, record.cpu_time,
+			record.mean_step, record.max_step, record.wall_time,
+			record.finished ? "" : record.lost ? "  lost" : "  unfinished");
+		if (i < repository_dances && !record.finished)
+			++failures;
+		records.push_back(record);
+	}
+
+	std::ofstream results(results_path);
+	write_benchmark_json(results, records);
+	results.close();
+	std::printf("results written to %s\n", results_path.c_str());
+
+	if (!baseline_path.empty())
+	{
+		std::string baseline_text, current_text;
+		if (!read_file(baseline_path, baseline_text) || !read_file(results_path, current_text))
+			return 1;
+		json_value baseline, current;
+		if (!json_reader(baseline_text).read(baseline) || !json_reader(current_text).read(current))
+		{
+			std::printf("cannot parse the results\n");
+			return 1;
+		}
+		const int regressions = compare_benchmarks(baseline, current);
+		std::printf("%d regressions against %s\n", regressions, baseline_path.c_str());
+		failures += regressions;
+	}
+	return failures;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "file_io.h"
+#include "history_decoder.h"
+#include "trace_replay.h"
+#include <cstdio>
+#include <random>
+
+/**
+ * Checks the encoding, the forgetting of the oldest changes and the decoding of the sensor history.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_history_ring()
+{
+	int failures = 0;
+	sensor_history history;
+	std::mt19937 random(37);
+	/* Short, long and very long runs of the pattern */
+	std::uniform_int_distribution<int> short_run(0, 600);
+	std::uniform_int_distribution<int> long_run(0, 100000);
+
+	std::vector<history_change> recorded;
+	time_type time = 5000;
+	history.clear(0, time);
+	for (int i = 0; i < 1000; ++i)
+	{
+		time += (time_type) (i % 10 == 0 ? long_run(random) : short_run(random)) * 1000 + 123;
+		history_change change;
+		change.time = (long) (time / 1000);
+		change.pattern = (uint8_t) (i & 0x1F);
+		history.record(change.pattern, time);
+		recorded.push_back(change);
+	}
+
+	history_dump dump;
+	for (uint16_t i = 0; i < history.size(); ++i)
+		dump.bytes.push_back(history.get_byte(i));
+	dump.last_time = (long) history.get_last_time();
+	const std::vector<history_change> decoded = decode_history(dump);
+
+	if (decoded.empty() || decoded.size() > recorded.size() || history.size() > SENSOR_HISTORY_SIZE
+		|| history.size() + 5 < SENSOR_HISTORY_SIZE)
+		++failures;
+	const size_t skipped = recorded.size() - decoded.size();
+	for (size_t i = 0; i < decoded.size(); ++i)
+	{
+		if (decoded[i].pattern != recorded[skipped + i].pattern || decoded[i].time != recorded[skipped + i].time)
+		{
+			++failures;
+			break;
+		}
+	}
+
+	std::printf("history ring: %zu of %zu changes in %u bytes: %s\n", decoded.size(), recorded.size(),
+		(unsigned) history.size(), failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+/**
+ * Simulates the dance, prints the sensor history of the robot over its Serial line
+ * and compares the decoded timeline with the newest patterns of the trace.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_sensor_history(const std::string& dance_path)
+{
+	test_checks checks("Sensor history of " + dance_path);
+	checks.add(test_history_ring());
+
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	dance_simulator_config config = calibrated_config(CALIBRATION_TRACE);
+	config.capture_serial = true;
+	dance_simulator simulator(config);
+	simulator.run(dance);
+
+	/* The firmware sends the rest of the trace and then the history on a query while it waits for the button */
+	hal_machine* previous = hal_current();
+	hal_current() = &simulator.get_machine();
+	while (robot.get_trace().drain())
+		delay(1);
+	robot.get_sensors().print_history();
+	hal_current() = previous;
+
+	const std::string& output = simulator.get_machine().serial_output;
+	history_dump dump;
+	if (!checks.expect(parse_history_dump(output, dump), "no sensor history printed"))
+		return checks.finish();
+	const std::vector<history_change> decoded = decode_history(dump);
+
+	std::vector<trace_record> patterns;
+	for (const trace_record& record : parse_trace(output).records)
+		if (record.is_pattern())
+			patterns.push_back(record);
+
+	checks.expect(!decoded.empty() && decoded.size() <= patterns.size(), "%zu changes in the history, %zu in the trace",
+		decoded.size(), patterns.size());
+	/* Most changes of the dance take two bytes, the history covers the newest ones up to its capacity */
+	checks.expect(dump.bytes.size() + 5 >= SENSOR_HISTORY_SIZE && dump.bytes.size() < 2 * decoded.size(),
+		"%zu changes in %zu bytes", decoded.size(), dump.bytes.size());
+	const size_t skipped = patterns.size() - std::min(patterns.size(), decoded.size());
+	for (size_t i = 0; i < decoded.size() && skipped + i < patterns.size(); ++i)
+	{
+		const trace_record& record = patterns[skipped + i];
+		/* The trace takes its time a few us after the history */
+		if (!checks.expect(decoded[i].pattern == record.code && std::labs(decoded[i].time - (long) (record.time / 1000)) <= 1,
+			"history differs from the trace at change %zu", i))
+			break;
+	}
+
+	return checks.finish();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../sensor_patterns.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+/**
+ * Sensor predicates over a pattern, named as in the 'sensors' class.
+ */
+class pattern_sensors
+{
+	uint8_t pattern;
+
+public:
+	explicit pattern_sensors(uint8_t pattern)
+		: pattern(pattern)
+	{
+	}
+
+	bool first_left() const { return (pattern & PATTERN_FIRST_LEFT) != 0; }
+	bool second_left() const { return (pattern & PATTERN_SECOND_LEFT) != 0; }
+	bool middle() const { return (pattern & PATTERN_MIDDLE) != 0; }
+	bool second_right() const { return (pattern & PATTERN_SECOND_RIGHT) != 0; }
+	bool first_right() const { return (pattern & PATTERN_FIRST_RIGHT) != 0; }
+	bool left_part() const { return first_left() && second_left(); }
+	bool right_part() const { return first_right() && second_right(); }
+};
+
+/*
+ * Branching logic of the commands before the decision tables, kept as the reference.
+ * Each function returns the last primitive the branches would call.
+ */
+
+inline motion_primitive legacy_go_straight(const pattern_sensors& s)
+{
+	if (s.second_right())
+		return MP_SLIGHTLY_RIGHT;
+	if (s.second_left())
+		return MP_SLIGHTLY_LEFT;
+	/* half_forward called for the middle sensor first is done by move_command, it is not part of the table */
+	return MP_QUARTER_FORWARD;
+}
+
+inline motion_primitive legacy_cross_correction(const pattern_sensors& s)
+{
+	if (s.first_left() && !s.second_left())
+		return MP_IN_PLACE_LEFT;
+	else if (s.first_right() && !s.second_right())
+		return MP_IN_PLACE_RIGHT;
+	else if (s.left_part() || s.right_part())
+		return MP_HALF_FORWARD;
+	return MP_NONE;
+}
+
+inline motion_primitive legacy_turn(const pattern_sensors& s, bool left)
+{
+	if (left)
+		return s.second_left() ? MP_IN_PLACE_LEFT_HALF : MP_IN_PLACE_LEFT;
+	else
+		return s.second_right() ? MP_IN_PLACE_RIGHT_HALF : MP_IN_PLACE_RIGHT;
+}
+
+inline motion_primitive legacy_turn_aligned(const pattern_sensors& s)
+{
+	if (!s.second_left() && s.middle() && !s.first_right())
+		return MP_STOP;
+	return MP_NONE;
+}
+
+inline std::string pattern_to_string(uint8_t pattern)
+{
+	std::string str;
+	for (int i = 0; i < 5; ++i)
+		str += (pattern & (1 << i)) ? '#' : '.';
+	return str;
+}
+
+/**
+ * Prints one decision table next to the legacy branching logic and counts differences.
+ */
+template<typename Legacy>
+int diff_decision_table(const char* name, const uint8_t* table, Legacy legacy)
+{
+	int differences = 0;
+
+	std::cout << "->=>-> Table " << name << std::endl;
+	for (uint8_t pattern = 0; pattern < SENSOR_PATTERNS; ++pattern)
+	{
+		motion_primitive from_table = lookup_primitive(table, pattern);
+		motion_primitive from_branches = legacy(pattern_sensors(pattern));
+
+		std::cout << pattern_to_string(pattern) << "  " << std::setw(20) << std::left << get_primitive_name(from_table);
+		if (from_table != from_branches)
+		{
+			std::cout << " DIFF legacy: " << get_primitive_name(from_branches);
+			++differences;
+		}
+		std::cout << std::endl;
+	}
+
+	return differences;
+}
+
+/**
+ * Compares all decision tables against the branching logic for all sensor patterns.
+ *
+ * @return Number of patterns, where the tables differ.
+ */
+inline int test_sensor_tables()
+{
+	int differences = 0;
+
+	differences += diff_decision_table("GO_STRAIGHT", GO_STRAIGHT_TABLE, legacy_go_straight);
+	differences += diff_decision_table("CROSS_CORRECTION", CROSS_CORRECTION_TABLE, legacy_cross_correction);
+	differences += diff_decision_table("TURN_LEFT", TURN_LEFT_TABLE, [](const pattern_sensors& s) { return legacy_turn(s, true); });
+	differences += diff_decision_table("TURN_RIGHT", TURN_RIGHT_TABLE, [](const pattern_sensors& s) { return legacy_turn(s, false); });
+	differences += diff_decision_table("TURN_ALIGNED", TURN_ALIGNED_TABLE, legacy_turn_aligned);
+
+	std::cout << "Differences: " << differences << std::endl;
+	return differences;
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "../sensor_patterns.h"
+#include <cmath>
+
+/**
+ * Physical constants of the simulated Boe-Bot, lengths in mm, speeds in mm/s.
+ */
+struct robot_geometry
+{
+	double wheel_base = 105;
+	/* Distance of the sensor row in front of the wheel axle */
+	double sensor_lead = 45;
+	/* Distance between two neighbouring sensors */
+	double sensor_pitch = 16;
+	/* Wheel speed of the saturated servo */
+	double max_speed = 170;
+	/* Pulse difference from the neutral 1500us, which gives 63% of the maximal speed */
+	double servo_knee = 50;
+	/* Time constant of the servo speed changes in seconds */
+	double servo_lag = 0.05;
+	/* Relative speed error of each wheel */
+	double left_gain = 1.0;
+	double right_gain = 1.0;
+};
+
+/**
+ * Black line grid with crosses on the multiples of the tile size.
+ * Cross (0, 0) is at the origin, x grows to the East, y to the North.
+ */
+struct grid_map
+{
+	int columns = 4;
+	int rows = 4;
+	double tile = 200;
+	double line_width = 19;
+	/* Length of the lines beyond the outer crosses */
+	double overhang = 0;
+	/* Cross with the tape worn off, there is no line closer than worn_radius to it, none if the column is negative */
+	int worn_column = -1;
+	int worn_row = -1;
+	double worn_radius = 60;
+	/* Length of the missing tape in the middle of every line segment */
+	double gap = 0;
+
+	grid_map() = default;
+
+	grid_map(int columns, int rows)
+		: columns(columns), rows(rows)
+	{
+	}
+
+	/**
+	 * Checks if the given point lies on a black line.
+	 */
+	bool is_black(double x, double y) const
+	{
+		if (worn_column >= 0 && std::fabs(x - worn_column * tile) <= worn_radius
+			&& std::fabs(y - worn_row * tile) <= worn_radius)
+			return false;
+
+		const double half = line_width / 2;
+		const double max_x = (columns - 1) * tile;
+		const double max_y = (rows - 1) * tile;
+
+		double nearest_x = std::round(x / tile) * tile;
+		double nearest_y = std::round(y / tile) * tile;
+
+		bool on_vertical = std::fabs(x - nearest_x) <= half && nearest_x >= 0 && nearest_x <= max_x
+			&& y >= -half - overhang && y <= max_y + half + overhang && tile / 2 - std::fabs(y - nearest_y) >= gap / 2;
+		bool on_horizontal = std::fabs(y - nearest_y) <= half && nearest_y >= 0 && nearest_y <= max_y
+			&& x >= -half - overhang && x <= max_x + half + overhang && tile / 2 - std::fabs(x - nearest_x) >= gap / 2;
+
+		return on_vertical || on_horizontal;
+	}
+};
+
+/**
+ * Differential drive kinematics with first order servo dynamics.
+ * Heading is measured counterclockwise from the East.
+ */
+class diff_drive_model
+{
+	robot_geometry geometry;
+
+	double x = 0;
+	double y = 0;
+	double heading = 0;
+
+	double left_target = 0;
+	double right_target = 0;
+	double left_speed = 0;
+	double right_speed = 0;
+
+public:
+	explicit diff_drive_model(const robot_geometry& geometry)
+		: geometry(geometry)
+	{
+	}
+
+	void set_pose(double x_p, double y_p, double heading_p)
+	{
+		x = x_p;
+		y = y_p;
+		heading = heading_p;
+	}
+
+	/**
+	 * Sets commanded wheel speeds from interval [-1; 1].
+	 */
+	void set_wheel_speeds(double left, double right)
+	{
+		left_target = left;
+		right_target = right;
+	}
+
+	/**
+	 * Converts the wheel speed from interval [-1; 1] to mm/s, the continuous rotation
+	 * servo saturates far below the maximal pulse difference of 200us.
+	 */
+	double servo_speed(double speed) const
+	{
+		double pulse = speed * 200;
+		double magnitude = geometry.max_speed * (1 - std::exp(-std::fabs(pulse) / geometry.servo_knee));
+		return pulse < 0 ? -magnitude : magnitude;
+	}
+
+	/**
+	 * Integrates the motion for the given time step in seconds.
+	 */
+	void step(double dt)
+	{
+		double lag = geometry.servo_lag > 0 ? std::fmin(1.0, dt / geometry.servo_lag) : 1.0;
+		left_speed += (left_target - left_speed) * lag;
+		right_speed += (right_target - right_speed) * lag;
+
+		double vl = servo_speed(left_speed) * geometry.left_gain;
+		double vr = servo_speed(right_speed) * geometry.right_gain;
+		double v = (vl + vr) / 2;
+		double omega = (vr - vl) / geometry.wheel_base;
+
+		/* Exact integration along the arc (mid-point heading) */
+		double mid_heading = heading + omega * dt / 2;
+		x += v * std::cos(mid_heading) * dt;
+		y += v * std::sin(mid_heading) * dt;
+		heading += omega * dt;
+	}
+
+	/**
+	 * Gets position of the given sensor, index 0 is the most left one.
+	 */
+	void sensor_position(int index, double* sx, double* sy) const
+	{
+		double lateral = (index - 2) * geometry.sensor_pitch;
+		double c = std::cos(heading);
+		double s = std::sin(heading);
+		*sx = x + geometry.sensor_lead * c + lateral * s;
+		*sy = y + geometry.sensor_lead * s - lateral * c;
+	}
+
+	/**
+	 * Renders the sensor pattern over the map, see PATTERN_* bits.
+	 */
+	uint8_t read_pattern(const grid_map& map) const
+	{
+		uint8_t pattern = 0;
+		for (int i = 0; i < 5; ++i)
+		{
+			double sx, sy;
+			sensor_position(i, &sx, &sy);
+			if (map.is_black(sx, sy))
+				pattern |= 1 << i;
+		}
+		return pattern;
+	}
+
+	double get_x() const { return x; }
+	double get_y() const { return y; }
+	double get_heading() const { return heading; }
+	const robot_geometry& get_geometry() const { return geometry; }
+};
+
+/**
+ * Emulates the wheel speed smoothing of boe_bot::common_smoothing_procedure and wheel_control,
+ * which depends on the number of sequential calls of the same primitive.
+ */
+class wheel_smoothing
+{
+	int last_primitive = -1;
+	unsigned long calls = 0;
+	double previous_left = 0;
+	double previous_right = 0;
+	double current_left = 0;
+	double current_right = 0;
+
+public:
+	/**
+	 * Performs the given number of firmware calls of one primitive.
+	 *
+	 * @param primitive Identity of the primitive, any primitive change restarts the smoothing.
+	 */
+	void command(int primitive, double left, double right, int firmware_calls, diff_drive_model& model)
+	{
+		command(primitive, left, right, firmware_calls);
+		model.set_wheel_speeds(current_left, current_right);
+	}
+
+	/**
+	 * Performs the given number of firmware calls of one primitive, the speeds are read by the getters.
+	 */
+	void command(int primitive, double left, double right, int firmware_calls)
+	{
+		for (int i = 0; i < firmware_calls; ++i)
+		{
+			if (primitive == last_primitive)
+			{
+				++calls;
+			}
+			else
+			{
+				calls = 1;
+				last_primitive = primitive;
+				previous_left = current_left;
+				previous_right = current_right;
+			}
+
+			double step = (double) (calls / 4);
+			double ratio = std::fmin(1, (1. - 0.1) / (100 * 100) * step * step + 0.1);
+			current_left = (1 - ratio) * previous_left + ratio * left;
+			current_right = (1 - ratio) * previous_right + ratio * right;
+		}
+	}
+
+	double get_left() const { return current_left; }
+	double get_right() const { return current_right; }
+};
+
+/**
+ * Wheel speeds of the boe_bot primitives, as set in boe_bot.hpp.
+ */
+inline void primitive_wheel_speeds(motion_primitive primitive, double* left, double* right)
+{
+	switch (primitive)
+	{
+	case MP_STOP: case MP_STOP_SMOOTHLY: *left = 0; *right = 0; break;
+	case MP_FULL_FORWARD: *left = 1; *right = 1; break;
+	case MP_HALF_FORWARD: *left = 0.5; *right = 0.5; break;
+	case MP_QUARTER_FORWARD: *left = 0.25; *right = 0.25; break;
+	case MP_IN_PLACE_LEFT: *left = -1; *right = 1; break;
+	case MP_IN_PLACE_LEFT_HALF: *left = -0.25; *right = 0.25; break;
+	case MP_SLIGHTLY_LEFT: *left = 0; *right = 0.25; break;
+	case MP_SHARPLY_LEFT: *left = 0; *right = 1; break;
+	case MP_IN_PLACE_RIGHT: *left = 1; *right = -1; break;
+	case MP_IN_PLACE_RIGHT_HALF: *left = 0.25; *right = -0.25; break;
+	case MP_SLIGHTLY_RIGHT: *left = 0.25; *right = 0; break;
+	case MP_SHARPLY_RIGHT: *left = 1; *right = 0; break;
+	case MP_IN_PLACE_LEFT_SLOW: *left = -0.05; *right = 0.05; break;
+	case MP_IN_PLACE_RIGHT_SLOW: *left = 0.05; *right = -0.05; break;
+	default: break;
+	}
+}
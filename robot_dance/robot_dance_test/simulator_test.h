@@ -0,0 +1,48 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include <chrono>
+#include <iostream>
+
+/**
+ * Simulates the whole dance of the file and prints the position error at every cross.
+ *
+ * @return 0 if the dance finished without losing the line.
+ */
+inline int test_simulator(const std::string& path)
+{
+	std::string dance;
+	if (!read_file(path, dance))
+		return 1;
+
+	dance_simulator_config config;
+	dance_simulator simulator(config);
+
+	const auto started = std::chrono::steady_clock::now();
+	const dance_result result = simulator.run(dance);
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	const double virtual_time = simulator.get_machine().time * 1e-6;
+
+	for (const cross_error& error : result.crosses)
+	{
+		std::cout << error.time << " s  [" << (char) ('A' + error.reported.get_position().get_x())
+			<< error.reported.get_position().get_y() + 1 << "]"
+			<< "  position error " << error.position_error << " mm"
+			<< "  heading error " << error.heading_error * 180 / M_PI << " deg" << std::endl;
+	}
+
+	std::cout << path << ": " << result.crosses.size() << " crosses, dance time " << result.dance_time << " s"
+		<< ", mean position error " << result.mean_position_error << " mm"
+		<< ", max " << result.max_position_error << " mm"
+		<< ", max heading error " << result.max_heading_error * 180 / M_PI << " deg" << std::endl;
+	std::cout << "simulated " << virtual_time << " s in " << wall << " s of wall time ("
+		<< (wall > 0 ? virtual_time / wall : 0) << "x real time)" << std::endl;
+
+	if (!result.finished)
+	{
+		std::cout << (result.lost ? "robot lost the line" : "dance did not finish") << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "firmware_host.h"
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Event decoded from a telemetry frame, see TELEMETRY_* ids.
+ */
+struct telemetry_event
+{
+	uint8_t id = 0;
+	/* Time of the robot clock in ms */
+	uint32_t time = 0;
+	std::vector<uint8_t> payload;
+
+	uint32_t value(size_t offset, size_t size) const
+	{
+		uint32_t result = 0;
+		for (size_t i = 0; i < size && offset + i < payload.size(); ++i)
+			result |= (uint32_t) payload[offset + i] << (8 * i);
+		return result;
+	}
+
+	int8_t signed_byte(size_t offset) const
+	{
+		return offset < payload.size() ? (int8_t) payload[offset] : 0;
+	}
+};
+
+/**
+ * Serial output split to the telemetry events and the text between them.
+ */
+struct telemetry_stream
+{
+	std::vector<telemetry_event> events;
+	/* Text with every frame replaced by its description */
+	std::string text;
+	/* Zero bytes which did not open a valid frame */
+	int corrupted = 0;
+};
+
+/**
+ * Decodes the COBS encoded frame without its delimiters.
+ *
+ * @return If the encoding was valid.
+ */
+inline bool cobs_decode(const std::string& encoded, std::vector<uint8_t>& decoded)
+{
+	decoded.clear();
+	size_t i = 0;
+	while (i < encoded.size())
+	{
+		const uint8_t code = (uint8_t) encoded[i++];
+		if (code == 0 || i + code - 1 > encoded.size())
+			return false;
+		for (uint8_t j = 1; j < code; ++j)
+			decoded.push_back((uint8_t) encoded[i++]);
+		if (code < 0xFF && i < encoded.size())
+			decoded.push_back(0);
+	}
+	return true;
+}
+
+/**
+ * Gets length of the payload of the event.
+ *
+ * @return The length, -1 for an unknown event.
+ */
+inline int telemetry_payload_length(uint8_t id)
+{
+	switch (id)
+	{
+	case TELEMETRY_ROUTE_START: return 5;
+	case TELEMETRY_COMMAND_START: return 4;
+	case TELEMETRY_COMMAND_END: return 5;
+	case TELEMETRY_ARRIVAL: return 8;
+	case TELEMETRY_SENSORS: return 4;
+	case TELEMETRY_ROUTE_DONE: return 3;
+	case TELEMETRY_ROUTE_ERROR: return 2;
+	case TELEMETRY_INTERRUPTED: return 0;
+	case TELEMETRY_IDLE: return 10;
+	case TELEMETRY_ANOMALY: return 4;
+	case TELEMETRY_DROPPED: return 2;
+	case TELEMETRY_SKIPPED: return 4;
+	case TELEMETRY_LINE_FOUND: return 3;
+	default: return -1;
+	}
+}
+
+inline const char* command_kind_name(uint32_t kind)
+{
+	switch (kind)
+	{
+	case COMMAND_MOVE: return "move command";
+	case COMMAND_TURN_LEFT: return "turn command [left]";
+	case COMMAND_TURN_RIGHT: return "turn command [right]";
+	case COMMAND_RECOVERY: return "recovery command";
+	case COMMAND_ARC: return "arc command";
+	default: return "unknown command";
+	}
+}
+
+inline const char* direction_name(int8_t dir)
+{
+	switch (dir)
+	{
+	case North: return "North";
+	case East: return "East";
+	case South: return "South";
+	case West: return "West";
+	default: return "NotSpecified";
+	}
+}
+
+inline const char* anomaly_name(uint32_t code)
+{
+	switch (code)
+	{
+	case ANOMALY_TURN_SKIPPED: return "Turn command skipped due to lack of path";
+	case ANOMALY_MIDDLE_MISSED: return "Middle missed!";
+	case ANOMALY_TIMEOUT: return "Command timed out, recovering";
+	default: return "unknown anomaly";
+	}
+}
+
+inline std::string event_location(const telemetry_event& event, size_t offset)
+{
+	char text[48];
+	std::snprintf(text, sizeof(text), "{ %d, %d } %s", event.signed_byte(offset), event.signed_byte(offset + 1),
+		direction_name(event.signed_byte(offset + 2)));
+	return text;
+}
+
+/**
+ * Describes the event by the text the firmware printed before the telemetry.
+ */
+inline std::string describe_telemetry(const telemetry_event& event)
+{
+	char text[128];
+	switch (event.id)
+	{
+	case TELEMETRY_ROUTE_START:
+		std::snprintf(text, sizeof(text), "-> Creating route to { %d, %d } firstX=%s, time constraint=%u",
+			event.signed_byte(0), event.signed_byte(1), event.value(2, 1) ? "true" : "false", event.value(3, 2));
+		break;
+	case TELEMETRY_COMMAND_START:
+		std::snprintf(text, sizeof(text), "processing: %s to %s", command_kind_name(event.value(0, 1)),
+			event_location(event, 1).c_str());
+		break;
+	case TELEMETRY_COMMAND_END:
+		std::snprintf(text, sizeof(text), "done: %s in %u ms, %u updates", command_kind_name(event.value(0, 1)),
+			event.value(1, 2), event.value(3, 2));
+		break;
+	case TELEMETRY_ARRIVAL:
+		if (event.value(0, 4) == 0)
+			std::snprintf(text, sizeof(text), "arrived at %u without time constraint", event.value(4, 4));
+		else if (event.value(0, 4) > event.value(4, 4))
+			std::snprintf(text, sizeof(text), "waiting until %u beginning from %u", event.value(0, 4), event.value(4, 4));
+		else
+			std::snprintf(text, sizeof(text), "arrived at %u, %u ms after the time constraint %u", event.value(4, 4),
+				event.value(4, 4) - event.value(0, 4), event.value(0, 4));
+		break;
+	case TELEMETRY_SENSORS:
+	{
+		std::string pattern;
+		for (int i = 0; i < 5; ++i)
+			pattern += (event.value(0, 1) & (1 << i)) ? '#' : '.';
+		std::snprintf(text, sizeof(text), "sensors %s at %s", pattern.c_str(), event_location(event, 1).c_str());
+		break;
+	}
+	case TELEMETRY_IDLE:
+		std::snprintf(text, sizeof(text), "slack %u ms, background work %u us in %u steps, left %u us after the deadline",
+			event.value(0, 2), event.value(2, 4), event.value(6, 2), event.value(8, 2));
+		break;
+	case TELEMETRY_ROUTE_DONE:
+		std::snprintf(text, sizeof(text), "route done at %s, fetching next command...", event_location(event, 0).c_str());
+		break;
+	case TELEMETRY_ROUTE_ERROR:
+		std::snprintf(text, sizeof(text), "Error invalid arguments in prepare route to { %d, %d } -> Ignoring....",
+			event.signed_byte(0), event.signed_byte(1));
+		break;
+	case TELEMETRY_INTERRUPTED:
+		std::snprintf(text, sizeof(text), "button interrupted the execution");
+		break;
+	case TELEMETRY_ANOMALY:
+		std::snprintf(text, sizeof(text), "%s at %s", anomaly_name(event.value(0, 1)), event_location(event, 1).c_str());
+		break;
+	case TELEMETRY_DROPPED:
+		std::snprintf(text, sizeof(text), "telemetry dropped %u events", event.value(0, 2));
+		break;
+	case TELEMETRY_LINE_FOUND:
+		std::snprintf(text, sizeof(text), "line found after %u ms%s", event.value(0, 2),
+			event.value(2, 1) ? " of search" : "");
+		break;
+	case TELEMETRY_SKIPPED:
+		std::snprintf(text, sizeof(text), "-> Skipping overdue waypoint { %d, %d }, time constraint=%u",
+			event.signed_byte(0), event.signed_byte(1), event.value(2, 2));
+		break;
+	default:
+		std::snprintf(text, sizeof(text), "unknown event %u", event.id);
+		break;
+	}
+	return text;
+}
+
+/**
+ * Finds the telemetry frames in the Serial output, the other bytes are kept as the text.
+ */
+inline telemetry_stream parse_telemetry(const std::string& output)
+{
+	telemetry_stream stream;
+	size_t i = 0;
+	while (i < output.size())
+	{
+		const size_t open = output.find('\0', i);
+		stream.text += output.substr(i, open == std::string::npos ? std::string::npos : open - i);
+		if (open == std::string::npos)
+			break;
+		const size_t close = output.find('\0', open + 1);
+		if (close == std::string::npos)
+		{
+			++stream.corrupted;
+			break;
+		}
+
+		std::vector<uint8_t> frame;
+		uint8_t checksum = 0;
+		const bool decoded = cobs_decode(output.substr(open + 1, close - open - 1), frame);
+		for (uint8_t byte : frame)
+			checksum += byte;
+		if (!decoded || frame.size() < 6 || checksum != 0 || (int) frame.size() - 6 != telemetry_payload_length(frame[0]))
+		{
+			/* Zero bytes of the text, e.g. of an EEPROM dump, are no frames, the closing one may open the next frame */
+			++stream.corrupted;
+			stream.text += output.substr(open + 1, close - open - 1);
+			i = close;
+			continue;
+		}
+
+		telemetry_event event;
+		event.id = frame[0];
+		event.time = (uint32_t) frame[1] | (uint32_t) frame[2] << 8 | (uint32_t) frame[3] << 16 | (uint32_t) frame[4] << 24;
+		event.payload.assign(frame.begin() + 5, frame.end() - 1);
+		stream.events.push_back(event);
+		stream.text += describe_telemetry(event) + "\n";
+		i = close + 1;
+	}
+	return stream;
+}
+
+/**
+ * Writes the events as CSV, the columns not used by an event are empty.
+ */
+inline void write_telemetry_csv(std::ostream& out, const std::vector<telemetry_event>& events)
+{
+	out << "time_ms,event,kind,x,y,direction,pattern,duration_ms,updates,deadline_ms,constraint,first_x,arrival_ms\n";
+	for (const telemetry_event& event : events)
+	{
+		out << event.time << ",";
+		switch (event.id)
+		{
+		case TELEMETRY_ROUTE_START:
+			out << "route_start,," << (int) event.signed_byte(0) << "," << (int) event.signed_byte(1) << ",,,,,,"
+				<< event.value(3, 2) << "," << event.value(2, 1);
+			break;
+		case TELEMETRY_COMMAND_START:
+			out << "command_start," << command_kind_name(event.value(0, 1)) << "," << (int) event.signed_byte(1)
+				<< "," << (int) event.signed_byte(2) << "," << direction_name(event.signed_byte(3)) << ",,,,,,";
+			break;
+		case TELEMETRY_COMMAND_END:
+			out << "command_end," << command_kind_name(event.value(0, 1)) << ",,,,," << event.value(1, 2) << ","
+				<< event.value(3, 2) << ",,,";
+			break;
+		case TELEMETRY_ARRIVAL:
+			out << "arrival,,,,,,,," << event.value(0, 4) << ",,";
+			break;
+		case TELEMETRY_SENSORS:
+			out << "sensors,," << (int) event.signed_byte(1) << "," << (int) event.signed_byte(2) << ","
+				<< direction_name(event.signed_byte(3)) << "," << event.value(0, 1) << ",,,,,";
+			break;
+		case TELEMETRY_IDLE:
+			out << "idle,,,,,," << event.value(0, 2) << ",,,,";
+			break;
+		case TELEMETRY_ROUTE_DONE:
+			out << "route_done,," << (int) event.signed_byte(0) << "," << (int) event.signed_byte(1) << ","
+				<< direction_name(event.signed_byte(2)) << ",,,,,,";
+			break;
+		case TELEMETRY_ROUTE_ERROR:
+			out << "route_error,," << (int) event.signed_byte(0) << "," << (int) event.signed_byte(1) << ",,,,,,,";
+			break;
+		case TELEMETRY_INTERRUPTED:
+			out << "interrupted,,,,,,,,,,";
+			break;
+		case TELEMETRY_ANOMALY:
+			out << "anomaly," << anomaly_name(event.value(0, 1)) << "," << (int) event.signed_byte(1) << ","
+				<< (int) event.signed_byte(2) << "," << direction_name(event.signed_byte(3)) << ",,,,,,";
+			break;
+		case TELEMETRY_DROPPED:
+			/* The number of the lost events in the column of the kind */
+			out << "dropped," << event.value(0, 2) << ",,,,,,,,,";
+			break;
+		case TELEMETRY_LINE_FOUND:
+			/* Searched or not in the column of the kind */
+			out << "line_found," << event.value(2, 1) << ",,,,," << event.value(0, 2) << ",,,,";
+			break;
+		case TELEMETRY_SKIPPED:
+			out << "skipped,," << (int) event.signed_byte(0) << "," << (int) event.signed_byte(1) << ",,,,,,"
+				<< event.value(2, 2) << ",";
+			break;
+		default:
+			out << "unknown_" << (int) event.id << ",,,,,,,,,,";
+			break;
+		}
+		out << ",";
+		if (event.id == TELEMETRY_ARRIVAL)
+			out << event.value(4, 4);
+		out << "\n";
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include "telemetry_decoder.h"
+#include <cstdio>
+#include <fstream>
+
+/**
+ * Queues more events than the ring holds, drains them on a busy Serial line and checks
+ * that no write blocked and that the record of the loss accounts for every dropped event.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_telemetry_drops()
+{
+	const int pushed = 40;
+	hal_machine machine;
+	hal_machine* previous = hal_current();
+	hal_current() = &machine;
+	Serial.begin(115200);
+
+	telemetry stream;
+	const location loc(position(1, 2), direction::East);
+	for (int i = 0; i < pushed; ++i)
+		stream.command_start(millis(), COMMAND_MOVE, loc);
+	const uint16_t dropped = stream.get_dropped();
+
+	/* The line is busy, only whole frames may be sent */
+	Serial.print("0123456789012345678901234567890123456789012345678901234");
+	int calls = 0;
+	while (stream.drain() && ++calls < 1000)
+		delayMicroseconds(500);
+	hal_current() = previous;
+
+	const telemetry_stream decoded = parse_telemetry(machine.serial_output);
+	uint32_t kept = 0, lost = 0;
+	for (const telemetry_event& event : decoded.events)
+	{
+		kept += event.id == TELEMETRY_COMMAND_START ? 1 : 0;
+		lost += event.id == TELEMETRY_DROPPED ? event.value(0, 2) : 0;
+	}
+
+	int failures = 0;
+	if (dropped == 0 || lost != dropped || kept + lost != (uint32_t) pushed || decoded.corrupted != 0)
+		++failures;
+	if (machine.serial_stalls != 0)
+		++failures;
+	std::printf("telemetry ring: %u of %d events kept, %u dropped and reported, %u blocking writes: %s\n", kept, pushed,
+		lost, machine.serial_stalls, failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+/**
+ * Simulates the dance, decodes the binary telemetry of the Serial output and checks
+ * that every waypoint and command was reported. Writes the events as CSV if asked.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_telemetry(const std::string& dance_path, const std::string& csv_path)
+{
+	test_checks checks("Telemetry of " + dance_path);
+	checks.add(test_telemetry_drops());
+
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	dance_simulator_config config;
+	config.capture_serial = true;
+	dance_simulator simulator(config);
+	const dance_result result = simulator.run(dance);
+	const telemetry_stream stream = parse_telemetry(simulator.get_machine().serial_output);
+
+	size_t routes = 0, starts = 0, ends = 0, sensors = 0;
+	for (const telemetry_event& event : stream.events)
+	{
+		routes += event.id == TELEMETRY_ROUTE_START ? 1 : 0;
+		starts += event.id == TELEMETRY_COMMAND_START ? 1 : 0;
+		ends += event.id == TELEMETRY_COMMAND_END ? 1 : 0;
+		sensors += event.id == TELEMETRY_SENSORS ? 1 : 0;
+	}
+	uint32_t commands = 0;
+	for (uint8_t kind = 0; kind < COMMAND_KINDS; ++kind)
+		commands += robot.get_command_statistics().get_timing(kind).count;
+
+	checks.expect(robot.get_telemetry().get_dropped() == 0 && stream.corrupted == 0, "%u events dropped, %d zero bytes "
+		"in the text", robot.get_telemetry().get_dropped(), stream.corrupted);
+	checks.expect(routes == result.waypoints.size(), "%zu routes of %zu waypoints", routes, result.waypoints.size());
+	checks.expect(starts == commands && ends == commands && sensors == commands, "%zu command starts, %zu ends "
+		"and %zu sensor reports of %u commands", starts, ends, sensors, commands);
+
+	/* The control loop never waits for the Serial line */
+	const loop_scheduler& scheduler = robot.get_scheduler();
+	checks.expect(result.serial_stalls == 0 && scheduler.get_overruns() == 0, "%u blocking Serial writes, %lu overruns",
+		result.serial_stalls, (unsigned long) scheduler.get_overruns());
+
+	if (!csv_path.empty())
+	{
+		std::ofstream csv(csv_path);
+		write_telemetry_csv(csv, stream.events);
+		std::printf("events written to %s\n", csv_path.c_str());
+	}
+	return checks.finish();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include "telemetry_decoder.h"
+#include <cstdio>
+#include <cstring>
+#include <regex>
+
+/**
+ * Scales the 'T' time constraints of the dance, e.g. to make it faster than the robot can drive.
+ *
+ * @return The dance with the scaled time constraints.
+ */
+inline std::string scale_time_constraints(const std::string& dance, long numerator, long denominator)
+{
+	std::string scaled;
+	std::smatch match;
+	std::string rest = dance;
+	while (std::regex_search(rest, match, std::regex("T([0-9]+)")))
+	{
+		scaled += match.prefix().str() + "T" + std::to_string(std::stol(match[1].str()) * numerator / denominator);
+		rest = match.suffix().str();
+	}
+	return scaled + rest;
+}
+
+/**
+ * Checks the classification of the arrivals and the round trip of the report through the EEPROM.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_tempo_arrivals()
+{
+	int failures = 0;
+	hal_machine machine;
+	hal_machine* previous = hal_current();
+	hal_current() = &machine;
+
+	tempo_report report;
+	/* Unconstrained, early, on time on both sides, late and very late */
+	report.record(0, 1200);
+	report.record(3000, 2500);
+	report.record(6000, 5950);
+	report.record(9000, 9100);
+	report.record(12000, 12600);
+	report.record(15000, 85000);
+	const tempo_data& data = report.get_data();
+	if (data.waypoints != 6 || data.early != 1 || data.on_time != 2 || data.late != 2)
+		++failures;
+	if (data.max_lateness != 65535 || data.total_drift != -500 - 50 + 100 + 600 + 70000 || data.last_drift != 70000)
+		++failures;
+
+	report.store();
+	int steps = 0;
+	while (report.store_step() && ++steps < 1000)
+		delay(1);
+	tempo_report loaded;
+	if (!loaded.load() || std::memcmp(&loaded.get_data(), &data, sizeof(tempo_data)) != 0)
+		++failures;
+	hal_current() = previous;
+
+	std::printf("tempo arrivals: %u early, %u on time, %u late, stored in %u EEPROM writes: %s\n", data.early,
+		data.on_time, data.late, machine.eeprom_writes, failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+/**
+ * Simulates the dance, compares the tempo report of the robot with the arrivals in its telemetry
+ * and checks that the report is stored to the EEPROM after the show. The same dance in a faster
+ * tempo must be reported late.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_tempo_report(const std::string& dance_path)
+{
+	test_checks checks("Tempo of " + dance_path);
+	checks.add(test_tempo_arrivals());
+
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	/* The original tempo and the time constraints cut to a half */
+	const std::string hurried = scale_time_constraints(dance, 1, 2);
+	const char* names[] = { "original tempo", "double speed" };
+	uint16_t late[2] = {};
+	for (int variant = 0; variant < 2; ++variant)
+	{
+		dance_simulator_config config;
+		config.capture_serial = true;
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run(variant == 0 ? dance : hurried);
+
+		/* The firmware stores the report and sends the rest of the telemetry while it waits for the button */
+		hal_machine& machine = simulator.get_machine();
+		hal_machine* previous = hal_current();
+		hal_current() = &machine;
+		int steps = 0;
+		while ((robot.get_tempo().store_step() | robot.get_telemetry().drain()) && ++steps < 1000)
+			delay(1);
+		tempo_report stored;
+		const bool found = stored.load();
+		hal_current() = previous;
+
+		tempo_report recomputed;
+		for (const telemetry_event& event : parse_telemetry(machine.serial_output).events)
+			if (event.id == TELEMETRY_ARRIVAL)
+				recomputed.record(event.value(0, 4), event.value(4, 4));
+		const tempo_data& expected = recomputed.get_data();
+		const tempo_data& data = robot.get_tempo().get_data();
+
+		checks.expect(found && std::memcmp(&stored.get_data(), &data, sizeof(tempo_data)) == 0,
+			"the report of the %s is not stored", names[variant]);
+		checks.expect(std::memcmp(&expected, &data, sizeof(tempo_data)) == 0 && robot.get_telemetry().get_dropped() == 0,
+			"the report of the %s differs from the telemetry", names[variant]);
+		checks.expect(data.waypoints == result.waypoints.size(), "the report of the %s has %u of %zu waypoints",
+			names[variant], data.waypoints, result.waypoints.size());
+		late[variant] = data.late;
+	}
+
+	/* The robot keeps the original tempo but not the doubled one */
+	checks.expect(late[0] == 0 && late[1] > 0, "%u late arrivals in the original tempo, %u at double speed", late[0],
+		late[1]);
+	return checks.finish();
+}
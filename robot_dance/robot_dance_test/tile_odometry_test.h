@@ -0,0 +1,60 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+
+/**
+ * Checks the learning of the approaches by the tile odometry and simulates the dance without and with
+ * the predicted stop on the crosses. The predicted stops must finish the dance with faster moves
+ * and the robot still on the crosses.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_tile_odometry(const std::string& dance_path)
+{
+	test_checks checks("Tile odometry on " + dance_path);
+
+	tile_odometry odometry;
+	odometry.record(1000, 850);
+	checks.expect(!odometry.is_calibrated(850) && odometry.get_approach_time() == 1000, "the first approach is not taken");
+	odometry.record(1040, 850);
+	checks.expect(odometry.is_calibrated(850) && !odometry.is_calibrated(700) && odometry.get_approach_time() == 1010,
+		"two approaches do not calibrate the odometry");
+	/* A move with a line search is not learned */
+	odometry.record(1600, 850);
+	checks.expect(!odometry.is_expected(1600) && odometry.is_expected(1100) && odometry.get_approach_time() == 1010,
+		"an approach with a line search is learned");
+	odometry.record(800, 700);
+	checks.expect(!odometry.is_calibrated(850) && !odometry.is_calibrated(700) && odometry.get_approach_time() == 800,
+		"a new cruise speed is not relearned");
+
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	unsigned long centered_move = 0;
+	for (int predictive = 0; predictive < 2; ++predictive)
+	{
+		const char* variant = predictive ? "predicted stop" : "centered stop";
+		/* Only the PID steering drives at the given speed, its step writes the servos once and fits a shorter period */
+		dance_simulator_config config = calibrated_config(CALIBRATION_PID_STEERING
+			| (predictive ? CALIBRATION_PREDICTIVE_STOP : 0));
+		config.calibration.loop_period = 400;
+		dance_simulator simulator(config);
+		const dance_result result = simulator.run(dance);
+
+		const command_timing& moves = robot.get_command_statistics().get_timing(COMMAND_MOVE);
+		const unsigned long mean_move = moves.count > 0 ? moves.total_duration / moves.count : 0;
+		checks.expect_on_course(result, config, variant);
+		if (!predictive)
+		{
+			centered_move = mean_move;
+			continue;
+		}
+		checks.expect(robot.get_odometry().get_approach_time() > 0, "%s learned no approach", variant);
+		checks.expect(mean_move < centered_move, "%s takes %lu ms per move, the centered one %lu ms", variant,
+			mean_move, centered_move);
+	}
+
+	return checks.finish();
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "telemetry_decoder.h"
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <vector>
+
+/**
+ * One event of a trace with the absolute time, see TRACE_* codes of trace_recorder.
+ */
+struct trace_record
+{
+	uint64_t time = 0;
+	uint8_t code = 0;
+
+	bool is_pattern() const
+	{
+		return code < TRACE_PRIMITIVE;
+	}
+
+	bool is_primitive() const
+	{
+		return code >= TRACE_PRIMITIVE && code < TRACE_START;
+	}
+};
+
+/**
+ * Trace of the last dance found in a Serial log.
+ */
+struct trace_log
+{
+	/* Time of the start of the dance in us */
+	uint64_t start = 0;
+	std::vector<trace_record> records;
+	/* Number of events lost by the robot */
+	int dropped = 0;
+};
+
+/**
+ * Extracts the trace of the last dance from the Serial output, the other lines are skipped.
+ */
+inline trace_log parse_trace(const std::string& output)
+{
+	trace_log log;
+	/* The binary frames of the telemetry may contain line ends */
+	std::istringstream lines(parse_telemetry(output).text);
+	std::string line;
+	uint64_t time = 0;
+	while (std::getline(lines, line))
+	{
+		if (line.size() < 4 || line[0] != '~')
+			continue;
+		const uint8_t code = (uint8_t) std::strtoul(line.substr(1, 2).c_str(), nullptr, 16);
+		const uint64_t value = std::strtoull(line.c_str() + 3, nullptr, 16);
+		if (code == TRACE_START)
+		{
+			log = trace_log();
+			log.start = time = value;
+			continue;
+		}
+		if (code == TRACE_DROPPED)
+		{
+			log.dropped += (int) value;
+			continue;
+		}
+		time += value;
+		trace_record record;
+		record.time = time;
+		record.code = code;
+		log.records.push_back(record);
+	}
+	return log;
+}
+
+/**
+ * Runs the dance by the firmware with the sensor patterns of a recorded trace instead of the rendered
+ * ones, the robot model only follows the servos. Every pattern is applied shortly before the time
+ * it was read, aligned by the starts of the dances, so that the firmware reads the same patterns
+ * in the same control steps as long as it takes the same decisions. The replay ends shortly
+ * after the last recorded event, the recording may end anywhere, e.g. when the robot got lost.
+ */
+class trace_replayer : public dance_simulator
+{
+	/* Time before the recorded read when the pattern is applied, the five pins are read within it */
+	static const uint64_t LEAD = 30;
+
+	/* Time after the last recorded event to send the replayed events out */
+	static const uint64_t TAIL = 100000;
+
+	std::vector<trace_record> patterns;
+	uint64_t recorded_start;
+	uint64_t recorded_end;
+	uint64_t offset = 0;
+	bool aligned = false;
+	size_t next = 0;
+	uint8_t pattern = 0;
+
+protected:
+	uint8_t sense(uint64_t now) override
+	{
+		if (!aligned)
+		{
+			if (!robot.get_trace().is_started())
+				return 0;
+			offset = robot.get_trace().get_start_time() - recorded_start;
+			aligned = true;
+		}
+
+		if (now > recorded_end + offset + TAIL)
+			throw firmware_halt();
+		while (next < patterns.size() && patterns[next].time + offset <= now + LEAD)
+			pattern = patterns[next++].code;
+		sense_time = next < patterns.size() ? patterns[next].time + offset - LEAD : UINT64_MAX;
+		return pattern;
+	}
+
+public:
+	trace_replayer(const dance_simulator_config& config, const trace_log& recorded)
+		: dance_simulator(config), recorded_start(recorded.start),
+		recorded_end(recorded.records.empty() ? recorded.start : recorded.records.back().time)
+	{
+		for (const trace_record& record : recorded.records)
+			if (record.is_pattern())
+				patterns.push_back(record);
+	}
+};
+
+/**
+ * Agreement of the recorded and replayed decisions.
+ */
+struct trace_comparison
+{
+	size_t compared = 0;
+	/* Index of the first different event, the number of the compared events if none */
+	size_t first_difference = 0;
+	/* Largest difference of the event times relative to the starts in us */
+	int64_t max_time_difference = 0;
+
+	bool matches() const
+	{
+		return first_difference == compared;
+	}
+};
+
+/**
+ * Compares the recorded events with the replayed ones in order, the replay may go on after the recording.
+ */
+inline trace_comparison compare_traces(const trace_log& recorded, const trace_log& replayed)
+{
+	trace_comparison comparison;
+	comparison.compared = recorded.records.size();
+	comparison.first_difference = comparison.compared;
+	for (size_t i = 0; i < comparison.compared; ++i)
+	{
+		if (i >= replayed.records.size() || recorded.records[i].code != replayed.records[i].code)
+		{
+			comparison.first_difference = i;
+			break;
+		}
+		const int64_t difference = (int64_t) (replayed.records[i].time - replayed.start)
+			- (int64_t) (recorded.records[i].time - recorded.start);
+		comparison.max_time_difference = std::max(comparison.max_time_difference, std::abs(difference));
+	}
+	return comparison;
+}
+
+/**
+ * Describes the event for the reports.
+ */
+inline std::string describe_event(const trace_record& record, uint64_t start)
+{
+	std::ostringstream text;
+	text << (record.time - start) / 1000.0 << " ms ";
+	if (record.is_pattern())
+	{
+		text << "pattern ";
+		for (int i = 0; i < 5; ++i)
+			text << ((record.code & (1 << i)) ? '#' : '.');
+	}
+	else if (record.code == (TRACE_PRIMITIVE | TRACE_STEERING))
+		text << "steering";
+	else
+		text << "primitive " << (int) (record.code - TRACE_PRIMITIVE);
+	return text.str();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "file_io.h"
+#include "trace_replay.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+/**
+ * Replays the trace of the Serial log by the firmware and checks that it takes the same decisions.
+ * Without a log, the trace is recorded by the simulator of the dance with sensor glitches first.
+ *
+ * @return 0 if the replayed trace matches the recorded one.
+ */
+inline int test_replay(const std::string& dance_path, const std::string& log_path)
+{
+	std::string dance;
+	if (!read_file(dance_path, dance))
+		return 1;
+
+	dance_simulator_config config = calibrated_config(CALIBRATION_TRACE);
+	config.capture_serial = true;
+
+	trace_log recorded;
+	if (log_path.empty())
+	{
+		dance_simulator_config noisy = config;
+		noisy.sensor_noise = 0.00005;
+		dance_simulator simulator(noisy);
+		simulator.run(dance);
+		recorded = parse_trace(simulator.get_machine().serial_output);
+	}
+	else
+	{
+		std::string output;
+		if (!read_file(log_path, output))
+			return 1;
+		recorded = parse_trace(output);
+	}
+
+	config.stop_when_lost = false;
+	trace_replayer replayer(config, recorded);
+	const auto started = std::chrono::steady_clock::now();
+	replayer.run(dance);
+	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	const trace_log replayed = parse_trace(replayer.get_machine().serial_output);
+	const trace_comparison comparison = compare_traces(recorded, replayed);
+
+	size_t patterns = 0;
+	for (const trace_record& record : recorded.records)
+		patterns += record.is_pattern() ? 1 : 0;
+	const uint32_t steps = robot.get_scheduler().get_count();
+
+	std::printf("->=>-> Replay of %s: %zu events (%zu patterns, %zu primitives), %d lost\n",
+		log_path.empty() ? "the simulated trace" : log_path.c_str(), recorded.records.size(), patterns,
+		recorded.records.size() - patterns, recorded.dropped);
+	std::printf("replayed %u control steps in %.3f s of wall time (%.2f M steps/s)\n",
+		steps, wall, wall > 0 ? steps / wall * 1e-6 : 0);
+
+	if (!comparison.matches())
+	{
+		const size_t i = comparison.first_difference;
+		std::printf("decisions differ at event %zu of %zu\n", i, comparison.compared);
+		std::printf("  recorded: %s\n", i < recorded.records.size()
+			? describe_event(recorded.records[i], recorded.start).c_str() : "end");
+		std::printf("  replayed: %s\n", i < replayed.records.size()
+			? describe_event(replayed.records[i], replayed.start).c_str() : "end");
+		return 1;
+	}
+	std::printf("all events match, max time difference %lld us\n", (long long) comparison.max_time_difference);
+	return recorded.records.empty() || recorded.dropped > 0 ? 1 : 0;
+}
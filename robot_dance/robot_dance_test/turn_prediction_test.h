@@ -0,0 +1,104 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "file_io.h"
+#include <cmath>
+
+/**
+ * Simulator measuring the time after each turn, in which the following move aligns the robot to the line.
+ */
+class turn_alignment_simulator : public dance_simulator
+{
+	/* Heading error in rad, below which the robot is aligned */
+	static constexpr double ALIGNED = 0.03;
+
+	/* Longest measured alignment in us, the move may drive off the line meanwhile */
+	static const uint64_t LIMIT = 1000000;
+
+	unsigned finished = 0;
+	uint64_t turned = 0;
+	bool aligning = false;
+
+protected:
+	uint8_t sense(uint64_t now) override
+	{
+		const command_statistics& statistics = robot.get_command_statistics();
+		const unsigned count = statistics.get_timing(COMMAND_TURN_LEFT).count + statistics.get_timing(COMMAND_TURN_RIGHT).count;
+		if (count != finished)
+		{
+			finished = count;
+			turned = now;
+			aligning = true;
+		}
+
+		if (aligning && (std::fabs(std::remainder(model.get_heading(), M_PI / 2)) < ALIGNED || now - turned > LIMIT))
+		{
+			total += now - turned;
+			++turns;
+			aligning = false;
+		}
+		return dance_simulator::sense(now);
+	}
+
+public:
+	/* Sum of the alignments in us and the number of the turns */
+	uint64_t total = 0;
+	unsigned turns = 0;
+
+	explicit turn_alignment_simulator(const dance_simulator_config& config) : dance_simulator(config) {}
+};
+
+/**
+ * Simulates the dance without and with the stop of the turns predicted by their angular velocity.
+ * The predicted turns must finish the dance and shorten the turn together with the alignment after it.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_turn_prediction(const std::string& dance_path)
+{
+	test_checks checks("Turn prediction on " + dance_path);
+	std::string dance;
+	if (!checks.expect(read_file(dance_path, dance), "the dance cannot be read"))
+		return checks.finish();
+
+	unsigned table_turns = 0;
+	unsigned long table_turn = 0;
+	for (int predicted = 0; predicted < 2; ++predicted)
+	{
+		const char* variant = predicted ? "predicted turns" : "table turns";
+		const dance_simulator_config config = calibrated_config(predicted ? CALIBRATION_TURN_PREDICTION : 0);
+		turn_alignment_simulator simulator(config);
+		const dance_result result = simulator.run(dance);
+
+		const command_statistics& statistics = robot.get_command_statistics();
+		const command_timing& left = statistics.get_timing(COMMAND_TURN_LEFT);
+		const command_timing& right = statistics.get_timing(COMMAND_TURN_RIGHT);
+		const unsigned count = left.count + right.count;
+		const unsigned long mean_turn = count > 0 ? (left.total_duration + right.total_duration) / count : 0;
+		const unsigned long mean_align = simulator.turns > 0 ? (unsigned long) (simulator.total / simulator.turns / 1000) : 0;
+		checks.expect_on_course(result, config, variant);
+		if (!predicted)
+		{
+			table_turns = count;
+			table_turn = mean_turn + mean_align;
+			continue;
+		}
+		/* The prediction changes only the end of the turns, the route is the same */
+		checks.expect(count == table_turns, "%s are %u, the table ones %u", variant, count, table_turns);
+		checks.expect(mean_turn + mean_align < table_turn, "%s take %lu ms with the alignment, the table ones %lu ms",
+			variant, mean_turn + mean_align, table_turn);
+	}
+
+	return checks.finish();
+}
+
+/**
+ * Simulates the turn prediction on both dances. The robot stops off the crosses of ../dance1.txt, where the middle
+ * sensor finds the target line late, and must stay on course there too.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_turn_prediction()
+{
+	return test_turn_prediction("../dance_choreo/dance.out") + test_turn_prediction("../dance1.txt");
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "dance_simulator.h"
+#include "telemetry_decoder.h"
+#include <cstdio>
+
+/**
+ * Checks the time budgets derived from the duration histograms.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_command_budgets()
+{
+	int failures = 0;
+	command_statistics statistics;
+	if (statistics.get_budget(COMMAND_MOVE) != COMMAND_DEFAULT_BUDGET)
+		++failures;
+
+	/* Moves of 1.3 s fall to the bucket up to 2048 ms */
+	for (int i = 0; i < COMMAND_BUDGET_SAMPLES; ++i)
+		statistics.record(COMMAND_MOVE, 1300 + i, 1800);
+	const time_type measured = statistics.get_budget(COMMAND_MOVE);
+	if (measured != COMMAND_BUDGET_FACTOR * 2048 || statistics.get_budget(COMMAND_TURN_LEFT) != COMMAND_DEFAULT_BUDGET)
+		++failures;
+
+	/* The last bucket is bounded by the longest move */
+	statistics.record(COMMAND_MOVE, 9000, 12000);
+	if (statistics.get_budget(COMMAND_MOVE) != COMMAND_BUDGET_FACTOR * 9000)
+		++failures;
+
+	statistics.record_timeout(COMMAND_TURN_RIGHT);
+	if (statistics.get_timing(COMMAND_TURN_RIGHT).timeouts != 1 || statistics.get_timing(COMMAND_TURN_RIGHT).count != 0)
+		++failures;
+
+	std::printf("command budgets: default %u ms, measured moves %lu ms: %s\n", COMMAND_DEFAULT_BUDGET,
+		(unsigned long) measured, failures == 0 ? "ok" : "FAILED");
+	return failures;
+}
+
+/**
+ * Simulates a short dance on a grid with a worn off corner cross. The move to it never finds
+ * the cross and drives off the grid, the watchdog must abandon it, the robot must back up
+ * to the last cross and the show must go on from there.
+ *
+ * @return Number of failed checks.
+ */
+inline int test_watchdog()
+{
+	test_checks checks("Watchdog on a worn cross");
+	checks.add(test_command_budgets());
+
+	dance_simulator_config config;
+	config.map.worn_column = 0;
+	config.map.worn_row = 3;
+	config.capture_serial = true;
+	config.time_limit = 120;
+	dance_simulator simulator(config);
+	const dance_result result = simulator.run("A1N A1 T0 A2 T20 A3 T40 A4 T60 B4 T150 C2 T190 ");
+	simulator.drain_telemetry();
+
+	unsigned timeouts = 0;
+	for (const telemetry_event& event : parse_telemetry(simulator.get_machine().serial_output).events)
+		if (event.id == TELEMETRY_ANOMALY && event.value(0, 1) == ANOMALY_TIMEOUT)
+			++timeouts;
+
+	const command_statistics& statistics = robot.get_command_statistics();
+	const tempo_data& tempo = robot.get_tempo().get_data();
+	unsigned abandoned = 0;
+	for (uint8_t kind = 0; kind < COMMAND_KINDS; ++kind)
+		abandoned += statistics.get_timing(kind).timeouts;
+
+	/* The move to the worn cross is tried twice, the robot is back on the last cross after each attempt */
+	checks.expect_on_course(result, config, "the robot");
+	checks.expect(timeouts == abandoned, "%u timeouts reported of %u", timeouts, abandoned);
+	checks.expect(statistics.get_timing(COMMAND_MOVE).timeouts == 2, "%u moves abandoned instead of 2",
+		statistics.get_timing(COMMAND_MOVE).timeouts);
+	checks.expect(statistics.get_timing(COMMAND_RECOVERY).count == 2, "%u recoveries instead of 2",
+		statistics.get_timing(COMMAND_RECOVERY).count);
+	checks.expect(tempo.skipped == 1 && tempo.waypoints == 6, "%u of %u waypoints given up instead of 1 of 6",
+		tempo.skipped, tempo.waypoints);
+	checks.expect(robot.get_location().get_position() == position(2, 1), "the dance ends at { %d, %d } instead of C2",
+		robot.get_location().get_position().get_x(), robot.get_location().get_position().get_y());
+	return checks.finish();
+}
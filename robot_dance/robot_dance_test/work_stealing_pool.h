@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs a batch of independent tasks on all cores. Every worker takes the tasks
+ * from the back of its own queue and steals from the front of the other queues
+ * when it runs dry, so the long and the short simulations balance themselves.
+ */
+class work_stealing_pool
+{
+	struct worker_queue
+	{
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	size_t next_queue = 0;
+	std::atomic<size_t> steals;
+
+	bool pop_own(size_t index, std::function<void()>& task)
+	{
+		worker_queue& queue = *queues[index];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.tasks.empty())
+			return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(size_t thief, std::function<void()>& task)
+	{
+		for (size_t i = 1; i < queues.size(); ++i)
+		{
+			worker_queue& queue = *queues[(thief + i) % queues.size()];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				++steals;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work(size_t index)
+	{
+		std::function<void()> task;
+		/* No task is submitted while running, a worker finding all queues empty is done */
+		while (pop_own(index, task) || steal(index, task))
+			task();
+	}
+
+public:
+	/**
+	 * @param threads Number of the workers, 0 means one per core.
+	 */
+	explicit work_stealing_pool(unsigned threads = 0)
+		: steals(0)
+	{
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+		if (threads == 0)
+			threads = 1;
+		for (unsigned i = 0; i < threads; ++i)
+			queues.emplace_back(new worker_queue());
+	}
+
+	size_t get_thread_count() const
+	{
+		return queues.size();
+	}
+
+	size_t get_steals() const
+	{
+		return steals;
+	}
+
+	/**
+	 * Adds a task to the batch, the tasks are dealt round robin.
+	 */
+	void submit(std::function<void()> task)
+	{
+		queues[next_queue]->tasks.push_back(std::move(task));
+		next_queue = (next_queue + 1) % queues.size();
+	}
+
+	/**
+	 * Runs all submitted tasks and waits for them.
+	 */
+	void run()
+	{
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < queues.size(); ++i)
+			threads.emplace_back(&work_stealing_pool::work, this, i);
+		work(0);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+};
@@ -0,0 +1,198 @@
+#ifndef sensor_edges_h_
+#define sensor_edges_h_
+
+#include <stdint.h>
+
+#include "robot_dance.hpp"
+#include "sensor_patterns.h"
+
+/**
+ * Capacity of the edge ring, must be a power of two not greater than 128.
+ */
+#define SENSOR_EDGE_RING_SIZE   (16)
+
+/**
+ * Number of the sensors tracked by the edges.
+ */
+#define SENSOR_EDGE_SENSORS     (5)
+
+
+/**
+ * Sensor pattern captured at the moment of its change.
+ */
+struct sensor_edge {
+    /**
+     * Time of the change in us.
+     */
+    time_type time;
+
+    /**
+     * Pattern after the change, see PATTERN_* bits.
+     */
+    uint8_t pattern;
+};
+
+
+/**
+ * Lock-free ring of sensor edges with a single producer (the pin change interrupt)
+ * and a single consumer (the main loop). Each side writes only its own index,
+ * the producer publishes an edge by moving the head after the edge is written.
+ * Edges arriving to the full ring are dropped and counted.
+ */
+class sensor_edge_ring {
+
+    /**
+     * Stored edges.
+     */
+    volatile sensor_edge edges[SENSOR_EDGE_RING_SIZE];
+
+    /**
+     * Number of pushed edges modulo 256, written only by the producer.
+     */
+    volatile uint8_t head = 0;
+
+    /**
+     * Number of popped edges modulo 256, written only by the consumer.
+     */
+    volatile uint8_t tail = 0;
+
+    /**
+     * Number of dropped edges, saturates at 255.
+     */
+    volatile uint8_t dropped = 0;
+
+public:
+
+    /**
+     * Stores a new edge, may be called only by the producer.
+     *
+     * @param pattern Pattern after the change.
+     * @param time Time of the change in us.
+     * @return If the edge was stored, false if the ring was full.
+     */
+    bool push(uint8_t pattern, time_type time);
+
+    /**
+     * Takes the oldest edge, may be called only by the consumer.
+     *
+     * @param edge Taken edge.
+     * @return If there was any edge in the ring.
+     */
+    bool pop(sensor_edge *edge);
+
+    /**
+     * Checks if there is no edge in the ring.
+     *
+     * @return If there is no edge in the ring.
+     */
+    bool empty() const {
+        return head == tail;
+    }
+
+    /**
+     * Gets number of edges dropped because the ring was full.
+     *
+     * @return Number of dropped edges, saturated at 255.
+     */
+    uint8_t get_dropped() const {
+        return dropped;
+    }
+
+};
+
+
+/**
+ * Times when each sensor started reading black color, built from the sensor edges
+ * or from polled patterns.
+ */
+class sensor_entry_times {
+
+    /**
+     * Last processed pattern.
+     */
+    uint8_t pattern = 0;
+
+    /**
+     * Time of the last change from white to black of each sensor in us.
+     */
+    time_type entry_time[SENSOR_EDGE_SENSORS] = {0, 0, 0, 0, 0};
+
+public:
+
+    /**
+     * Processes a pattern valid since the given time.
+     *
+     * @param new_pattern Pattern after the change, see PATTERN_* bits.
+     * @param time Time of the change in us.
+     */
+    void process(uint8_t new_pattern, time_type time);
+
+    /**
+     * Gets last processed pattern.
+     *
+     * @return The last processed pattern.
+     */
+    uint8_t get_pattern() const {
+        return pattern;
+    }
+
+    /**
+     * Gets time when the given sensor started reading black color.
+     *
+     * @param index Index of the sensor, 0 is the most left one.
+     * @return The time in us.
+     */
+    time_type get_entry_time(uint8_t index) const {
+        return entry_time[index];
+    }
+
+};
+
+
+
+//class sensor_edge_ring
+
+inline bool sensor_edge_ring::push(uint8_t pattern, time_type time) {
+    const uint8_t current = head;
+    if ((uint8_t) (current - tail) >= SENSOR_EDGE_RING_SIZE) {
+        if (dropped < UINT8_MAX) {
+            dropped = dropped + 1;
+        }
+        return false;
+    }
+
+    volatile sensor_edge &edge = edges[current & (SENSOR_EDGE_RING_SIZE - 1)];
+    edge.time = time;
+    edge.pattern = pattern;
+    head = (uint8_t) (current + 1);
+    return true;
+}
+
+inline bool sensor_edge_ring::pop(sensor_edge *edge) {
+    const uint8_t current = tail;
+    if (current == head) {
+        return false;
+    }
+
+    const volatile sensor_edge &stored = edges[current & (SENSOR_EDGE_RING_SIZE - 1)];
+    edge->time = stored.time;
+    edge->pattern = stored.pattern;
+    tail = (uint8_t) (current + 1);
+    return true;
+}
+
+
+
+//class sensor_entry_times
+
+inline void sensor_entry_times::process(uint8_t new_pattern, time_type time) {
+    const uint8_t entered = new_pattern & (uint8_t) ~pattern;
+    for (uint8_t i = 0; i < SENSOR_EDGE_SENSORS; i++) {
+        if (entered & (1 << i)) {
+            entry_time[i] = time;
+        }
+    }
+    pattern = new_pattern;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef sensor_history_h_
+#define sensor_history_h_
+
+#include <stdint.h>
+
+#include "robot_dance.hpp"
+
+/**
+ * Capacity of the history in bytes, must be a power of two.
+ */
+#define SENSOR_HISTORY_SIZE     (256)
+
+#ifdef ENABLE_SENSOR_HISTORY
+
+/**
+ * Flight recorder of the sensor patterns, which keeps the newest changes in a byte ring
+ * and forgets the oldest ones. Each change is stored as the pattern and the time in ms
+ * since the previous change: the first byte holds the pattern in bits 0-4 and the two
+ * lowest bits of the time in bits 5-6, the remaining bits of the time follow in 7-bit
+ * groups from the lowest one. Bit 7 of a byte means that another byte of the change follows.
+ * A change within 4 ms takes one byte, within 0.5 s two bytes and within 65 s three bytes.
+ * The changes take about 2 bytes each, the 256 bytes hold about 128 of them, which is
+ * 17 to 22 s of a dance, not the whole show.
+ */
+class sensor_history {
+
+    /**
+     * Stored changes.
+     */
+    uint8_t bytes[SENSOR_HISTORY_SIZE];
+
+    /**
+     * Index of the first byte of the oldest change.
+     */
+    uint16_t start = 0;
+
+    /**
+     * Number of used bytes.
+     */
+    uint16_t used = 0;
+
+    /**
+     * Time of the newest change in ms.
+     */
+    time_type last_time = 0;
+
+    /**
+     * Defines if the history should be sent out at the next opportunity.
+     */
+    bool dump_pending = false;
+
+    /**
+     * Forgets the oldest change.
+     */
+    void forget_oldest();
+
+public:
+
+    /**
+     * Forgets all changes and records the pattern valid since the given time.
+     *
+     * @param pattern Current pattern, see PATTERN_* bits.
+     * @param time Current time in us.
+     */
+    void clear(uint8_t pattern, time_type time);
+
+    /**
+     * Records a change of the pattern.
+     *
+     * @param pattern Pattern after the change, see PATTERN_* bits.
+     * @param time Time of the change in us.
+     */
+    void record(uint8_t pattern, time_type time);
+
+    /**
+     * Gets number of the used bytes.
+     *
+     * @return The number of bytes.
+     */
+    uint16_t size() const {
+        return used;
+    }
+
+    /**
+     * Gets the byte of the history, the oldest one first.
+     *
+     * @param index Index of the byte from interval [0; size()).
+     * @return The byte.
+     */
+    uint8_t get_byte(uint16_t index) const {
+        return bytes[(start + index) & (SENSOR_HISTORY_SIZE - 1)];
+    }
+
+    /**
+     * Gets time of the newest change, the times of the others follow from it.
+     *
+     * @return The time in ms.
+     */
+    time_type get_last_time() const {
+        return last_time;
+    }
+
+    /**
+     * Asks for sending the history out, e.g. after an anomaly of a command.
+     */
+    void request_dump() {
+        dump_pending = true;
+    }
+
+    /**
+     * Checks if the history should be sent out.
+     *
+     * @return If the dump was requested.
+     */
+    bool is_dump_pending() const {
+        return dump_pending;
+    }
+
+    /**
+     * Marks the requested dump as done.
+     */
+    void clear_dump_request() {
+        dump_pending = false;
+    }
+
+};
+
+
+
+//class sensor_history
+
+inline void sensor_history::forget_oldest() {
+    uint16_t length = 0;
+    while (length < used && (get_byte(length++) & 0x80)) {
+    }
+    start = (uint16_t) ((start + length) & (SENSOR_HISTORY_SIZE - 1));
+    used = (uint16_t) (used - length);
+}
+
+inline void sensor_history::clear(uint8_t pattern, time_type time) {
+    start = 0;
+    used = 0;
+    last_time = time / 1000;
+    record(pattern, time);
+}
+
+inline void sensor_history::record(uint8_t pattern, time_type time) {
+    /* Edges captured before the clear count as simultaneous with it */
+    const time_type now = time / 1000;
+    time_type delta = 0;
+    if ((long) (now - last_time) > 0) {
+        delta = now - last_time;
+        last_time = now;
+    }
+
+    uint8_t change[6];
+    uint8_t length = 0;
+    change[length++] = (uint8_t) ((pattern & 0x1F) | ((delta & 0x03) << 5));
+    delta >>= 2;
+    while (delta != 0) {
+        change[length - 1] |= 0x80;
+        change[length++] = (uint8_t) (delta & 0x7F);
+        delta >>= 7;
+    }
+
+    while (used + length > SENSOR_HISTORY_SIZE) {
+        forget_oldest();
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        bytes[(start + used++) & (SENSOR_HISTORY_SIZE - 1)] = change[i];
+    }
+}
+
+#else
+
+/**
+ * History left out of the build, see ENABLE_SENSOR_HISTORY. It stays empty and no dump is ever requested.
+ */
+class sensor_history {
+public:
+
+    void clear(uint8_t, time_type) {}
+
+    void record(uint8_t, time_type) {}
+
+    uint16_t size() const {
+        return 0;
+    }
+
+    uint8_t get_byte(uint16_t) const {
+        return 0;
+    }
+
+    time_type get_last_time() const {
+        return 0;
+    }
+
+    void request_dump() {}
+
+    bool is_dump_pending() const {
+        return false;
+    }
+
+    void clear_dump_request() {}
+
+};
+
+#endif
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef sensor_patterns_h_
+#define sensor_patterns_h_
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#endif
+
+/**
+ * Number of all possible readings of the five IR sensors.
+ */
+#define SENSOR_PATTERNS     (32)
+
+/**
+ * Bits of the sensor pattern, set bit means the sensor is reading black color.
+ */
+#define PATTERN_FIRST_LEFT      (1 << 0)
+#define PATTERN_SECOND_LEFT     (1 << 1)
+#define PATTERN_MIDDLE          (1 << 2)
+#define PATTERN_SECOND_RIGHT    (1 << 3)
+#define PATTERN_FIRST_RIGHT     (1 << 4)
+#define PATTERN_INNER           (PATTERN_SECOND_LEFT | PATTERN_MIDDLE | PATTERN_SECOND_RIGHT)
+
+
+/**
+ * Identifiers of the wheel control primitives of the robot.
+ * Dispatched by boe_bot::apply.
+ */
+enum motion_primitive {
+    /**
+     * Keeps the previous wheel control.
+     */
+    MP_NONE,
+    MP_STOP,
+    MP_STOP_SMOOTHLY,
+    MP_FULL_FORWARD,
+    MP_HALF_FORWARD,
+    MP_QUARTER_FORWARD,
+    MP_IN_PLACE_LEFT,
+    MP_IN_PLACE_LEFT_HALF,
+    MP_SLIGHTLY_LEFT,
+    MP_SHARPLY_LEFT,
+    MP_IN_PLACE_RIGHT,
+    MP_IN_PLACE_RIGHT_HALF,
+    MP_SLIGHTLY_RIGHT,
+    MP_SHARPLY_RIGHT,
+    MP_IN_PLACE_LEFT_SLOW,
+    MP_IN_PLACE_RIGHT_SLOW,
+    MP_COUNT
+};
+
+
+/*
+ * Decision tables of the command phases indexed by the sensor pattern.
+ * Comments show the sensors from the most left one, '#' means black color.
+ */
+
+/**
+ * Line following between two crosses (move_command::go_straight).
+ * The line under the middle sensor or between the sensors is followed with quarter speed.
+ * The half speed set for the middle sensor before the primitive is not part of the table, see move_command::follow_line.
+ */
+const uint8_t GO_STRAIGHT_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_QUARTER_FORWARD,
+        /* #.... */ MP_QUARTER_FORWARD,
+        /* .#... */ MP_SLIGHTLY_LEFT,
+        /* ##... */ MP_SLIGHTLY_LEFT,
+        /* ..#.. */ MP_QUARTER_FORWARD,
+        /* #.#.. */ MP_QUARTER_FORWARD,
+        /* .##.. */ MP_SLIGHTLY_LEFT,
+        /* ###.. */ MP_SLIGHTLY_LEFT,
+        /* ...#. */ MP_SLIGHTLY_RIGHT,
+        /* #..#. */ MP_SLIGHTLY_RIGHT,
+        /* .#.#. */ MP_SLIGHTLY_RIGHT,
+        /* ##.#. */ MP_SLIGHTLY_RIGHT,
+        /* ..##. */ MP_SLIGHTLY_RIGHT,
+        /* #.##. */ MP_SLIGHTLY_RIGHT,
+        /* .###. */ MP_SLIGHTLY_RIGHT,
+        /* ####. */ MP_SLIGHTLY_RIGHT,
+        /* ....# */ MP_QUARTER_FORWARD,
+        /* #...# */ MP_QUARTER_FORWARD,
+        /* .#..# */ MP_SLIGHTLY_LEFT,
+        /* ##..# */ MP_SLIGHTLY_LEFT,
+        /* ..#.# */ MP_QUARTER_FORWARD,
+        /* #.#.# */ MP_QUARTER_FORWARD,
+        /* .##.# */ MP_SLIGHTLY_LEFT,
+        /* ###.# */ MP_SLIGHTLY_LEFT,
+        /* ...## */ MP_SLIGHTLY_RIGHT,
+        /* #..## */ MP_SLIGHTLY_RIGHT,
+        /* .#.## */ MP_SLIGHTLY_RIGHT,
+        /* ##.## */ MP_SLIGHTLY_RIGHT,
+        /* ..### */ MP_SLIGHTLY_RIGHT,
+        /* #.### */ MP_SLIGHTLY_RIGHT,
+        /* .#### */ MP_SLIGHTLY_RIGHT,
+        /* ##### */ MP_SLIGHTLY_RIGHT
+};
+
+/**
+ * Single correction right after the cross was encountered (move_command::do_sensors_correction_on_cross).
+ * Rotates towards the outer sensor, which reached the cross first.
+ */
+const uint8_t CROSS_CORRECTION_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_NONE,
+        /* #.... */ MP_IN_PLACE_LEFT,
+        /* .#... */ MP_NONE,
+        /* ##... */ MP_HALF_FORWARD,
+        /* ..#.. */ MP_NONE,
+        /* #.#.. */ MP_IN_PLACE_LEFT,
+        /* .##.. */ MP_NONE,
+        /* ###.. */ MP_HALF_FORWARD,
+        /* ...#. */ MP_NONE,
+        /* #..#. */ MP_IN_PLACE_LEFT,
+        /* .#.#. */ MP_NONE,
+        /* ##.#. */ MP_HALF_FORWARD,
+        /* ..##. */ MP_NONE,
+        /* #.##. */ MP_IN_PLACE_LEFT,
+        /* .###. */ MP_NONE,
+        /* ####. */ MP_HALF_FORWARD,
+        /* ....# */ MP_IN_PLACE_RIGHT,
+        /* #...# */ MP_IN_PLACE_LEFT,
+        /* .#..# */ MP_IN_PLACE_RIGHT,
+        /* ##..# */ MP_IN_PLACE_RIGHT,
+        /* ..#.# */ MP_IN_PLACE_RIGHT,
+        /* #.#.# */ MP_IN_PLACE_LEFT,
+        /* .##.# */ MP_IN_PLACE_RIGHT,
+        /* ###.# */ MP_IN_PLACE_RIGHT,
+        /* ...## */ MP_HALF_FORWARD,
+        /* #..## */ MP_IN_PLACE_LEFT,
+        /* .#.## */ MP_HALF_FORWARD,
+        /* ##.## */ MP_HALF_FORWARD,
+        /* ..### */ MP_HALF_FORWARD,
+        /* #.### */ MP_IN_PLACE_LEFT,
+        /* .#### */ MP_HALF_FORWARD,
+        /* ##### */ MP_HALF_FORWARD
+};
+
+/**
+ * Rotation to the left (turn_command::update), slows down when the target line is approaching.
+ */
+const uint8_t TURN_LEFT_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_IN_PLACE_LEFT,
+        /* #.... */ MP_IN_PLACE_LEFT,
+        /* .#... */ MP_IN_PLACE_LEFT_HALF,
+        /* ##... */ MP_IN_PLACE_LEFT_HALF,
+        /* ..#.. */ MP_IN_PLACE_LEFT,
+        /* #.#.. */ MP_IN_PLACE_LEFT,
+        /* .##.. */ MP_IN_PLACE_LEFT_HALF,
+        /* ###.. */ MP_IN_PLACE_LEFT_HALF,
+        /* ...#. */ MP_IN_PLACE_LEFT,
+        /* #..#. */ MP_IN_PLACE_LEFT,
+        /* .#.#. */ MP_IN_PLACE_LEFT_HALF,
+        /* ##.#. */ MP_IN_PLACE_LEFT_HALF,
+        /* ..##. */ MP_IN_PLACE_LEFT,
+        /* #.##. */ MP_IN_PLACE_LEFT,
+        /* .###. */ MP_IN_PLACE_LEFT_HALF,
+        /* ####. */ MP_IN_PLACE_LEFT_HALF,
+        /* ....# */ MP_IN_PLACE_LEFT,
+        /* #...# */ MP_IN_PLACE_LEFT,
+        /* .#..# */ MP_IN_PLACE_LEFT_HALF,
+        /* ##..# */ MP_IN_PLACE_LEFT_HALF,
+        /* ..#.# */ MP_IN_PLACE_LEFT,
+        /* #.#.# */ MP_IN_PLACE_LEFT,
+        /* .##.# */ MP_IN_PLACE_LEFT_HALF,
+        /* ###.# */ MP_IN_PLACE_LEFT_HALF,
+        /* ...## */ MP_IN_PLACE_LEFT,
+        /* #..## */ MP_IN_PLACE_LEFT,
+        /* .#.## */ MP_IN_PLACE_LEFT_HALF,
+        /* ##.## */ MP_IN_PLACE_LEFT_HALF,
+        /* ..### */ MP_IN_PLACE_LEFT,
+        /* #.### */ MP_IN_PLACE_LEFT,
+        /* .#### */ MP_IN_PLACE_LEFT_HALF,
+        /* ##### */ MP_IN_PLACE_LEFT_HALF
+};
+
+/**
+ * Rotation to the right (turn_command::update), slows down when the target line is approaching.
+ */
+const uint8_t TURN_RIGHT_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_IN_PLACE_RIGHT,
+        /* #.... */ MP_IN_PLACE_RIGHT,
+        /* .#... */ MP_IN_PLACE_RIGHT,
+        /* ##... */ MP_IN_PLACE_RIGHT,
+        /* ..#.. */ MP_IN_PLACE_RIGHT,
+        /* #.#.. */ MP_IN_PLACE_RIGHT,
+        /* .##.. */ MP_IN_PLACE_RIGHT,
+        /* ###.. */ MP_IN_PLACE_RIGHT,
+        /* ...#. */ MP_IN_PLACE_RIGHT_HALF,
+        /* #..#. */ MP_IN_PLACE_RIGHT_HALF,
+        /* .#.#. */ MP_IN_PLACE_RIGHT_HALF,
+        /* ##.#. */ MP_IN_PLACE_RIGHT_HALF,
+        /* ..##. */ MP_IN_PLACE_RIGHT_HALF,
+        /* #.##. */ MP_IN_PLACE_RIGHT_HALF,
+        /* .###. */ MP_IN_PLACE_RIGHT_HALF,
+        /* ####. */ MP_IN_PLACE_RIGHT_HALF,
+        /* ....# */ MP_IN_PLACE_RIGHT,
+        /* #...# */ MP_IN_PLACE_RIGHT,
+        /* .#..# */ MP_IN_PLACE_RIGHT,
+        /* ##..# */ MP_IN_PLACE_RIGHT,
+        /* ..#.# */ MP_IN_PLACE_RIGHT,
+        /* #.#.# */ MP_IN_PLACE_RIGHT,
+        /* .##.# */ MP_IN_PLACE_RIGHT,
+        /* ###.# */ MP_IN_PLACE_RIGHT,
+        /* ...## */ MP_IN_PLACE_RIGHT_HALF,
+        /* #..## */ MP_IN_PLACE_RIGHT_HALF,
+        /* .#.## */ MP_IN_PLACE_RIGHT_HALF,
+        /* ##.## */ MP_IN_PLACE_RIGHT_HALF,
+        /* ..### */ MP_IN_PLACE_RIGHT_HALF,
+        /* #.### */ MP_IN_PLACE_RIGHT_HALF,
+        /* .#### */ MP_IN_PLACE_RIGHT_HALF,
+        /* ##### */ MP_IN_PLACE_RIGHT_HALF
+};
+
+/**
+ * Alignment test at the end of the rotation (turn_command::update).
+ * Stops the robot when it is aligned to the next line, MP_NONE keeps rotating.
+ */
+const uint8_t TURN_ALIGNED_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_NONE,
+        /* #.... */ MP_NONE,
+        /* .#... */ MP_NONE,
+        /* ##... */ MP_NONE,
+        /* ..#.. */ MP_STOP,
+        /* #.#.. */ MP_STOP,
+        /* .##.. */ MP_NONE,
+        /* ###.. */ MP_NONE,
+        /* ...#. */ MP_NONE,
+        /* #..#. */ MP_NONE,
+        /* .#.#. */ MP_NONE,
+        /* ##.#. */ MP_NONE,
+        /* ..##. */ MP_STOP,
+        /* #.##. */ MP_STOP,
+        /* .###. */ MP_NONE,
+        /* ####. */ MP_NONE,
+        /* ....# */ MP_NONE,
+        /* #...# */ MP_NONE,
+        /* .#..# */ MP_NONE,
+        /* ##..# */ MP_NONE,
+        /* ..#.# */ MP_NONE,
+        /* #.#.# */ MP_NONE,
+        /* .##.# */ MP_NONE,
+        /* ###.# */ MP_NONE,
+        /* ...## */ MP_NONE,
+        /* #..## */ MP_NONE,
+        /* .#.## */ MP_NONE,
+        /* ##.## */ MP_NONE,
+        /* ..### */ MP_NONE,
+        /* #.### */ MP_NONE,
+        /* .#### */ MP_NONE,
+        /* ##### */ MP_NONE
+};
+
+/**
+ * Holding the position on the cross while waiting (idle_phase).
+ * A single line beside the middle sensor is brought back by a very slow rotation,
+ * anything else (no line, crossing lines) keeps the robot stopped.
+ */
+const uint8_t HOLD_TABLE[SENSOR_PATTERNS] PROGMEM = {
+        /* ..... */ MP_STOP,
+        /* #.... */ MP_IN_PLACE_LEFT_SLOW,
+        /* .#... */ MP_IN_PLACE_LEFT_SLOW,
+        /* ##... */ MP_IN_PLACE_LEFT_SLOW,
+        /* ..#.. */ MP_STOP,
+        /* #.#.. */ MP_STOP,
+        /* .##.. */ MP_IN_PLACE_LEFT_SLOW,
+        /* ###.. */ MP_STOP,
+        /* ...#. */ MP_IN_PLACE_RIGHT_SLOW,
+        /* #..#. */ MP_STOP,
+        /* .#.#. */ MP_STOP,
+        /* ##.#. */ MP_STOP,
+        /* ..##. */ MP_IN_PLACE_RIGHT_SLOW,
+        /* #.##. */ MP_STOP,
+        /* .###. */ MP_STOP,
+        /* ####. */ MP_STOP,
+        /* ....# */ MP_IN_PLACE_RIGHT_SLOW,
+        /* #...# */ MP_STOP,
+        /* .#..# */ MP_STOP,
+        /* ##..# */ MP_STOP,
+        /* ..#.# */ MP_STOP,
+        /* #.#.# */ MP_STOP,
+        /* .##.# */ MP_STOP,
+        /* ###.# */ MP_STOP,
+        /* ...## */ MP_IN_PLACE_RIGHT_SLOW,
+        /* #..## */ MP_STOP,
+        /* .#.## */ MP_STOP,
+        /* ##.## */ MP_STOP,
+        /* ..### */ MP_STOP,
+        /* #.### */ MP_STOP,
+        /* .#### */ MP_STOP,
+        /* ##### */ MP_STOP
+};
+
+/**
+ * Gets the motion primitive of the given decision table for the given sensor pattern.
+ *
+ * @param table Decision table of the command phase.
+ * @param pattern Sensor pattern, only the lowest five bits are used.
+ * @return The motion primitive for the sensor pattern.
+ */
+inline motion_primitive lookup_primitive(const uint8_t *table, uint8_t pattern) {
+#ifdef __AVR__
+    return (motion_primitive) pgm_read_byte(&table[pattern & (SENSOR_PATTERNS - 1)]);
+#else
+    return (motion_primitive) table[pattern & (SENSOR_PATTERNS - 1)];
+#endif
+}
+
+/**
+ * Gets printable name of the motion primitive.
+ *
+ * @param primitive The motion primitive.
+ * @return The printable name of the motion primitive.
+ */
+inline const char *get_primitive_name(motion_primitive primitive) {
+    switch (primitive) {
+        case MP_NONE:
+            return "none";
+        case MP_STOP:
+            return "stop";
+        case MP_STOP_SMOOTHLY:
+            return "stop_smoothly";
+        case MP_FULL_FORWARD:
+            return "full_forward";
+        case MP_HALF_FORWARD:
+            return "half_forward";
+        case MP_QUARTER_FORWARD:
+            return "quarter_forward";
+        case MP_IN_PLACE_LEFT:
+            return "in_place_left";
+        case MP_IN_PLACE_LEFT_HALF:
+            return "in_place_left_half";
+        case MP_SLIGHTLY_LEFT:
+            return "slightly_left";
+        case MP_SHARPLY_LEFT:
+            return "sharply_left";
+        case MP_IN_PLACE_RIGHT:
+            return "in_place_right";
+        case MP_IN_PLACE_RIGHT_HALF:
+            return "in_place_right_half";
+        case MP_SLIGHTLY_RIGHT:
+            return "slightly_right";
+        case MP_SHARPLY_RIGHT:
+            return "sharply_right";
+        case MP_IN_PLACE_LEFT_SLOW:
+            return "in_place_left_slow";
+        case MP_IN_PLACE_RIGHT_SLOW:
+            return "in_place_right_slow";
+        default:
+            return "unknown";
+    }
+}
+
+#endif
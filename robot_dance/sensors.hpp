@@ -2,11 +2,37 @@
 #ifndef SENSORS_HPP
 #define SENSORS_HPP
 
-#include <Arduino.h>
+#include "hal.hpp"
+
+#include "sensor_patterns.h"
+#include "sensor_edges.h"
+#include "sensor_history.h"
 
 #define BLACK   (0)
 #define WHITE   (1)
 
+/**
+ * Number of the history bytes in one line of its dump.
+ */
+#define SENSOR_HISTORY_LINE     (32)
+
+
+#ifdef ENABLE_EDGE_CAPTURE
+
+/**
+ * Edges captured by the pin change interrupt of the sensor port.
+ */
+HAL_THREAD_LOCAL sensor_edge_ring sensor_edge_capture;
+
+/**
+ * Records the sensor pattern on any change of the sensor pins 3-7.
+ */
+void sensor_pin_change() {
+    sensor_edge_capture.push((uint8_t) (~hal_read_pins() >> 3) & 0x1F, micros());
+}
+
+#endif
+
 
 /**
  * Class for using attached infra-red sensors.
@@ -30,6 +56,28 @@ private:
      */
     int sensor_values[NUM_SENSORS] = {0, 0, 0, 0, 0};
 
+    /**
+     * Last measured sensor values as a bit mask, see PATTERN_* bits.
+     */
+    uint8_t pattern = 0;
+
+#ifdef ENABLE_EDGE_CAPTURE
+    /**
+     * Defines if the entry times come from the pin change interrupt instead of polling.
+     */
+    bool edge_capture = false;
+#endif
+
+    /**
+     * Times when the sensors started reading black color.
+     */
+    sensor_entry_times entries;
+
+    /**
+     * Recent changes of the pattern.
+     */
+    sensor_history history;
+
 public:
 
     /**
@@ -41,15 +89,89 @@ public:
         }
     }
 
+    /**
+     * Enables or disables capturing of the sensor edges by the pin change interrupt.
+     *
+     * @param enable If the edges should be captured.
+     */
+    void set_edge_capture(bool enable);
+
     /**
      * Reads and stores values of each sensor.
      */
     void read_sensors() {
+        pattern = 0;
         for (int i = 0; i < NUM_SENSORS; i++) {
             sensor_values[i] = digitalRead(sensors[i]);
+            if (sensor_values[i] == BLACK) {
+                pattern |= 1 << i;
+            }
+        }
+
+#ifdef ENABLE_EDGE_CAPTURE
+        if (edge_capture) {
+            sensor_edge edge;
+            while (sensor_edge_capture.pop(&edge)) {
+                entries.process(edge.pattern, edge.time);
+                history.record(edge.pattern, edge.time);
+            }
+            return;
+        }
+#endif
+        if (pattern != entries.get_pattern()) {
+            const time_type now = micros();
+            entries.process(pattern, now);
+            history.record(pattern, now);
         }
     }
 
+    /**
+     * Gets the recent changes of the pattern.
+     *
+     * @return The history of the pattern.
+     */
+    sensor_history &get_history() {
+        return history;
+    }
+
+    /**
+     * Prints the history as a header line and lines of hexadecimal bytes starting by '%', see sensor_history.
+     */
+    void print_history();
+
+    /**
+     * Gets last measured sensor values as a bit mask indexing the decision tables.
+     *
+     * @return The bit mask, set bit means the sensor is reading black color.
+     */
+    uint8_t get_pattern() const {
+        return pattern;
+    }
+
+    /**
+     * Gets time when the given sensor started reading black color, precise
+     * to a few us with the edge capture, to one loop period otherwise.
+     *
+     * @param index Index of the sensor, 0 is the most left one.
+     * @return The time in us.
+     */
+    time_type get_entry_time(uint8_t index) const {
+        return entries.get_entry_time(index);
+    }
+
+    /**
+     * Gets number of sensor edges lost because the main loop did not keep up.
+     *
+     * @return Number of dropped edges, saturated at 255.
+     */
+    uint8_t get_dropped_edges() const {
+#ifdef ENABLE_EDGE_CAPTURE
+        return sensor_edge_capture.get_dropped();
+#else
+        return 0;
+#endif
+    }
+
     /**
      * Checks if the most left sensor is reading black color.
      *
@@ -133,4 +255,42 @@ public:
 
 };
 
+
+
+//class sensors
+
+void sensors::print_history() {
+    static const char digits[] = "0123456789abcdef";
+    Serial.print(F("sensor history: "));
+    Serial.print(history.size());
+    Serial.print(F(" bytes until "));
+    Serial.print(history.get_last_time());
+    Serial.println(F(" ms"));
+
+    for (uint16_t line = 0; line < history.size(); line += SENSOR_HISTORY_LINE) {
+        Serial.print('%');
+        for (uint16_t i = line; i < history.size() && i < line + SENSOR_HISTORY_LINE; i++) {
+            const uint8_t value = history.get_byte(i);
+            Serial.print(digits[value >> 4]);
+            Serial.print(digits[value & 0x0F]);
+        }
+        Serial.println();
+    }
+    history.clear_dump_request();
+}
+
+inline void sensors::set_edge_capture(bool enable) {
+#ifdef ENABLE_EDGE_CAPTURE
+    edge_capture = enable;
+    if (enable) {
+        hal_attach_pin_change(0xF8, &sensor_pin_change);
+    } else {
+        hal_detach_pin_change();
+    }
+#else
+    /* The ring is left out of the build, the entry times are polled */
+    (void) enable;
+#endif
+}
+
 #endif //SENSORS_HPP
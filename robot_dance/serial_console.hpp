@@ -0,0 +1,241 @@
+
+#ifndef SERIAL_CONSOLE_HPP
+#define SERIAL_CONSOLE_HPP
+
+#include "hal.hpp"
+#include <stdlib.h>
+
+#include "boe_bot.hpp"
+
+#define CONSOLE_LINE_LENGTH (32)
+
+
+/**
+ * Serves line commands received on the Serial line while the robot waits for the button:
+ *   C              prints the calibration
+ *   K kp ki kd     sets gains of the line following and stores the calibration
+ *   V speed        sets the cruise speed in permille and stores the calibration
+ *   F flags        sets the calibration flags and stores the calibration
+ *   P period       sets the control loop period in us and stores the calibration
+ *   L              prints the control loop statistics of the last dance and the dropped telemetry events
+ *   H              prints the history of the sensor patterns, about the last 20 s of a dance
+ *   M [0]          prints the timing statistics of the commands, clears them by 0
+ *   R              prints the early, on-time and late arrivals at the waypoints of the last show
+ *   T move center miss leave   sets the motion timing in ms and stores the calibration
+ *   S steps jump cspeed tspeed sets the smoothing and the motion speeds and stores the calibration
+ *   A sweep inner  sets the minimum sweep time in ms and the inner wheel speed of the arcs and stores the calibration
+ */
+class serial_console {
+
+    /**
+     * Robot to be queried.
+     */
+    boe_bot *robot;
+
+    /**
+     * Characters of the currently received line.
+     */
+    char line[CONSOLE_LINE_LENGTH];
+
+    /**
+     * Number of characters in the line.
+     */
+    uint8_t length = 0;
+
+    /**
+     * Parses the next integer argument of the line.
+     *
+     * @param cursor Position in the line, moved behind the parsed number.
+     * @param value Parsed value.
+     * @return If a number was found.
+     */
+    bool parse_argument(char **cursor, long *value);
+
+    /**
+     * Prints the control loop statistics.
+     */
+    void print_loop_statistics();
+
+    /**
+     * Executes the received line.
+     */
+    void execute();
+
+public:
+
+    /**
+     * Creates a console for the given robot.
+     *
+     * @param robot_p Robot to be queried.
+     */
+    explicit serial_console(boe_bot *robot_p);
+
+    /**
+     * Processes all received characters, executes the command when the line is complete.
+     */
+    void poll();
+
+};
+
+
+
+//class serial_console
+
+inline serial_console::serial_console(boe_bot *robot_p) : robot(robot_p) {}
+
+void serial_console::poll() {
+    while (Serial.available() > 0) {
+        const char value = (char) Serial.read();
+        if (value == '\n' || value == '\r') {
+            if (length > 0) {
+                line[length] = '\0';
+                execute();
+                length = 0;
+            }
+        } else if (length < CONSOLE_LINE_LENGTH - 1) {
+            line[length++] = value;
+        }
+    }
+}
+
+bool serial_console::parse_argument(char **cursor, long *value) {
+    char *end;
+    *value = strtol(*cursor, &end, 10);
+    if (end == *cursor) {
+        return false;
+    }
+    *cursor = end;
+    return true;
+}
+
+void serial_console::print_loop_statistics() {
+    const loop_scheduler &scheduler = robot->get_scheduler();
+    Serial.print(F("loop period="));
+    Serial.print(scheduler.get_period());
+    Serial.print(F(" count="));
+    Serial.print(scheduler.get_count());
+    Serial.print(F(" min="));
+    Serial.print(scheduler.get_min_period());
+    Serial.print(F(" mean="));
+    Serial.print(scheduler.get_mean_period());
+    Serial.print(F(" max="));
+    Serial.print(scheduler.get_max_period());
+    Serial.print(F(" overruns="));
+    Serial.print(scheduler.get_overruns());
+    Serial.print(F(" busy mean="));
+    Serial.print(scheduler.get_mean_busy());
+    Serial.print(F(" max="));
+    Serial.print(scheduler.get_max_busy());
+    Serial.print(F(" telemetry dropped="));
+    Serial.println(robot->get_telemetry().get_dropped());
+}
+
+void serial_console::execute() {
+    calibration &calib = robot->get_calibration();
+    char *cursor = line + 1;
+    long a, b, c, d;
+    motion_tuning tuning = calib.get_tuning();
+
+    switch (toupper(line[0])) {
+        case 'C':
+            calib.print();
+            return;
+        case 'K':
+            if (!parse_argument(&cursor, &a) || !parse_argument(&cursor, &b) || !parse_argument(&cursor, &c)) {
+                break;
+            }
+            line_controller_gains gains;
+            gains.kp = (int16_t) a;
+            gains.ki = (int16_t) b;
+            gains.kd = (int16_t) c;
+            calib.set_gains(gains);
+            calib.store();
+            calib.print();
+            return;
+        case 'V':
+            if (!parse_argument(&cursor, &a)) {
+                break;
+            }
+            calib.set_cruise_speed((int16_t) constrain(a, 0, 1000));
+            calib.store();
+            calib.print();
+            return;
+        case 'F':
+            if (!parse_argument(&cursor, &a)) {
+                break;
+            }
+            calib.set_flags((uint16_t) a);
+            calib.store();
+            robot->apply_calibration();
+            calib.print();
+            return;
+        case 'P':
+            if (!parse_argument(&cursor, &a)) {
+                break;
+            }
+            calib.set_loop_period((uint16_t) constrain(a, 0, 60000));
+            calib.store();
+            robot->apply_calibration();
+            calib.print();
+            return;
+        case 'L':
+            print_loop_statistics();
+            return;
+        case 'H':
+            robot->get_sensors().print_history();
+            return;
+        case 'M':
+            if (parse_argument(&cursor, &a) && a == 0) {
+                robot->get_command_statistics().clear();
+            }
+            robot->get_command_statistics().print();
+            return;
+        case 'R':
+            robot->get_tempo().print();
+            return;
+        case 'T':
+            if (!parse_argument(&cursor, &a) || !parse_argument(&cursor, &b) ||
+                !parse_argument(&cursor, &c) || !parse_argument(&cursor, &d)) {
+                break;
+            }
+            tuning.move_min_time = (uint16_t) constrain(a, 0, 5000);
+            tuning.cross_center_time = (uint16_t) constrain(b, 0, 5000);
+            tuning.turn_miss_time = (uint16_t) constrain(c, 0, 5000);
+            tuning.turn_leave_time = (uint16_t) constrain(d, 0, 5000);
+            calib.set_tuning(tuning);
+            calib.store();
+            calib.print();
+            return;
+        case 'S':
+            if (!parse_argument(&cursor, &a) || !parse_argument(&cursor, &b) ||
+                !parse_argument(&cursor, &c) || !parse_argument(&cursor, &d)) {
+                break;
+            }
+            tuning.smoothing_steps = (uint16_t) constrain(a, 0, 1000);
+            tuning.smoothing_jump = (int16_t) constrain(b, 0, 1000);
+            tuning.center_speed = (int16_t) constrain(c, 0, 1000);
+            tuning.turn_speed = (int16_t) constrain(d, 1, 1000);
+            calib.set_tuning(tuning);
+            calib.store();
+            robot->apply_calibration();
+            calib.print();
+            return;
+        case 'A':
+            if (!parse_argument(&cursor, &a) || !parse_argument(&cursor, &b)) {
+                break;
+            }
+            tuning.arc_sweep_time = (uint16_t) constrain(a, 0, 5000);
+            tuning.arc_inner_speed = (int16_t) constrain(b, -1000, 1000);
+            calib.set_tuning(tuning);
+            calib.store();
+            calib.print();
+            return;
+        default:
+            break;
+    }
+
+    Serial.print(F("Unknown command: "));
+    Serial.println(line);
+}
+
+#endif //SERIAL_CONSOLE_HPP
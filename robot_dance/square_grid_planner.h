@@ -42,6 +42,14 @@ private:
      */
     position add_go_straight_commands(const location &start_location, int count);
 
+    /**
+     * Adds an arc command through the corner of the route in front, if the planner provides one.
+     *
+     * @param start_location Initial location, the corner is the next cross in its direction.
+     * @param to Direction of the route after the corner.
+     */
+    void add_arc_command(const location &start_location, const direction &to);
+
     /**
      * Counts number of rotation steps for given initial and desired situation. Adds commands
      * to the queue if desired.
@@ -82,6 +90,18 @@ protected:
 
     virtual command *get_turn_cmd(bool left, const location &final_location) = 0;
 
+    /**
+     * Gets a command driving to the next cross and turning on it on an arc without the stop.
+     * The default planner has none, the robot stops on the corner and turns in place.
+     *
+     * @param left Direction of the turn on the corner.
+     * @param final_location Location after the turn, on the corner in the new direction.
+     * @return The arc command or nullptr if the corner is driven by a move and a turn.
+     */
+    virtual command *get_arc_turn_cmd(bool, const location &) {
+        return nullptr;
+    }
+
     virtual void prepare_route_step(const location &source, const location &target, bool moveFirstX);
 
 public:
@@ -131,6 +151,12 @@ inline void square_grid_planner::prepare_route_step(const location &source, cons
         add_rotation_commands(last_position, last_direction, first_move_direction);
         last_direction = first_move_direction;
 
+        /* The last tile before the corner and the turn on it make one arc, the next leg starts in the motion */
+        if ((moveFirstX ? move.get_x_abs() : move.get_y_abs()) == 1 &&
+            second_move_direction != direction::NotSpecified) {
+            add_arc_command(location(last_position, last_direction), second_move_direction);
+        }
+
         last_position = add_go_straight_commands(location(last_position, last_direction),
                                                  moveFirstX ? move.get_x_abs() : move.get_y_abs());
     }
@@ -229,6 +255,22 @@ inline position square_grid_planner::add_go_straight_commands(const location &st
     return current_position;
 };
 
+inline void square_grid_planner::add_arc_command(const location &start_location, const direction &to) {
+    if (next_command != nullptr) {
+        return;
+    }
+
+    const position corner = start_location.get_position() + position(start_location.get_direction());
+    /* The legs of a route are perpendicular, the corner is a single turn */
+    const bool clockwise = try_turn(start_location.get_direction(), to, true, false, corner) == 1;
+
+    location loc(corner, to);
+    command *arc = get_arc_turn_cmd(!clockwise, loc);
+    if (arc != nullptr) {
+        add_command(arc, loc);
+    }
+}
+
 inline bool square_grid_planner::prepare_route(const location &source, const location &target, bool moveFirstX) {
     current_location = source;
     target_location = target;
@@ -0,0 +1,426 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+#include "location.h"
+
+/**
+ * Capacity of the frame ring in bytes, must be a power of two not greater than 128.
+ */
+#define TELEMETRY_RING_SIZE     (64)
+
+/**
+ * Longest payload of an event in bytes.
+ */
+#define TELEMETRY_MAX_PAYLOAD   (10)
+
+/**
+ * Longest frame on the Serial line: two delimiters, the COBS code, the event id,
+ * the time, the payload and the checksum.
+ */
+#define TELEMETRY_FRAME_LENGTH  (TELEMETRY_MAX_PAYLOAD + 9)
+
+/**
+ * Length of the encoded TELEMETRY_DROPPED record with its two bytes of the payload.
+ */
+#define TELEMETRY_DROPPED_LENGTH (2 + 9)
+
+/**
+ * Event ids.
+ */
+#define TELEMETRY_ROUTE_START   (0x01)
+#define TELEMETRY_COMMAND_START (0x02)
+#define TELEMETRY_COMMAND_END   (0x03)
+#define TELEMETRY_ARRIVAL       (0x04)
+#define TELEMETRY_SENSORS       (0x05)
+#define TELEMETRY_ROUTE_DONE    (0x06)
+#define TELEMETRY_ROUTE_ERROR   (0x07)
+#define TELEMETRY_INTERRUPTED   (0x08)
+#define TELEMETRY_IDLE          (0x09)
+#define TELEMETRY_ANOMALY       (0x0A)
+#define TELEMETRY_DROPPED       (0x0B)
+#define TELEMETRY_SKIPPED       (0x0C)
+#define TELEMETRY_LINE_FOUND    (0x0D)
+
+/**
+ * Codes of the anomalies.
+ */
+#define ANOMALY_TURN_SKIPPED    (1)
+#define ANOMALY_MIDDLE_MISSED   (2)
+#define ANOMALY_TIMEOUT         (3)
+
+
+/**
+ * Binary telemetry of the dance replacing the text prints of the dance loop. Every event is
+ * a frame of the event id, the time in ms, the payload and a checksum, all multi-byte values
+ * little endian. The frame is COBS encoded and put between two zero bytes, so that the decoder
+ * finds the frames among the text lines. The frames are encoded to a RAM ring when the event
+ * happens and sent out whole, only when the transmit buffer of the Serial line has room for them.
+ * An event which does not fit into the ring is dropped and counted.
+ */
+class telemetry {
+
+    /**
+     * Encoded frames not sent yet.
+     */
+    uint8_t bytes[TELEMETRY_RING_SIZE];
+
+    /**
+     * Number of queued bytes modulo 256.
+     */
+    uint8_t head = 0;
+
+    /**
+     * Number of sent bytes modulo 256.
+     */
+    uint8_t tail = 0;
+
+    /**
+     * Number of dropped events, saturates at 65535.
+     */
+    uint16_t dropped = 0;
+
+    /**
+     * Number of the dropped events already reported by a TELEMETRY_DROPPED record.
+     */
+    uint16_t reported = 0;
+
+    /**
+     * Encodes the event to the ring.
+     *
+     * @param id Event id, see TELEMETRY_* ids.
+     * @param now Time of the event in ms.
+     * @param payload Payload of the event.
+     * @param length Length of the payload, at most TELEMETRY_MAX_PAYLOAD.
+     */
+    void push(uint8_t id, time_type now, const uint8_t *payload, uint8_t length);
+
+    /**
+     * Gets the free space of the ring.
+     *
+     * @return The number of the free bytes.
+     */
+    uint8_t get_free() const {
+        return (uint8_t) (TELEMETRY_RING_SIZE - (uint8_t) (head - tail));
+    }
+
+    /**
+     * Stores the location to the payload.
+     *
+     * @param payload Payload of the event, 3 bytes are written.
+     * @param loc Location to be stored.
+     */
+    static void put_location(uint8_t *payload, const location &loc) {
+        payload[0] = (uint8_t) loc.get_position().get_x();
+        payload[1] = (uint8_t) loc.get_position().get_y();
+        payload[2] = (uint8_t) loc.get_direction();
+    }
+
+    /**
+     * Stores the value to the payload.
+     *
+     * @param payload Payload of the event, 'size' bytes are written.
+     * @param value Value to be stored.
+     * @param size Number of the lowest bytes of the value.
+     */
+    static void put_value(uint8_t *payload, uint32_t value, uint8_t size) {
+        for (uint8_t i = 0; i < size; i++) {
+            payload[i] = (uint8_t) (value >> (8 * i));
+        }
+    }
+
+public:
+
+    /**
+     * The robot starts the route to the waypoint.
+     *
+     * @param now Time of the event in ms.
+     * @param target Waypoint of the route.
+     * @param first_x Defines if the route goes along the X axis first.
+     * @param constraint Time constraint of the waypoint in 0.1 s.
+     */
+    void route_start(time_type now, const position &target, bool first_x, time_type constraint);
+
+    /**
+     * The command starts.
+     *
+     * @param now Time of the event in ms.
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     * @param final_location Location at the end of the command.
+     */
+    void command_start(time_type now, uint8_t kind, const location &final_location);
+
+    /**
+     * The command finished.
+     *
+     * @param now Time of the event in ms.
+     * @param kind Kind of the command, see COMMAND_* kinds.
+     * @param duration Duration of the command in ms.
+     * @param updates Number of the update calls.
+     */
+    void command_end(time_type now, uint8_t kind, time_type duration, uint16_t updates);
+
+    /**
+     * Snapshot of the sensors.
+     *
+     * @param now Time of the event in ms.
+     * @param pattern Pattern read by the sensors, see PATTERN_* bits.
+     * @param loc Location reported by the robot.
+     */
+    void sensors(time_type now, uint8_t pattern, const location &loc);
+
+    /**
+     * The wait for the time constraint ended.
+     *
+     * @param now Time of the event in ms.
+     * @param slack Length of the wait in ms.
+     * @param work Time of the background work in us.
+     * @param steps Number of the background steps.
+     * @param exit_delay Time of the end of the wait after the deadline in us.
+     */
+    void idle(time_type now, time_type slack, time_type work, uint16_t steps, time_type exit_delay);
+
+    /**
+     * The robot arrived at the waypoint, before it possibly waits for the time constraint.
+     *
+     * @param now Time of the event in ms.
+     * @param deadline Time constraint in ms since the start of the dance, 0 if there is none.
+     * @param arrival Time of the arrival in ms since the start of the dance.
+     */
+    void arrival(time_type now, time_type deadline, time_type arrival);
+
+    /**
+     * The overdue waypoint was skipped to catch up.
+     *
+     * @param now Time of the event in ms.
+     * @param target The skipped waypoint.
+     * @param constraint Time constraint of the waypoint in 0.1 s.
+     */
+    void skipped(time_type now, const position &target, time_type constraint);
+
+    /**
+     * The move found its line again after all sensors lost it.
+     *
+     * @param now Time of the event in ms.
+     * @param lost Time without the line in ms.
+     * @param searched Defines if the robot had to search for the line in place.
+     */
+    void line_found(time_type now, time_type lost, bool searched);
+
+    /**
+     * The route is done.
+     *
+     * @param now Time of the event in ms.
+     * @param loc Location at the end of the route.
+     */
+    void route_done(time_type now, const location &loc);
+
+    /**
+     * The route to the waypoint could not be prepared.
+     *
+     * @param now Time of the event in ms.
+     * @param target Waypoint of the route.
+     */
+    void route_error(time_type now, const position &target);
+
+    /**
+     * The button interrupted the dance.
+     *
+     * @param now Time of the event in ms.
+     */
+    void interrupted(time_type now);
+
+    /**
+     * A command met an unexpected situation.
+     *
+     * @param now Time of the event in ms.
+     * @param code Code of the anomaly, see ANOMALY_* codes.
+     * @param loc Location reported by the robot.
+     */
+    void anomaly(time_type now, uint8_t code, const location &loc);
+
+    /**
+     * Gets number of the dropped events.
+     *
+     * @return The number of the dropped events.
+     */
+    uint16_t get_dropped() const {
+        return dropped;
+    }
+
+    /**
+     * Sends the queued frames while the transmit buffer of the Serial line has room for them.
+     * Events dropped since the last call are reported by a TELEMETRY_DROPPED record first.
+     * Meant for the idle phases only: the slack between the control steps and the wait for the time constraint.
+     *
+     * @return If any frame is still waiting.
+     */
+    bool drain();
+
+};
+
+
+
+//class telemetry
+
+void telemetry::push(uint8_t id, time_type now, const uint8_t *payload, uint8_t length) {
+    uint8_t frame[TELEMETRY_MAX_PAYLOAD + 6];
+    uint8_t size = 0;
+    frame[size++] = id;
+    put_value(frame + size, now, 4);
+    size += 4;
+    uint8_t checksum = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        frame[size++] = payload[i];
+    }
+    for (uint8_t i = 0; i < size; i++) {
+        checksum += frame[i];
+    }
+    frame[size++] = (uint8_t) -checksum;
+
+    /* Delimiters and the COBS code, the frame is shorter than 254 bytes */
+    const uint8_t encoded = (uint8_t) (size + 3);
+    if (get_free() < encoded) {
+        if (dropped < UINT16_MAX) {
+            ++dropped;
+        }
+        return;
+    }
+
+    bytes[head++ & (TELEMETRY_RING_SIZE - 1)] = 0;
+    uint8_t code_index = head++;
+    uint8_t code = 1;
+    for (uint8_t i = 0; i < size; i++) {
+        if (frame[i] == 0) {
+            bytes[code_index & (TELEMETRY_RING_SIZE - 1)] = code;
+            code_index = head++;
+            code = 1;
+        } else {
+            bytes[head++ & (TELEMETRY_RING_SIZE - 1)] = frame[i];
+            ++code;
+        }
+    }
+    bytes[code_index & (TELEMETRY_RING_SIZE - 1)] = code;
+    bytes[head++ & (TELEMETRY_RING_SIZE - 1)] = 0;
+}
+
+void telemetry::route_start(time_type now, const position &target, bool first_x, time_type constraint) {
+    uint8_t payload[5];
+    payload[0] = (uint8_t) target.get_x();
+    payload[1] = (uint8_t) target.get_y();
+    payload[2] = first_x ? 1 : 0;
+    put_value(payload + 3, constraint, 2);
+    push(TELEMETRY_ROUTE_START, now, payload, sizeof(payload));
+}
+
+void telemetry::command_start(time_type now, uint8_t kind, const location &final_location) {
+    uint8_t payload[4];
+    payload[0] = kind;
+    put_location(payload + 1, final_location);
+    push(TELEMETRY_COMMAND_START, now, payload, sizeof(payload));
+}
+
+void telemetry::command_end(time_type now, uint8_t kind, time_type duration, uint16_t updates) {
+    uint8_t payload[5];
+    payload[0] = kind;
+    put_value(payload + 1, duration < UINT16_MAX ? duration : UINT16_MAX, 2);
+    put_value(payload + 3, updates, 2);
+    push(TELEMETRY_COMMAND_END, now, payload, sizeof(payload));
+}
+
+void telemetry::sensors(time_type now, uint8_t pattern, const location &loc) {
+    uint8_t payload[4];
+    payload[0] = pattern;
+    put_location(payload + 1, loc);
+    push(TELEMETRY_SENSORS, now, payload, sizeof(payload));
+}
+
+void telemetry::idle(time_type now, time_type slack, time_type work, uint16_t steps, time_type exit_delay) {
+    uint8_t payload[10];
+    put_value(payload, slack < UINT16_MAX ? slack : UINT16_MAX, 2);
+    put_value(payload + 2, work, 4);
+    put_value(payload + 6, steps, 2);
+    put_value(payload + 8, exit_delay < UINT16_MAX ? exit_delay : UINT16_MAX, 2);
+    push(TELEMETRY_IDLE, now, payload, sizeof(payload));
+}
+
+void telemetry::arrival(time_type now, time_type deadline, time_type arrival) {
+    uint8_t payload[8];
+    put_value(payload, deadline, 4);
+    put_value(payload + 4, arrival, 4);
+    push(TELEMETRY_ARRIVAL, now, payload, sizeof(payload));
+}
+
+void telemetry::skipped(time_type now, const position &target, time_type constraint) {
+    uint8_t payload[4];
+    payload[0] = (uint8_t) target.get_x();
+    payload[1] = (uint8_t) target.get_y();
+    put_value(payload + 2, constraint, 2);
+    push(TELEMETRY_SKIPPED, now, payload, sizeof(payload));
+}
+
+void telemetry::line_found(time_type now, time_type lost, bool searched) {
+    uint8_t payload[3];
+    put_value(payload, lost, 2);
+    payload[2] = searched ? 1 : 0;
+    push(TELEMETRY_LINE_FOUND, now, payload, sizeof(payload));
+}
+
+void telemetry::route_done(time_type now, const location &loc) {
+    uint8_t payload[3];
+    put_location(payload, loc);
+    push(TELEMETRY_ROUTE_DONE, now, payload, sizeof(payload));
+}
+
+void telemetry::route_error(time_type now, const position &target) {
+    uint8_t payload[2];
+    payload[0] = (uint8_t) target.get_x();
+    payload[1] = (uint8_t) target.get_y();
+    push(TELEMETRY_ROUTE_ERROR, now, payload, sizeof(payload));
+}
+
+void telemetry::interrupted(time_type now) {
+    push(TELEMETRY_INTERRUPTED, now, nullptr, 0);
+}
+
+void telemetry::anomaly(time_type now, uint8_t code, const location &loc) {
+    uint8_t payload[4];
+    payload[0] = code;
+    put_location(payload + 1, loc);
+    push(TELEMETRY_ANOMALY, now, payload, sizeof(payload));
+}
+
+bool telemetry::drain() {
+    for (;;) {
+        /* The record of the loss follows the frames queued before it and waits for room in the ring */
+        if (dropped != reported && get_free() >= TELEMETRY_DROPPED_LENGTH) {
+            const uint16_t lost = dropped - reported;
+            uint8_t payload[2];
+            put_value(payload, lost, 2);
+            push(TELEMETRY_DROPPED, millis(), payload, sizeof(payload));
+            reported += lost;
+        }
+        if (head == tail) {
+            return false;
+        }
+
+        /* The frame runs from its opening to its closing delimiter */
+        uint8_t length = 1;
+        while (bytes[(uint8_t) (tail + length) & (TELEMETRY_RING_SIZE - 1)] != 0) {
+            ++length;
+        }
+        ++length;
+        if (Serial.availableForWrite() < length) {
+            return true;
+        }
+        uint8_t frame[TELEMETRY_FRAME_LENGTH];
+        for (uint8_t i = 0; i < length; i++) {
+            frame[i] = bytes[tail++ & (TELEMETRY_RING_SIZE - 1)];
+        }
+        Serial.write(frame, length);
+    }
+}
+
+#endif //TELEMETRY_HPP
@@ -0,0 +1,231 @@
+#ifndef TEMPO_REPORT_HPP
+#define TEMPO_REPORT_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+
+/**
+ * Identifies a valid report in the EEPROM, must be changed with the layout of 'tempo_data'.
+ */
+#define TEMPO_MAGIC             (0x7E02)
+
+/**
+ * Arrivals closer to the time constraint than this number of ms are on time, it is one unit of the 'T' constraint.
+ */
+#define TEMPO_ON_TIME           (100)
+
+
+/**
+ * Arrivals of one show at the waypoints with a time constraint, as stored in the EEPROM.
+ */
+struct tempo_data {
+
+    uint16_t magic;
+
+    /**
+     * Number of the waypoints of the show, the constrained ones are counted below.
+     */
+    uint16_t waypoints;
+
+    /**
+     * Numbers of the arrivals before, at and after the time constraint.
+     */
+    uint16_t early;
+    uint16_t on_time;
+    uint16_t late;
+
+    /**
+     * Number of the waypoints skipped to catch up or given up after a recovery.
+     */
+    uint16_t skipped;
+
+    /**
+     * Latest arrival after the time constraint in ms, saturated at 65535.
+     */
+    uint16_t max_lateness;
+
+    /**
+     * Keeps the following fields aligned, so that the layout is the same on the AVR and on the PC.
+     */
+    uint16_t reserved;
+
+    /**
+     * Sum of the arrival times minus the time constraints in ms, negative if the robot was mostly early.
+     */
+    int32_t total_drift;
+
+    /**
+     * Arrival time minus the time constraint of the last constrained waypoint in ms.
+     */
+    int32_t last_drift;
+
+};
+
+static_assert(sizeof(tempo_data) == 24, "tempo_data must not contain any padding");
+
+
+/**
+ * Tempo of the last show: how early or late the robot arrived at the waypoints compared
+ * to their 'T' constraints. The report is kept in the EEPROM behind the calibration,
+ * so that it can be queried after the show or after the power-on.
+ */
+class tempo_report {
+
+    tempo_data data;
+
+    /**
+     * Offset of the next byte to be stored, size of the data when nothing is pending.
+     */
+    uint8_t pending_offset = sizeof(tempo_data);
+
+public:
+
+    /**
+     * Creates an empty report.
+     */
+    tempo_report() {
+        clear();
+    }
+
+    /**
+     * Forgets all arrivals, e.g. at the start of the show.
+     */
+    void clear();
+
+    /**
+     * Records the arrival at the waypoint.
+     *
+     * @param deadline Time constraint of the waypoint in ms since the start of the show, 0 if there is none.
+     * @param arrival Time of the arrival in ms since the start of the show.
+     */
+    void record(time_type deadline, time_type arrival);
+
+    /**
+     * Records the waypoint skipped to catch up or given up after a recovery.
+     */
+    void skip() {
+        if (data.waypoints < UINT16_MAX) {
+            ++data.waypoints;
+        }
+        if (data.skipped < UINT16_MAX) {
+            ++data.skipped;
+        }
+    }
+
+    /**
+     * Loads the report of the last show from the EEPROM.
+     *
+     * @return If the EEPROM contains any report.
+     */
+    bool load();
+
+    /**
+     * Schedules storing of the report to the EEPROM, the bytes are written by 'store_step'.
+     */
+    void store() {
+        pending_offset = 0;
+    }
+
+    /**
+     * Writes at most one changed byte of the scheduled report without waiting for the EEPROM.
+     *
+     * @return If some bytes are still pending.
+     */
+    bool store_step();
+
+    /**
+     * Gets the recorded arrivals.
+     *
+     * @return The recorded arrivals.
+     */
+    const tempo_data &get_data() const {
+        return data;
+    }
+
+    /**
+     * Prints the report in one line.
+     */
+    void print() const;
+
+};
+
+
+
+//class tempo_report
+
+inline void tempo_report::clear() {
+    memset(&data, 0, sizeof(data));
+    data.magic = TEMPO_MAGIC;
+}
+
+inline void tempo_report::record(time_type deadline, time_type arrival) {
+    if (data.waypoints < UINT16_MAX) {
+        ++data.waypoints;
+    }
+    if (deadline == 0) {
+        return;
+    }
+
+    const int32_t drift = (int32_t) (arrival - deadline);
+    if (drift < -TEMPO_ON_TIME) {
+        ++data.early;
+    } else if (drift > TEMPO_ON_TIME) {
+        ++data.late;
+    } else {
+        ++data.on_time;
+    }
+    if (drift > (int32_t) data.max_lateness) {
+        data.max_lateness = (uint16_t) (drift < UINT16_MAX ? drift : UINT16_MAX);
+    }
+    data.total_drift += drift;
+    data.last_drift = drift;
+}
+
+bool tempo_report::load() {
+    EEPROM.get(EEPROM_TEMPO_ADDRESS, data);
+    if (data.magic != TEMPO_MAGIC) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool tempo_report::store_step() {
+    /* Writing of one byte takes 3.3 ms, the previous one must be finished */
+    if (!hal_eeprom_ready()) {
+        return pending_offset < sizeof(data);
+    }
+    const uint8_t *bytes = (const uint8_t *) &data;
+    while (pending_offset < sizeof(data)) {
+        const int address = EEPROM_TEMPO_ADDRESS + pending_offset;
+        const uint8_t value = bytes[pending_offset++];
+        if (EEPROM.read(address) != value) {
+            EEPROM.write(address, value);
+            break;
+        }
+    }
+    return pending_offset < sizeof(data);
+}
+
+void tempo_report::print() const {
+    Serial.print(F("tempo waypoints="));
+    Serial.print(data.waypoints);
+    Serial.print(F(" early="));
+    Serial.print(data.early);
+    Serial.print(F(" on_time="));
+    Serial.print(data.on_time);
+    Serial.print(F(" late="));
+    Serial.print(data.late);
+    Serial.print(F(" skipped="));
+    Serial.print(data.skipped);
+    Serial.print(F(" max_lateness="));
+    Serial.print(data.max_lateness);
+    Serial.print(F(" drift total="));
+    Serial.print((long) data.total_drift);
+    Serial.print(F(" last="));
+    Serial.print((long) data.last_drift);
+    Serial.println(F(" ms"));
+}
+
+#endif //TEMPO_REPORT_HPP
@@ -0,0 +1,140 @@
+#ifndef TILE_ODOMETRY_HPP
+#define TILE_ODOMETRY_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+
+/**
+ * Time from the cross line to the cross at the cruise speed per the time of the approach to the cross line
+ * in permille. The sensor row leads the wheel axle, the approach includes the start from the standstill.
+ */
+#define TILE_LEAD_RATIO         (300)
+
+/**
+ * Number of the measured approaches before the stop on the cross is predicted.
+ */
+#define TILE_ODOMETRY_SAMPLES   (2)
+
+/**
+ * Weight of a new approach in the learned mean is 1/2^TILE_ODOMETRY_SHIFT.
+ */
+#define TILE_ODOMETRY_SHIFT     (2)
+
+/**
+ * Largest deviation of an approach from the learned mean in permille, the others (e.g. with a line search) are not learned.
+ */
+#define TILE_ODOMETRY_TOLERANCE (200)
+
+/**
+ * Time in ms the robot coasts after the stop, it brakes so much before the cross.
+ */
+#define TILE_BRAKE_TIME         (40)
+
+
+/**
+ * Dead reckoning of the moves by the time. The robot learns the mean time of the approach from a cross
+ * to the line of the next one at the cruise speed, the rest of the way to the cross is a known part of it.
+ * The learned time belongs to one cruise speed, it is learned again when the speed changes.
+ */
+class tile_odometry {
+
+    /**
+     * Learned mean time of the approach in ms.
+     */
+    time_type approach_time = 0;
+
+    /**
+     * Number of the learned approaches, saturated at TILE_ODOMETRY_SAMPLES.
+     */
+    uint8_t samples = 0;
+
+    /**
+     * Cruise speed of the learned approaches in permille of the full speed.
+     */
+    int16_t speed = 0;
+
+public:
+
+    /**
+     * Forgets the learned approaches.
+     */
+    void reset() {
+        approach_time = 0;
+        samples = 0;
+        speed = 0;
+    }
+
+    /**
+     * Checks if the stop on the cross can be predicted at the given speed.
+     *
+     * @param cruise_speed Cruise speed of the move in permille of the full speed.
+     * @return If enough approaches were learned at the speed.
+     */
+    bool is_calibrated(int16_t cruise_speed) const {
+        return samples >= TILE_ODOMETRY_SAMPLES && speed == cruise_speed;
+    }
+
+    /**
+     * Checks if an approach agrees with the learned ones.
+     *
+     * @param approach Time from the start of the move to the cross line in ms.
+     * @return If the approach deviates at most by TILE_ODOMETRY_TOLERANCE from the learned mean.
+     */
+    bool is_expected(time_type approach) const {
+        const time_type deviation = approach > approach_time ? approach - approach_time : approach_time - approach;
+        return deviation <= approach_time * TILE_ODOMETRY_TOLERANCE / 1000;
+    }
+
+    /**
+     * Learns a measured approach, an unexpected one only until the odometry is calibrated.
+     *
+     * @param approach Time from the start of the move to the cross line in ms.
+     * @param cruise_speed Cruise speed of the move in permille of the full speed.
+     */
+    void record(time_type approach, int16_t cruise_speed);
+
+    /**
+     * Gets the time of driving on from the cross line at the cruise speed before the stop.
+     *
+     * @return The time in ms, in which the wheels are on the cross less the coasting after the stop.
+     */
+    time_type get_center_time() const {
+        const time_type center = approach_time * TILE_LEAD_RATIO / 1000;
+        return center > TILE_BRAKE_TIME ? center - TILE_BRAKE_TIME : 0;
+    }
+
+    /**
+     * Gets the learned time of the approach.
+     *
+     * @return The mean time from the start of a move to the cross line in ms.
+     */
+    time_type get_approach_time() const {
+        return approach_time;
+    }
+
+};
+
+
+
+//class tile_odometry
+
+inline void tile_odometry::record(time_type approach, int16_t cruise_speed) {
+    if (speed != cruise_speed) {
+        reset();
+        speed = cruise_speed;
+    }
+    if (samples == 0) {
+        approach_time = approach;
+    } else if (samples < TILE_ODOMETRY_SAMPLES || is_expected(approach)) {
+        approach_time = (time_type) ((int32_t) approach_time +
+                                     ((int32_t) (approach - approach_time) / (1 << TILE_ODOMETRY_SHIFT)));
+    } else {
+        return;
+    }
+    if (samples < TILE_ODOMETRY_SAMPLES) {
+        ++samples;
+    }
+}
+
+#endif
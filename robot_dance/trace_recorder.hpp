@@ -0,0 +1,309 @@
+
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#include "hal.hpp"
+
+#include "robot_dance.hpp"
+#include "sensor_patterns.h"
+
+/**
+ * Capacity of the event ring, must be a power of two not greater than 128.
+ */
+#define TRACE_RING_SIZE     (32)
+
+/**
+ * Event codes, the low bits carry the value of the event.
+ */
+#define TRACE_PATTERN       (0x00)
+#define TRACE_PRIMITIVE     (0x20)
+#define TRACE_START         (0x40)
+#define TRACE_DROPPED       (0x7F)
+
+/**
+ * Primitive value of the steering, it is not part of the motion_primitive enum.
+ */
+#define TRACE_STEERING      (MP_COUNT)
+
+/**
+ * Longest record on the Serial line: '~', code, up to 8 digits of the time and the line end.
+ */
+#define TRACE_RECORD_LENGTH (12)
+
+#ifdef ENABLE_TRACE
+
+/**
+ * Event of the control loop.
+ */
+struct trace_event {
+    /**
+     * Time of the event in us.
+     */
+    time_type time;
+
+    /**
+     * Event code with its value, see TRACE_* codes.
+     */
+    uint8_t code;
+};
+
+
+/**
+ * Records the changes of the sensor pattern and of the commanded primitive during the dance
+ * to a RAM ring and streams them out over the Serial line without blocking, so that a failure
+ * on the floor can be replayed by the firmware on the PC. Every event is one line
+ * "~CCT" of hexadecimal digits: the code CC and the time T in us since the previous event.
+ * The start of the dance carries the absolute time, a lost event is announced
+ * by a record of TRACE_DROPPED carrying the number of the lost events instead of the time.
+ */
+class trace_recorder {
+
+    /**
+     * Events not sent yet.
+     */
+    trace_event events[TRACE_RING_SIZE];
+
+    /**
+     * Number of recorded events modulo 256.
+     */
+    uint8_t head = 0;
+
+    /**
+     * Number of sent events modulo 256.
+     */
+    uint8_t tail = 0;
+
+    /**
+     * Number of lost events, saturates at 255. Once the ring overflows, all events are lost
+     * until it is sent out completely, so that the announcement keeps the order of the events.
+     */
+    uint8_t dropped = 0;
+
+    /**
+     * Defines if the events are recorded.
+     */
+    bool enabled = false;
+
+    /**
+     * Defines if the dance started since the recording was enabled.
+     */
+    bool started = false;
+
+    /**
+     * Last recorded pattern and primitive, 0xFF if none.
+     */
+    uint8_t last_pattern = 0xFF;
+    uint8_t last_primitive = 0xFF;
+
+    /**
+     * Time of the start of the dance in us.
+     */
+    time_type start_time = 0;
+
+    /**
+     * Time of the last sent event in us.
+     */
+    time_type last_sent = 0;
+
+    /**
+     * Stores the event to the ring, counts it as lost if the ring is full or overflowed.
+     *
+     * @param code Event code with its value.
+     * @param time Time of the event in us.
+     */
+    void push(uint8_t code, time_type time);
+
+    /**
+     * Sends one record.
+     *
+     * @param code Event code with its value.
+     * @param value Time or count carried by the record.
+     */
+    static void send(uint8_t code, time_type value);
+
+public:
+
+    /**
+     * Enables or disables the recording, the next dance starts a new trace.
+     *
+     * @param enable If the events should be recorded.
+     */
+    void set_enabled(bool enable) {
+        enabled = enable;
+        started = false;
+    }
+
+    /**
+     * Checks if the events are recorded.
+     *
+     * @return If the recording is enabled.
+     */
+    bool is_enabled() const {
+        return enabled;
+    }
+
+    /**
+     * Starts a new trace at the start of the dance, the unsent events of the previous one are discarded.
+     *
+     * @param now Current time in us.
+     */
+    void start(time_type now);
+
+    /**
+     * Checks if the events of the current dance are recorded.
+     *
+     * @return If the trace was started.
+     */
+    bool is_started() const {
+        return started;
+    }
+
+    /**
+     * Gets the time of the start of the dance.
+     *
+     * @return The time in us.
+     */
+    time_type get_start_time() const {
+        return start_time;
+    }
+
+    /**
+     * Records the sensor pattern if it changed.
+     *
+     * @param pattern Pattern read by the sensors, see PATTERN_* bits.
+     */
+    void record_pattern(uint8_t pattern) {
+        if (started && pattern != last_pattern) {
+            last_pattern = pattern;
+            push((uint8_t) (TRACE_PATTERN | pattern), micros());
+        }
+    }
+
+    /**
+     * Records the commanded primitive if it changed.
+     *
+     * @param primitive Identifier of the primitive or TRACE_STEERING.
+     */
+    void record_primitive(uint8_t primitive) {
+        if (started && primitive != last_primitive) {
+            last_primitive = primitive;
+            push((uint8_t) (TRACE_PRIMITIVE | primitive), micros());
+        }
+    }
+
+    /**
+     * Sends the recorded events while the transmit buffer of the Serial line has room for them.
+     *
+     * @return If any event is still waiting.
+     */
+    bool drain();
+
+};
+
+
+
+//class trace_recorder
+
+inline void trace_recorder::push(uint8_t code, time_type time) {
+    if (dropped > 0 || (uint8_t) (head - tail) >= TRACE_RING_SIZE) {
+        if (dropped < UINT8_MAX) {
+            ++dropped;
+        }
+        return;
+    }
+    trace_event &event = events[head & (TRACE_RING_SIZE - 1)];
+    event.time = time;
+    event.code = code;
+    ++head;
+}
+
+void trace_recorder::send(uint8_t code, time_type value) {
+    static const char digits[] = "0123456789abcdef";
+    char record[TRACE_RECORD_LENGTH];
+    uint8_t length = 0;
+
+    record[length++] = '~';
+    record[length++] = digits[code >> 4];
+    record[length++] = digits[code & 0x0F];
+    bool leading = true;
+    for (int8_t shift = 28; shift >= 0; shift -= 4) {
+        const uint8_t digit = (uint8_t) ((value >> shift) & 0x0F);
+        if (digit != 0 || !leading || shift == 0) {
+            record[length++] = digits[digit];
+            leading = false;
+        }
+    }
+    record[length++] = '\n';
+    Serial.write((const uint8_t *) record, length);
+}
+
+void trace_recorder::start(time_type now) {
+    started = enabled;
+    if (!started) {
+        return;
+    }
+    tail = head;
+    dropped = 0;
+    last_pattern = 0xFF;
+    last_primitive = 0xFF;
+    start_time = now;
+    /* The start is sent with the absolute time */
+    last_sent = 0;
+    push(TRACE_START, now);
+}
+
+bool trace_recorder::drain() {
+    while ((head != tail || dropped > 0) && Serial.availableForWrite() >= TRACE_RECORD_LENGTH) {
+        if (head == tail) {
+            send(TRACE_DROPPED, dropped);
+            dropped = 0;
+            /* The first events after the loss repeat the current state */
+            last_pattern = 0xFF;
+            last_primitive = 0xFF;
+            return false;
+        }
+        const trace_event &event = events[tail & (TRACE_RING_SIZE - 1)];
+        send(event.code, event.time - last_sent);
+        last_sent = event.time;
+        ++tail;
+    }
+    return head != tail || dropped > 0;
+}
+
+#else
+
+/**
+ * Trace recorder left out of the build, see ENABLE_TRACE. It is never enabled and records nothing.
+ */
+class trace_recorder {
+public:
+
+    void set_enabled(bool) {}
+
+    bool is_enabled() const {
+        return false;
+    }
+
+    void start(time_type) {}
+
+    bool is_started() const {
+        return false;
+    }
+
+    time_type get_start_time() const {
+        return 0;
+    }
+
+    void record_pattern(uint8_t) {}
+
+    void record_primitive(uint8_t) {}
+
+    bool drain() {
+        return false;
+    }
+
+};
+
+#endif
+
+#endif //TRACE_RECORDER_HPP
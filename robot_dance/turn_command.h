@@ -3,6 +3,23 @@
 
 #include "boe_bot_command_base.h"
 
+/**
+ * Time of turning on after the alignment test found the target line until the wheel axle is aligned to it,
+ * in permille of the sweep of the middle sensor between the lines. The middle sensor leads the wheel axle.
+ */
+#define TURN_LEAD_RATIO     (250)
+
+/**
+ * Time in ms the robot keeps turning after the stop, it is stopped so much before the predicted alignment.
+ */
+#define TURN_BRAKE_TIME     (40)
+
+/**
+ * Longest time in ms of turning on after the alignment test found the target line. The middle sensor finds the line
+ * late when the robot stops off the cross, the lead measured by the sweep would overshoot the turn then.
+ */
+#define TURN_LEAD_LIMIT     (60)
+
 
 /**
  * Command for 90deg rotation of the robot in preferred directions.
@@ -29,6 +46,24 @@ class turn_command : public boe_bot_command_base {
      */
     time_type turn_started;
 
+    /**
+     * Time in ms from the start, when the middle sensor left the original line, 0 before.
+     */
+    time_type line_left;
+
+    /**
+     * Time of the predicted stop in ms, 0 until the alignment test finds the target line.
+     */
+    time_type predicted_stop;
+
+    /**
+     * Predicts the stop from the sweep of the middle sensor between the lines, when the alignment test finds the target line.
+     *
+     * @param aligned Primitive of the alignment test.
+     * @return The primitive stopping the robot at the predicted time, MP_NONE keeps rotating.
+     */
+    motion_primitive predict_stop(motion_primitive aligned);
+
 public:
 
     /**
@@ -62,7 +97,8 @@ public:
 //class turn_command
 
 inline turn_command::turn_command(bool left_p, boe_bot *robot_p, location final_location_p) : boe_bot_command_base(
-        robot_p, final_location_p), left(left_p), leavingFirstLine(true), middle_missed(false), turn_started(0) {};
+        robot_p, final_location_p), left(left_p), leavingFirstLine(true), middle_missed(false), turn_started(0),
+        line_left(0), predicted_stop(0) {};
 
 void turn_command::set(bool left, boe_bot *robot_p, const location &final_location_p) {
     init(robot_p, final_location_p);
@@ -70,6 +106,8 @@ void turn_command::set(bool left, boe_bot *robot_p, const location &final_locati
     leavingFirstLine = true;
     middle_missed = false;
     turn_started = 0;
+    line_left = 0;
+    predicted_stop = 0;
 };
 
 //if planing is correct we don't have to take care of corners,
@@ -82,14 +120,17 @@ void turn_command::update() {
         return;
     }
 
+    count_update();
+
     /* First call to this function */
     if (state == command_state::PREPARED) {
-        turn_started = millis();
-        state = command_state::IN_PROCESS;
+        start(left ? COMMAND_TURN_LEFT : COMMAND_TURN_RIGHT);
+        turn_started = get_started_time();
 
-        if (left && !robot->get_last_move_encountered_left() || (!left && !robot->get_last_move_encountered_right())) {
+        if ((left && !robot->get_last_move_encountered_left()) || (!left && !robot->get_last_move_encountered_right())) {
             //next turn command will do the job on borders
-            Serial.println(F("Turn command skipped due to lack of path"));
+            robot->get_telemetry().anomaly(get_started_time(), ANOMALY_TURN_SKIPPED, robot->get_location());
+            robot->get_sensors().get_history().request_dump();
             robot->clear_last_move_encounters();
             robot->set_last_move_encountered_left(true);
             robot->set_last_move_encountered_right(true);
@@ -99,44 +140,44 @@ void turn_command::update() {
 
         if (!robot->get_sensors().middle()) {
             middle_missed = true;
-            Serial.println(F("Middle missed!"));
+            robot->get_telemetry().anomaly(get_started_time(), ANOMALY_MIDDLE_MISSED, robot->get_location());
+            /* No sensor sees the line where it ends on the border, only a line aside is worth the history */
+            if (robot->get_sensors().get_pattern() != 0) {
+                robot->get_sensors().get_history().request_dump();
+            }
         }
     }
 
     /* Allows the middle sensor miss but correction must be done quickly */
-    if (middle_missed && millis() - turn_started > 300) {
+    if (middle_missed && millis() - turn_started > robot->get_calibration().get_tuning().turn_miss_time) {
         middle_missed = false;
     }
 
+    uint8_t pattern = robot->get_sensors().get_pattern();
+
     if (state == command_state::IN_PROCESS) {
-        if (left) {
-            /* Slow down if the target line is approaching */
-            if (robot->get_sensors().second_left()) {
-                robot->in_place_left_half();
-            } else {
-                robot->in_place_left();
-            }
-        } else {
-            /* Slow down if the target line is approaching */
-            if (robot->get_sensors().second_right()) {
-                robot->in_place_right_half();
-            } else {
-                robot->in_place_right();
-            }
+        /* Slow down if the target line is approaching */
+        robot->apply(lookup_primitive(left ? TURN_LEFT_TABLE : TURN_RIGHT_TABLE, pattern));
+
+        if (line_left == 0 && !robot->get_sensors().middle() && !middle_missed) {
+            line_left = millis() - turn_started;
         }
 
         /* It's not possible to turn 'too' quickly */
-        if (!robot->get_sensors().middle() && !middle_missed && millis() - turn_started > 400) {
+        if (!robot->get_sensors().middle() && !middle_missed &&
+            millis() - turn_started > robot->get_calibration().get_tuning().turn_leave_time) {
             leavingFirstLine = false;
         }
     }
 
     if (!leavingFirstLine) {
         /* Is robot aligned to next line? */
-        if (/*!robot->get_sensors().first_left() && */!robot->get_sensors().second_left()
-            && robot->get_sensors().middle()
-            && !robot->get_sensors().first_right()/* && !robot->get_sensors().second_right()*/) {
-            robot->stop();
+        motion_primitive aligned = lookup_primitive(TURN_ALIGNED_TABLE, pattern);
+        if (robot->get_calibration().has_flag(CALIBRATION_TURN_PREDICTION)) {
+            aligned = predict_stop(aligned);
+        }
+        if (aligned != MP_NONE) {
+            robot->apply(aligned);
 
             finish();
         }
@@ -144,6 +185,27 @@ void turn_command::update() {
 
 };
 
+inline motion_primitive turn_command::predict_stop(motion_primitive aligned) {
+    if (predicted_stop == 0) {
+        if (aligned == MP_NONE || line_left == 0) {
+            return aligned;
+        }
+
+        /* The sweep between the lines measures the angular velocity, the lead is the rest of the turn at it */
+        time_type lead = (millis() - turn_started - line_left) * TURN_LEAD_RATIO / 1000;
+        if (lead > TURN_LEAD_LIMIT) {
+            lead = TURN_LEAD_LIMIT;
+        }
+        if (lead <= TURN_BRAKE_TIME) {
+            return aligned;
+        }
+        predicted_stop = millis() + lead - TURN_BRAKE_TIME;
+    }
+
+    /* The robot turns on until the predicted stop, unless the middle sensor is past the target line already */
+    return (long) (millis() - predicted_stop) >= 0 || !robot->get_sensors().middle() ? MP_STOP : MP_NONE;
+}
+
 inline char *turn_command::get_name() {
     if (left) {
         return (char *) "turn command [left]";
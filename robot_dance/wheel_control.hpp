@@ -2,8 +2,7 @@
 #ifndef WHEEL_CONTROL_HPP
 #define WHEEL_CONTROL_HPP
 
-#include <Arduino.h>
-#include <Servo.h>
+#include "hal.hpp"
 
 #define MIN_LEFT_SPEED  (1300)
 #define MAX_LEFT_SPEED  (1700)
@@ -32,8 +31,44 @@ private:
     double current_left_speed = 0;
     double current_right_speed = 0;
 
+    /**
+     * Number of the smoothing steps of a speed change.
+     */
+    uint16_t smoothing_steps = SMOOTHING_STEPS;
+
+    /**
+     * Immediate part of a speed change from interval [0; 1].
+     */
+    double smoothing_jump = SMOOTHING_JUMP;
+
+    /**
+     * Computes the ratio between the previous and new speed.
+     *
+     * @param step_number Number of the call since the speed change.
+     * @return The ratio from interval [smoothing_jump; 1].
+     */
+    double smoothing_ratio(unsigned long step_number) const {
+        if (smoothing_steps == 0) {
+            return 1;
+        }
+        step_number /= 4;
+        return min(1, (1. - smoothing_jump) / ((double) smoothing_steps * smoothing_steps)
+                      * step_number * step_number + smoothing_jump);
+    }
+
 public:
 
+    /**
+     * Sets the smoothing of the speed changes.
+     *
+     * @param steps Number of the smoothing steps, 0 disables the smoothing.
+     * @param jump Immediate part of a speed change from interval [0; 1].
+     */
+    void set_smoothing(uint16_t steps, double jump) {
+        smoothing_steps = steps;
+        smoothing_jump = jump;
+    }
+
     /**
      * Initializes the servos for wheel control.
      */
@@ -64,10 +99,7 @@ public:
             return;
         }
 
-        step_number /= 4;
-
-        double new_speed_ratio = min(1, (1. - SMOOTHING_JUMP) / (SMOOTHING_STEPS * SMOOTHING_STEPS)
-                                        * step_number * step_number + SMOOTHING_JUMP);
+        double new_speed_ratio = smoothing_ratio(step_number);
         left_speed((1. - new_speed_ratio) * previous_left_speed + new_speed_ratio * speed);
     }
 
@@ -85,10 +117,7 @@ public:
             return;
         }
 
-        step_number /= 4;
-
-        double new_speed_ratio = min(1, (1. - SMOOTHING_JUMP) / (SMOOTHING_STEPS * SMOOTHING_STEPS)
-                                        * step_number * step_number + SMOOTHING_JUMP);
+        double new_speed_ratio = smoothing_ratio(step_number);
         right_speed((1. - new_speed_ratio) * previous_right_speed + new_speed_ratio * speed);
     }
 